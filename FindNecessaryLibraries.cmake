@@ -1,4 +1,16 @@
 # boost
 IF (NOT XMLPP_CONFIGURE_INTRUSIVE)
-    FIND_PACKAGE (Boost 1.36.0 COMPONENTS unit_test_framework)
+    FIND_PACKAGE (Boost 1.36.0 COMPONENTS unit_test_framework thread system)
 ENDIF (NOT XMLPP_CONFIGURE_INTRUSIVE)
+
+# threads
+FIND_PACKAGE (Threads)
+
+# compression, gzip is enabled if zlib is found, zstd is optional
+FIND_PACKAGE (ZLIB)
+
+OPTION (XMLPP_WITH_ZSTD "Set to ON to support zstd compressed files. ")
+IF (XMLPP_WITH_ZSTD)
+	FIND_PATH (ZSTD_INCLUDE_DIR zstd.h)
+	FIND_LIBRARY (ZSTD_LIBRARY zstd)
+ENDIF (XMLPP_WITH_ZSTD)
@@ -1,4 +1,5 @@
 #include "attribute.h"
+#include "node.h"
 
 using namespace xmlpp;
 
@@ -16,10 +17,24 @@ const char* attribute::get_value() const
 
 void attribute::set_name(const char* name) const
 {
+    assert(tixmlAttribute);
+    if (owner) {
+        node(owner).prepare_modification();
+    }
     tixmlAttribute->SetName(name);
+    if (owner) {
+        owner->InvalidateSubtreeCache();
+    }
 }
 
 void attribute::set_value(const char* value) const
 {
+    assert(tixmlAttribute);
+    if (owner) {
+        node(owner).prepare_modification();
+    }
     tixmlAttribute->SetValue(value);
+    if (owner) {
+        owner->InvalidateSubtreeCache();
+    }
 }
\ No newline at end of file
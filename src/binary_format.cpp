@@ -0,0 +1,349 @@
+#include "binary_format.h"
+#include "node.h"
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace xmlpp {
+namespace binary_format {
+
+namespace {
+
+    const char   signature[]     = "XMLPPBIN";
+    const size_t signatureLength = sizeof(signature) - 1;
+    const size_t headerLength    = signatureLength + 2;
+
+    const unsigned char flag_bom = 1;
+
+    enum record_type
+    {
+        RECORD_END,
+        RECORD_ELEMENT,
+        RECORD_TEXT,
+        RECORD_CDATA,
+        RECORD_COMMENT,
+        RECORD_UNKNOWN,
+        RECORD_DECLARATION
+    };
+
+    /// encodes records and interns the names
+    class writer
+    {
+    public:
+        void write_tree(const TiXmlNode& root);
+        void write_node(const TiXmlNode& node);
+
+        void write_varint(std::string& out, size_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back( static_cast<char>(value | 0x80) );
+                value >>= 7;
+            }
+            out.push_back( static_cast<char>(value) );
+        }
+
+        void write_string(std::string& out, const std::string& str)
+        {
+            write_varint(out, str.length());
+            out.append(str);
+        }
+
+        size_t intern(const std::string& name)
+        {
+            std::map<std::string, size_t>::iterator i = nameIds.find(name);
+            if ( i != nameIds.end() ) {
+                return i->second;
+            }
+
+            size_t id = names.size();
+            names.push_back(&name);
+            nameIds.insert( std::make_pair(name, id) );
+            return id;
+        }
+
+    public:
+        std::vector<const std::string*>     names;
+        std::map<std::string, size_t>       nameIds;
+        std::string                         records;
+    };
+
+    void writer::write_tree(const TiXmlNode& root)
+    {
+        // subtree is walked without recursion, the end record follows the children of every element
+        const TiXmlNode* node = &root;
+        for (;;)
+        {
+            write_node(*node);
+            if ( node->ToElement() )
+            {
+                if ( node->FirstChild() )
+                {
+                    node = node->FirstChild();
+                    continue;
+                }
+                records.push_back(RECORD_END);
+            }
+
+            while ( node != &root && !node->NextSibling() )
+            {
+                node = node->Parent();
+                records.push_back(RECORD_END);
+            }
+            if (node == &root) {
+                return;
+            }
+            node = node->NextSibling();
+        }
+    }
+
+    /// writes the record of the node, children of the element are written by write_tree
+    void writer::write_node(const TiXmlNode& node)
+    {
+        switch ( node.Type() )
+        {
+            case TiXmlNode::TINYXML_ELEMENT:
+            {
+                const TiXmlElement* e = tixml_node_cast<TiXmlElement>(&node);
+                records.push_back(RECORD_ELEMENT);
+                write_varint( records, intern( e->ValueStr() ) );
+
+                size_t count = 0;
+                for (const TiXmlAttribute* attr = e->FirstAttribute(); attr; attr = attr->Next()) {
+                    ++count;
+                }
+                write_varint(records, count);
+                for (const TiXmlAttribute* attr = e->FirstAttribute(); attr; attr = attr->Next())
+                {
+                    write_varint( records, intern( attr->NameTStr() ) );
+                    write_string( records, attr->ValueStr() );
+                }
+                break;
+            }
+
+            case TiXmlNode::TINYXML_TEXT:
+                records.push_back( node.ToText()->CDATA() ? RECORD_CDATA : RECORD_TEXT );
+                write_string( records, node.ValueStr() );
+                break;
+
+            case TiXmlNode::TINYXML_COMMENT:
+                records.push_back(RECORD_COMMENT);
+                write_string( records, node.ValueStr() );
+                break;
+
+            case TiXmlNode::TINYXML_UNKNOWN:
+                records.push_back(RECORD_UNKNOWN);
+                write_string( records, node.ValueStr() );
+                break;
+
+            case TiXmlNode::TINYXML_DECLARATION:
+            {
+                const TiXmlDeclaration* decl = node.ToDeclaration();
+                records.push_back(RECORD_DECLARATION);
+                write_string( records, decl->Version() );
+                write_string( records, decl->Encoding() );
+                write_string( records, decl->Standalone() );
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    /// decodes records with bounds checking
+    class reader
+    {
+    public:
+        reader(const char* _first, const char* _last) :
+            p(_first),
+            last(_last)
+        {}
+
+        bool at_end() const { return p == last; }
+
+        unsigned char read_byte()
+        {
+            if (p == last) {
+                throw dom_error("Binary format error: unexpected end of data");
+            }
+            return static_cast<unsigned char>(*p++);
+        }
+
+        size_t read_varint()
+        {
+            size_t value = 0;
+            for (unsigned shift = 0; ; shift += 7)
+            {
+                if ( shift >= sizeof(size_t) * 8 ) {
+                    throw dom_error("Binary format error: invalid number");
+                }
+
+                unsigned char byte = read_byte();
+                value |= size_t(byte & 0x7f) << shift;
+                if ( !(byte & 0x80) ) {
+                    return value;
+                }
+            }
+        }
+
+        const char* read_bytes(size_t length)
+        {
+            if ( size_t(last - p) < length ) {
+                throw dom_error("Binary format error: unexpected end of data");
+            }
+            const char* bytes = p;
+            p += length;
+            return bytes;
+        }
+
+        void read_string(std::string& str)
+        {
+            size_t length = read_varint();
+            str.assign( read_bytes(length), length );
+        }
+
+        const std::string& read_name(const std::vector<std::string>& names)
+        {
+            size_t id = read_varint();
+            if ( id >= names.size() ) {
+                throw dom_error("Binary format error: invalid name index");
+            }
+            return names[id];
+        }
+
+    private:
+        const char* p;
+        const char* last;
+    };
+
+} // anonymous namespace
+
+bool is_binary(size_t size, const char* data)
+{
+    return size >= signatureLength && memcmp(data, signature, signatureLength) == 0;
+}
+
+void write(const TiXmlDocument& doc, std::ostream& os)
+{
+    writer w;
+    for (const TiXmlNode* child = doc.FirstChild(); child; child = child->NextSibling()) {
+        w.write_tree(*child);
+    }
+    w.records.push_back(RECORD_END);
+
+    std::string header(signature, signatureLength);
+    header.push_back(version);
+    header.push_back( doc.MicrosoftBOM() ? flag_bom : 0 );
+    w.write_varint( header, w.names.size() );
+    for (size_t i = 0; i < w.names.size(); ++i) {
+        w.write_string( header, *w.names[i] );
+    }
+
+    os.write( header.data(), header.size() );
+    os.write( w.records.data(), w.records.size() );
+}
+
+void read(size_t size, const char* data, TiXmlDocument& doc)
+{
+    if ( !is_binary(size, data) || size < headerLength ) {
+        throw dom_error("Binary format error: invalid signature");
+    }
+    if ( static_cast<unsigned char>(data[signatureLength]) != version ) {
+        throw dom_error("Binary format error: unsupported version");
+    }
+
+    doc.Clear();
+    doc.ClearError();
+    doc.SetMicrosoftBOM( (data[signatureLength + 1] & flag_bom) != 0 );
+
+    reader r(data + headerLength, data + size);
+
+    std::vector<std::string> names( r.read_varint() );
+    for (size_t i = 0; i < names.size(); ++i) {
+        r.read_string(names[i]);
+    }
+
+    // open elements, document is the bottom. Nodes are reused if the document keeps them.
+    std::vector<TiXmlNode*> parents(1, &doc);
+    std::string             value;
+    while ( !parents.empty() )
+    {
+        TiXmlNode*    node = 0;
+        unsigned char type = r.read_byte();
+        switch (type)
+        {
+            case RECORD_END:
+                parents.pop_back();
+                continue;
+
+            case RECORD_ELEMENT:
+            {
+                // values are read before the nodes are created, so the truncated data doesn't leak them
+                const std::string& name = r.read_name(names);
+                TiXmlElement* e = TiXmlNodeRecycler::NewNode(&doc, TiXmlNode::TINYXML_ELEMENT)->ToElement();
+                e->SetValue(name);
+                parents.back()->LinkEndChild(e);
+                size_t count = r.read_varint();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const std::string& name = r.read_name(names);
+                    r.read_string(value);
+                    if ( e->Attribute(name) ) {
+                        throw dom_error("Binary format error: duplicate attribute");
+                    }
+                    e->AppendAttribute(&doc, name, value);
+                }
+                parents.push_back(e);
+                continue;
+            }
+
+            case RECORD_TEXT:
+            case RECORD_CDATA:
+            {
+                r.read_string(value);
+                TiXmlText* text = TiXmlNodeRecycler::NewNode(&doc, TiXmlNode::TINYXML_TEXT)->ToText();
+                text->SetValue(value);
+                text->SetCDATA(type == RECORD_CDATA);
+                node = text;
+                break;
+            }
+
+            case RECORD_COMMENT:
+                r.read_string(value);
+                node = TiXmlNodeRecycler::NewNode(&doc, TiXmlNode::TINYXML_COMMENT);
+                node->SetValue(value);
+                break;
+
+            case RECORD_UNKNOWN:
+                r.read_string(value);
+                node = TiXmlNodeRecycler::NewNode(&doc, TiXmlNode::TINYXML_UNKNOWN);
+                node->SetValue(value);
+                break;
+
+            case RECORD_DECLARATION:
+            {
+                std::string version, encoding, standalone;
+                r.read_string(version);
+                r.read_string(encoding);
+                r.read_string(standalone);
+                TiXmlDeclaration* decl = TiXmlNodeRecycler::NewNode(&doc, TiXmlNode::TINYXML_DECLARATION)->ToDeclaration();
+                *decl = TiXmlDeclaration(version, encoding, standalone);
+                node = decl;
+                break;
+            }
+
+            default:
+                throw dom_error("Binary format error: invalid record");
+        }
+        parents.back()->LinkEndChild(node);
+    }
+
+    if ( !r.at_end() ) {
+        throw dom_error("Binary format error: data after the end of document");
+    }
+}
+
+} // namespace binary_format
+} // namespace xmlpp
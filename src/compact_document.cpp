@@ -0,0 +1,391 @@
+#include "compact_document.h"
+
+namespace xmlpp {
+
+const boost::uint32_t compact_element::npos;
+const compact_document::index_type compact_document::npos;
+
+const char* compact_attribute::get_name() const
+{
+    assert(doc);
+    return doc->get_string( doc->nameOffsets[ doc->attributeNames[index] ] );
+}
+
+const char* compact_attribute::get_value() const
+{
+    assert(doc);
+    return doc->get_string( doc->attributeValues[index] );
+}
+
+////////////////////////////////////////////////////////////////////////
+
+const char* compact_element::get_value() const
+{
+    assert(doc && index != npos);
+    return doc->get_string( doc->nameOffsets[ doc->names[index] ] );
+}
+
+const char* compact_element::get_text() const
+{
+    assert(doc && index != npos);
+    boost::uint32_t child = doc->firstChildren[index];
+    if ( child != npos && doc->kinds[child] == TiXmlNode::TINYXML_TEXT ) {
+        return doc->get_string( doc->textOffsets[child] );
+    }
+    return "";
+}
+
+boost::uint32_t compact_element::find_attribute(const char* name) const
+{
+    assert(doc && index != npos);
+    boost::uint32_t nameId = doc->find_name(name);
+    if ( nameId != npos )
+    {
+        for (boost::uint32_t i = doc->firstAttributes[index]; i < doc->firstAttributes[index + 1]; ++i)
+        {
+            if ( doc->attributeNames[i] == nameId ) {
+                return i;
+            }
+        }
+    }
+    return npos;
+}
+
+bool compact_element::has_attribute(const char* name) const
+{
+    return find_attribute(name) != npos;
+}
+
+const char* compact_element::get_attribute(const char* name) const
+{
+    boost::uint32_t i = find_attribute(name);
+    if ( i == npos ) {
+        throw dom_error(std::string("attribute '") + name + "' not found");
+    }
+    return doc->get_string( doc->attributeValues[i] );
+}
+
+compact_element::const_attribute_iterator compact_element::first_attribute() const
+{
+    assert(doc && index != npos);
+    return const_attribute_iterator( doc, doc->firstAttributes[index] );
+}
+
+compact_element::const_attribute_iterator compact_element::end_attribute() const
+{
+    assert(doc && index != npos);
+    return const_attribute_iterator( doc, doc->firstAttributes[index + 1] );
+}
+
+compact_element_iterator compact_element::get_parent() const
+{
+    assert(doc && index != npos);
+    boost::uint32_t parent = doc->parents[index];
+    if ( parent != npos && doc->kinds[parent] == TiXmlNode::TINYXML_ELEMENT ) {
+        return compact_element_iterator( compact_element(doc, parent) );
+    }
+    return compact_element_iterator();
+}
+
+compact_element_iterator compact_element::first_child_element() const
+{
+    assert(doc && index != npos);
+    return compact_element_iterator( doc, doc->first_element(doc->firstChildren[index], npos, true), index );
+}
+
+compact_element_iterator compact_element::first_child_element(const char* name) const
+{
+    assert(doc && index != npos);
+    boost::uint32_t nameId = doc->find_name(name);
+    if ( nameId == npos ) {
+        return end_child_element();
+    }
+    return compact_element_iterator( doc, doc->first_element(doc->firstChildren[index], nameId, false), index );
+}
+
+compact_element_iterator compact_element::end_child_element() const
+{
+    assert(doc && index != npos);
+    return compact_element_iterator(doc, npos, index);
+}
+
+compact_element_iterator compact_element::next_sibling_element() const
+{
+    assert(doc && index != npos);
+    return compact_element_iterator( doc, doc->first_element(doc->nextSiblings[index], npos, true), doc->parents[index] );
+}
+
+////////////////////////////////////////////////////////////////////////
+
+compact_element_iterator::compact_element_iterator(const compact_element& elem_) :
+    elem(elem_),
+    parent(compact_element::npos)
+{
+    if ( elem.doc && elem.index != compact_element::npos ) {
+        parent = elem.doc->parents[elem.index];
+    }
+}
+
+bool compact_element_iterator::equal(const compact_element_iterator& other) const
+{
+    // end iterators are equal, like the null nodes of the element_iterator
+    return elem.index == other.elem.index
+           && (elem.index == compact_element::npos || elem.doc == other.elem.doc);
+}
+
+void compact_element_iterator::increment()
+{
+    assert(elem.doc && elem.index != compact_element::npos);
+    elem.index = elem.doc->first_element(elem.doc->nextSiblings[elem.index], compact_element::npos, true);
+}
+
+void compact_element_iterator::decrement()
+{
+    assert(elem.doc);
+
+    const compact_document* doc = elem.doc;
+    if ( elem.index == compact_element::npos )
+    {
+        // step back from the end to the last child element of the parent
+        assert(parent != compact_element::npos);
+        boost::uint32_t last = compact_element::npos;
+        for (boost::uint32_t i = doc->first_element(doc->firstChildren[parent], compact_element::npos, true);
+             i != compact_element::npos;
+             i = doc->first_element(doc->nextSiblings[i], compact_element::npos, true))
+        {
+            last = i;
+        }
+        elem.index = last;
+        return;
+    }
+
+    // siblings are contiguous, walk back while parent is the same
+    boost::uint32_t         i   = elem.index;
+    while ( i > 0 && doc->parents[i - 1] == doc->parents[elem.index] )
+    {
+        --i;
+        if ( doc->kinds[i] == TiXmlNode::TINYXML_ELEMENT )
+        {
+            elem.index = i;
+            return;
+        }
+    }
+    elem.index = compact_element::npos;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+compact_document::compact_document()
+{
+}
+
+compact_document::compact_document(const document& d)
+{
+    assign(d);
+}
+
+void compact_document::assign(const document& d)
+{
+    assert( d.get_tixml_document() );
+    assign( *d.get_tixml_document() );
+}
+
+void compact_document::assign(const TiXmlNode& root)
+{
+    clear();
+
+    // breadth first order, so children of each node are contiguous
+    std::vector<const TiXmlNode*> order;
+    order.push_back(&root);
+    parents.push_back(npos);
+    firstChildren.push_back(npos);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        for (const TiXmlNode* child = order[i]->FirstChild(); child; child = child->NextSibling())
+        {
+            if ( firstChildren[i] == npos ) {
+                firstChildren[i] = static_cast<index_type>( order.size() );
+            }
+            order.push_back(child);
+            parents.push_back( static_cast<index_type>(i) );
+            firstChildren.push_back(npos);
+        }
+    }
+
+    size_t count = order.size();
+    kinds.resize(count);
+    names.resize(count, npos);
+    nextSiblings.resize(count, npos);
+    textOffsets.resize(count, npos);
+    firstAttributes.resize(count + 1);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const TiXmlNode* node = order[i];
+        kinds[i]           = static_cast<unsigned char>( node->Type() );
+        firstAttributes[i] = static_cast<index_type>( attributeNames.size() );
+
+        if ( i + 1 < count && parents[i + 1] == parents[i] ) {
+            nextSiblings[i] = static_cast<index_type>(i + 1);
+        }
+
+        switch ( node->Type() )
+        {
+            case TiXmlNode::TINYXML_ELEMENT:
+            {
+                names[i] = intern( node->ValueStr() );
+                for (const TiXmlAttribute* attr = node->ToElement()->FirstAttribute(); attr; attr = attr->Next())
+                {
+                    attributeNames.push_back( intern( attr->NameTStr() ) );
+                    attributeValues.push_back( store_string( attr->ValueStr() ) );
+                }
+                break;
+            }
+
+            case TiXmlNode::TINYXML_DECLARATION:
+            {
+                // declaration fields are stored as attributes
+                const TiXmlDeclaration* decl = node->ToDeclaration();
+                const char* fields[3][2] = { { "version",    decl->Version() },
+                                             { "encoding",   decl->Encoding() },
+                                             { "standalone", decl->Standalone() } };
+                for (int j = 0; j < 3; ++j)
+                {
+                    if ( *fields[j][1] )
+                    {
+                        attributeNames.push_back( intern(fields[j][0]) );
+                        attributeValues.push_back( store_string(fields[j][1]) );
+                    }
+                }
+                break;
+            }
+
+            case TiXmlNode::TINYXML_TEXT:
+            case TiXmlNode::TINYXML_COMMENT:
+            case TiXmlNode::TINYXML_UNKNOWN:
+                textOffsets[i] = store_string( node->ValueStr() );
+                break;
+
+            default:
+                break;
+        }
+    }
+    firstAttributes[count] = static_cast<index_type>( attributeNames.size() );
+}
+
+void compact_document::set_source(size_t size, const char* source)
+{
+    document d;
+    d.set_source(size, source);
+    assign(d);
+}
+
+void compact_document::set_file_source(const std::string& fileName, TiXmlEncoding encoding)
+{
+    document d;
+    d.set_file_source(fileName, encoding);
+    assign(d);
+}
+
+compact_element_iterator compact_document::first_child_element() const
+{
+    if ( kinds.empty() ) {
+        return compact_element_iterator();
+    }
+    return compact_element_iterator( this, first_element(firstChildren[0], npos, true), 0 );
+}
+
+compact_element_iterator compact_document::first_child_element(const char* name) const
+{
+    index_type nameId = find_name(name);
+    if ( kinds.empty() || nameId == npos ) {
+        return end_child_element();
+    }
+    return compact_element_iterator( this, first_element(firstChildren[0], nameId, false), 0 );
+}
+
+compact_element_iterator compact_document::end_child_element() const
+{
+    if ( kinds.empty() ) {
+        return compact_element_iterator();
+    }
+    return compact_element_iterator(this, npos, 0);
+}
+
+size_t compact_document::get_memory_usage() const
+{
+    size_t usage = kinds.capacity()
+                   + sizeof(index_type) * ( names.capacity()
+                                            + parents.capacity()
+                                            + firstChildren.capacity()
+                                            + nextSiblings.capacity()
+                                            + textOffsets.capacity()
+                                            + firstAttributes.capacity()
+                                            + attributeNames.capacity()
+                                            + attributeValues.capacity()
+                                            + nameOffsets.capacity() )
+                   + strings.capacity();
+
+    // rough estimate of the map node overhead
+    for (std::map<std::string, index_type>::const_iterator i = nameIds.begin(); i != nameIds.end(); ++i) {
+        usage += sizeof(*i) + 4 * sizeof(void*) + i->first.capacity();
+    }
+
+    return usage;
+}
+
+void compact_document::clear()
+{
+    kinds.clear();
+    names.clear();
+    parents.clear();
+    firstChildren.clear();
+    nextSiblings.clear();
+    textOffsets.clear();
+    firstAttributes.clear();
+    attributeNames.clear();
+    attributeValues.clear();
+    strings.clear();
+    nameOffsets.clear();
+    nameIds.clear();
+}
+
+compact_document::index_type compact_document::intern(const std::string& name)
+{
+    std::map<std::string, index_type>::iterator i = nameIds.find(name);
+    if ( i != nameIds.end() ) {
+        return i->second;
+    }
+
+    index_type id = static_cast<index_type>( nameOffsets.size() );
+    nameOffsets.push_back( store_string(name) );
+    nameIds.insert( std::make_pair(name, id) );
+    return id;
+}
+
+compact_document::index_type compact_document::find_name(const char* name) const
+{
+    std::map<std::string, index_type>::const_iterator i = nameIds.find(name);
+    return i != nameIds.end() ? i->second : npos;
+}
+
+compact_document::index_type compact_document::store_string(const std::string& str)
+{
+    index_type offset = static_cast<index_type>( strings.size() );
+    strings.insert( strings.end(), str.begin(), str.end() );
+    strings.push_back('\0');
+    return offset;
+}
+
+compact_document::index_type compact_document::first_element(index_type first, index_type name, bool anyName) const
+{
+    for (index_type i = first; i != npos; i = nextSiblings[i])
+    {
+        if ( kinds[i] == TiXmlNode::TINYXML_ELEMENT && (anyName || names[i] == name) ) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+} // namespace xmlpp
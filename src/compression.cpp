@@ -0,0 +1,402 @@
+#include "compression.h"
+#include "document.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <boost/bind.hpp>
+#ifdef XMLPP_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef XMLPP_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace xmlpp {
+
+namespace {
+
+    const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+    const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+    const size_t input_block_size = 64 * 1024;
+
+} // anonymous namespace
+
+compression_type detect_compression(size_t size, const char* data)
+{
+    if ( size >= sizeof(gzip_magic) && memcmp(data, gzip_magic, sizeof(gzip_magic)) == 0 ) {
+        return COMPRESSION_GZIP;
+    }
+    if ( size >= sizeof(zstd_magic) && memcmp(data, zstd_magic, sizeof(zstd_magic)) == 0 ) {
+        return COMPRESSION_ZSTD;
+    }
+    return COMPRESSION_NONE;
+}
+
+compression_type detect_file_compression(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return COMPRESSION_NONE;
+    }
+
+    char   magic[4];
+    size_t size = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return detect_compression(size, magic);
+}
+
+bool compression_supported(compression_type compression)
+{
+    switch (compression)
+    {
+        case COMPRESSION_NONE:
+            return true;
+
+        case COMPRESSION_GZIP:
+#ifdef XMLPP_WITH_ZLIB
+            return true;
+#else
+            return false;
+#endif
+
+        case COMPRESSION_ZSTD:
+#ifdef XMLPP_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void write_compressed_file( const std::string&   fileName,
+                            compression_type     compression,
+                            size_t               size,
+                            const char*          data )
+{
+    if ( !compression_supported(compression) ) {
+        throw file_error("Saving error: compression is not supported");
+    }
+
+    switch (compression)
+    {
+        case COMPRESSION_NONE:
+        {
+            FILE* file = fopen(fileName.c_str(), "wb");
+            if (!file) {
+                throw file_error("Saving error: can't open file '" + fileName + "'");
+            }
+            bool written = fwrite(data, 1, size, file) == size;
+            if ( fclose(file) != 0 || !written ) {
+                throw file_error("Saving error: can't write file '" + fileName + "'");
+            }
+            break;
+        }
+
+        case COMPRESSION_GZIP:
+        {
+#ifdef XMLPP_WITH_ZLIB
+            gzFile file = gzopen(fileName.c_str(), "wb");
+            if (!file) {
+                throw file_error("Saving error: can't open file '" + fileName + "'");
+            }
+
+            bool written = true;
+            for (size_t offset = 0; offset < size && written; offset += input_block_size)
+            {
+                unsigned length = static_cast<unsigned>( std::min(input_block_size, size - offset) );
+                written = gzwrite(file, data + offset, length) == int(length);
+            }
+            if ( gzclose(file) != Z_OK || !written ) {
+                throw file_error("Saving error: can't write file '" + fileName + "'");
+            }
+#endif
+            break;
+        }
+
+        case COMPRESSION_ZSTD:
+        {
+#ifdef XMLPP_WITH_ZSTD
+            std::vector<char> compressed( ZSTD_compressBound(size) );
+            size_t compressedSize = ZSTD_compress(&compressed[0], compressed.size(), data, size, 3);
+            if ( ZSTD_isError(compressedSize) ) {
+                throw file_error( std::string("Saving error: ") + ZSTD_getErrorName(compressedSize) );
+            }
+            write_compressed_file(fileName, COMPRESSION_NONE, compressedSize, &compressed[0]);
+#endif
+            break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+
+decompressing_streambuf::decompressing_streambuf( const std::string&  fileName,
+                                                  size_t              blockSize_,
+                                                  size_t              maxBlocks_ ) :
+    file(0),
+    compression( detect_file_compression(fileName) ),
+    blockSize(blockSize_),
+    maxBlocks(maxBlocks_),
+    finished(false),
+    stopping(false)
+{
+    assert(blockSize > 0 && maxBlocks > 0);
+    if ( !compression_supported(compression) ) {
+        throw file_error("Loading error: compression of the file '" + fileName + "' is not supported");
+    }
+
+    file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        throw file_error("Loading error: can't open file '" + fileName + "'");
+    }
+    workerThread.reset( new boost::thread( boost::bind(&decompressing_streambuf::worker, this) ) );
+}
+
+decompressing_streambuf::~decompressing_streambuf()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        stopping = true;
+    }
+    spaceCondition.notify_all();
+    workerThread->join();
+    fclose(file);
+}
+
+decompressing_streambuf::int_type decompressing_streambuf::underflow()
+{
+    if ( gptr() < egptr() ) {
+        return traits_type::to_int_type( *gptr() );
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        while ( blocks.empty() && !finished ) {
+            readyCondition.wait(lock);
+        }
+
+        if ( blocks.empty() )
+        {
+            if ( !error.empty() ) {
+                throw file_error(error);
+            }
+            return traits_type::eof();
+        }
+
+        current.swap( blocks.front() );
+        blocks.pop_front();
+    }
+    spaceCondition.notify_one();
+
+    setg( &current[0], &current[0], &current[0] + current.size() );
+    return traits_type::to_int_type( *gptr() );
+}
+
+void decompressing_streambuf::worker()
+{
+    std::string workerError;
+    try
+    {
+        switch (compression)
+        {
+            case COMPRESSION_NONE: decompress_none(); break;
+            case COMPRESSION_GZIP: decompress_gzip(); break;
+            case COMPRESSION_ZSTD: decompress_zstd(); break;
+        }
+    }
+    catch (std::exception& e) {
+        workerError = e.what();
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        error    = workerError;
+        finished = true;
+    }
+    readyCondition.notify_all();
+}
+
+bool decompressing_streambuf::push(std::string& block)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        while ( blocks.size() >= maxBlocks && !stopping ) {
+            spaceCondition.wait(lock);
+        }
+        if (stopping) {
+            return false;
+        }
+
+        blocks.push_back( std::string() );
+        blocks.back().swap(block);
+    }
+    readyCondition.notify_one();
+    return true;
+}
+
+void decompressing_streambuf::decompress_none()
+{
+    for (;;)
+    {
+        std::string block(blockSize, '\0');
+        block.resize( fread(&block[0], 1, blockSize, file) );
+        if ( block.empty() ) {
+            break;
+        }
+        if ( !push(block) ) {
+            return;
+        }
+    }
+
+    if ( ferror(file) ) {
+        throw file_error("Loading error: can't read file");
+    }
+}
+
+void decompressing_streambuf::decompress_gzip()
+{
+#ifdef XMLPP_WITH_ZLIB
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if ( inflateInit2(&stream, 15 + 16) != Z_OK ) {
+        throw file_error("Loading error: can't initialize zlib");
+    }
+
+    std::vector<char> input(input_block_size);
+    std::string       block(blockSize, '\0');
+    bool              streamEnd = false;
+    bool              drained   = true; // no output is pending for the consumed input
+    try
+    {
+        stream.next_out  = reinterpret_cast<Bytef*>(&block[0]);
+        stream.avail_out = static_cast<uInt>(blockSize);
+        for (;;)
+        {
+            if (stream.avail_in == 0 && drained)
+            {
+                stream.avail_in = static_cast<uInt>( fread(&input[0], 1, input.size(), file) );
+                stream.next_in  = reinterpret_cast<Bytef*>(&input[0]);
+                if (stream.avail_in == 0) {
+                    break;
+                }
+            }
+
+            // concatenated gzip members are decompressed one after another
+            if (streamEnd && stream.avail_in > 0)
+            {
+                inflateReset(&stream);
+                streamEnd = false;
+            }
+
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                streamEnd = true;
+            }
+            else if (result != Z_OK && result != Z_BUF_ERROR) {
+                throw file_error( std::string("Loading error: corrupted gzip file: ") + (stream.msg ? stream.msg : "") );
+            }
+
+            drained = streamEnd || stream.avail_out != 0;
+            if (stream.avail_out == 0)
+            {
+                if ( !push(block) )
+                {
+                    inflateEnd(&stream);
+                    return;
+                }
+                block.resize(blockSize);
+                stream.next_out  = reinterpret_cast<Bytef*>(&block[0]);
+                stream.avail_out = static_cast<uInt>(blockSize);
+            }
+        }
+
+        if ( ferror(file) ) {
+            throw file_error("Loading error: can't read file");
+        }
+        if (!streamEnd) {
+            throw file_error("Loading error: unexpected end of gzip file");
+        }
+
+        block.resize(blockSize - stream.avail_out);
+        if ( !block.empty() ) {
+            push(block);
+        }
+    }
+    catch (...)
+    {
+        inflateEnd(&stream);
+        throw;
+    }
+    inflateEnd(&stream);
+#endif
+}
+
+void decompressing_streambuf::decompress_zstd()
+{
+#ifdef XMLPP_WITH_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    std::vector<char> input(input_block_size);
+    std::string       block(blockSize, '\0');
+    size_t            pending = 0; // not zero while the frame is not complete
+    try
+    {
+        ZSTD_outBuffer out = { &block[0], blockSize, 0 };
+        for (;;)
+        {
+            ZSTD_inBuffer in = { &input[0], fread(&input[0], 1, input.size(), file), 0 };
+            if (in.size == 0) {
+                break;
+            }
+
+            // full output could leave data in the internal buffers, so loop until it isn't full
+            for (;;)
+            {
+                pending = ZSTD_decompressStream(stream, &out, &in);
+                if ( ZSTD_isError(pending) ) {
+                    throw file_error( std::string("Loading error: corrupted zstd file: ") + ZSTD_getErrorName(pending) );
+                }
+
+                bool full = (out.pos == out.size);
+                if (full)
+                {
+                    if ( !push(block) )
+                    {
+                        ZSTD_freeDStream(stream);
+                        return;
+                    }
+                    block.resize(blockSize);
+                    out.dst = &block[0];
+                    out.pos = 0;
+                }
+                if (in.pos == in.size && !full) {
+                    break;
+                }
+            }
+        }
+
+        if ( ferror(file) ) {
+            throw file_error("Loading error: can't read file");
+        }
+        if (pending != 0) {
+            throw file_error("Loading error: unexpected end of zstd file");
+        }
+
+        block.resize(out.pos);
+        if ( !block.empty() ) {
+            push(block);
+        }
+    }
+    catch (...)
+    {
+        ZSTD_freeDStream(stream);
+        throw;
+    }
+    ZSTD_freeDStream(stream);
+#endif
+}
+
+} // namespace xmlpp
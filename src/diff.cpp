@@ -0,0 +1,522 @@
+#include "diff.h"
+#include "structural_hash.h"
+#include "tinyxml.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <sstream>
+
+namespace xmlpp {
+
+namespace {
+
+    typedef std::vector<size_t> path_type;
+
+    const char* const kind_names[] =
+    {
+        "insert",
+        "delete",
+        "update",
+        "set-attribute",
+        "remove-attribute"
+    };
+
+    const int hash_flags = IGNORE_ATTRIBUTE_ORDER;
+
+    /// nodes of the same kind are compared further, others are replaced
+    bool compatible(const TiXmlNode* lhs, const TiXmlNode* rhs)
+    {
+        if ( lhs->Type() != rhs->Type() ) {
+            return false;
+        }
+
+        switch ( lhs->Type() )
+        {
+            case TiXmlNode::TINYXML_ELEMENT:
+                return lhs->ValueStr() == rhs->ValueStr();
+
+            case TiXmlNode::TINYXML_TEXT:
+                return lhs->ToText()->CDATA() == rhs->ToText()->CDATA();
+
+            case TiXmlNode::TINYXML_COMMENT:
+            case TiXmlNode::TINYXML_UNKNOWN:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    path_type child_path(const path_type& path, size_t index)
+    {
+        path_type result;
+        result.reserve(path.size() + 1);
+        result.assign( path.begin(), path.end() );
+        result.push_back(index);
+        return result;
+    }
+
+    std::string format_path(const path_type& path)
+    {
+        std::ostringstream ss;
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            if (i > 0) {
+                ss << '/';
+            }
+            ss << path[i];
+        }
+        return ss.str();
+    }
+
+    path_type parse_path(const char* str)
+    {
+        path_type path;
+        while (*str)
+        {
+            if ( !isdigit( static_cast<unsigned char>(*str) ) ) {
+                throw dom_error( std::string("Diff format error: invalid path '") + str + "'" );
+            }
+
+            char* end = 0;
+            path.push_back( strtoul(str, &end, 10) );
+            str = end;
+            if (*str == '/') {
+                ++str;
+            }
+        }
+        return path;
+    }
+
+    /// Compares the documents by the pairs of nodes, pairs are compared in the breadth first order
+    class differ
+    {
+    public:
+        explicit differ(edit_script& script_) :
+            script(script_)
+        {}
+
+        void run(const TiXmlNode* from, const TiXmlNode* to)
+        {
+            // hashes are kept by the differ, so the compared documents may be shared between threads
+            hash_value fromHash = structural_hash( node( const_cast<TiXmlNode*>(from) ), hash_flags, fromHashes );
+            hash_value toHash   = structural_hash( node( const_cast<TiXmlNode*>(to) ), hash_flags, toHashes );
+            if (fromHash == toHash) {
+                return;
+            }
+
+            pending.push_back( pending_pair(from, to, path_type(), 0, 0) );
+            while ( !pending.empty() )
+            {
+                pending_pair pair = pending.front();
+                pending.pop_front();
+                compare_header(pair);
+                compare_children(pair);
+            }
+        }
+
+    private:
+        struct pending_pair
+        {
+            const TiXmlNode*    from;
+            const TiXmlNode*    to;
+            path_type           path;
+            size_t              fromEntry;  /// position of the subtree in the hash table
+            size_t              toEntry;
+
+            pending_pair(const TiXmlNode* from_, const TiXmlNode* to_, const path_type& path_, size_t fromEntry_, size_t toEntry_) :
+                from(from_),
+                to(to_),
+                path(path_),
+                fromEntry(fromEntry_),
+                toEntry(toEntry_)
+            {}
+        };
+
+        void add(edit_script::operation::kind_type kind, const path_type& path, const std::string& name, const std::string& value)
+        {
+            edit_script::operation op;
+            op.kind  = kind;
+            op.path  = path;
+            op.name  = name;
+            op.value = value;
+            script.add_operation(op);
+        }
+
+        void compare_header(const pending_pair& pair)
+        {
+            const TiXmlElement* from = pair.from->ToElement();
+            const TiXmlElement* to   = pair.to->ToElement();
+            if (from && to)
+            {
+                for (const TiXmlAttribute* a = to->FirstAttribute(); a; a = a->Next())
+                {
+                    const std::string* value = from->Attribute( a->NameTStr() );
+                    if ( !value || *value != a->ValueStr() ) {
+                        add(edit_script::operation::SET_ATTRIBUTE, pair.path, a->NameTStr(), a->ValueStr());
+                    }
+                }
+                for (const TiXmlAttribute* a = from->FirstAttribute(); a; a = a->Next())
+                {
+                    if ( !to->Attribute( a->NameTStr() ) ) {
+                        add(edit_script::operation::REMOVE_ATTRIBUTE, pair.path, a->NameTStr(), std::string());
+                    }
+                }
+            }
+            else if ( pair.from->Type() != TiXmlNode::TINYXML_DOCUMENT && pair.from->ValueStr() != pair.to->ValueStr() ) {
+                add(edit_script::operation::UPDATE_VALUE, pair.path, std::string(), pair.to->ValueStr());
+            }
+        }
+
+        void compare_children(const pending_pair& pair)
+        {
+            collect_children(pair.from, pair.fromEntry, fromHashes, from, fromEntries);
+            collect_children(pair.to, pair.toEntry, toHashes, to, toEntries);
+            match();
+
+            // children between the matched ones are paired in order if they are
+            // compatible, the rest are deleted and inserted
+            size_t position = 0;
+            size_t i = 0;
+            size_t j = 0;
+            for (size_t k = 0; k <= anchors.size(); ++k)
+            {
+                size_t fromEnd = k < anchors.size() ? anchors[k].second : from.size();
+                size_t toEnd   = k < anchors.size() ? anchors[k].first  : to.size();
+                while (i < fromEnd && j < toEnd)
+                {
+                    if ( compatible(from[i], to[j]) )
+                    {
+                        pending.push_back( pending_pair( from[i], to[j], child_path(pair.path, position++), fromEntries[i], toEntries[j] ) );
+                        ++i;
+                        ++j;
+                    }
+                    else if (fromEnd - i > toEnd - j)
+                    {
+                        remove(pair.path, position);
+                        ++i;
+                    }
+                    else if (fromEnd - i < toEnd - j)
+                    {
+                        insert(pair.path, position++, to[j++]);
+                    }
+                    else
+                    {
+                        remove(pair.path, position);
+                        ++i;
+                        insert(pair.path, position++, to[j++]);
+                    }
+                }
+                for (; i < fromEnd; ++i) {
+                    remove(pair.path, position);
+                }
+                for (; j < toEnd; ++j) {
+                    insert(pair.path, position++, to[j]);
+                }
+
+                if ( k < anchors.size() )
+                {
+                    ++i;
+                    ++j;
+                    ++position;
+                }
+            }
+        }
+
+        /// children follow the parent in the hash table, each after the subtree of the previous one
+        static void collect_children(const TiXmlNode*               parent,
+                                     size_t                         parentEntry,
+                                     const hash_table&              hashes,
+                                     std::vector<const TiXmlNode*>& children,
+                                     std::vector<size_t>&           entries)
+        {
+            children.clear();
+            entries.clear();
+            size_t entry = parentEntry + 1;
+            for (const TiXmlNode* child = parent->FirstChild(); child; child = child->NextSibling())
+            {
+                children.push_back(child);
+                entries.push_back(entry);
+                entry += hashes[entry].size;
+            }
+        }
+
+        /// find equal children keeping their order: children are matched by the hashes,
+        /// then the longest increasing subsequence of the matched positions is taken
+        void match()
+        {
+            std::map< hash_value, std::vector<size_t> > positions;
+            for (size_t i = from.size(); i > 0; --i) {
+                positions[ fromHashes[ fromEntries[i - 1] ].hash ].push_back(i - 1);
+            }
+
+            matches.clear();
+            for (size_t j = 0; j < to.size(); ++j)
+            {
+                std::map< hash_value, std::vector<size_t> >::iterator it = positions.find( toHashes[ toEntries[j] ].hash );
+                if ( it != positions.end() && !it->second.empty() )
+                {
+                    matches.push_back( std::make_pair( j, it->second.back() ) );
+                    it->second.pop_back();
+                }
+            }
+
+            // tails[l] - index of the match ending the increasing subsequence of length l + 1
+            std::vector<size_t> tails;
+            std::vector<size_t> previous( matches.size() );
+            for (size_t m = 0; m < matches.size(); ++m)
+            {
+                size_t low  = 0;
+                size_t high = tails.size();
+                while (low < high)
+                {
+                    size_t middle = (low + high) / 2;
+                    if (matches[ tails[middle] ].second < matches[m].second) {
+                        low = middle + 1;
+                    }
+                    else {
+                        high = middle;
+                    }
+                }
+
+                previous[m] = low > 0 ? tails[low - 1] : matches.size();
+                if ( low == tails.size() ) {
+                    tails.push_back(m);
+                }
+                else {
+                    tails[low] = m;
+                }
+            }
+
+            anchors.resize( tails.size() );
+            size_t m = tails.empty() ? matches.size() : tails.back();
+            for (size_t k = anchors.size(); k > 0; --k)
+            {
+                anchors[k - 1] = matches[m];
+                m = previous[m];
+            }
+        }
+
+        void remove(const path_type& path, size_t position)
+        {
+            edit_script::operation op;
+            op.kind = edit_script::operation::DELETE_NODE;
+            op.path = child_path(path, position);
+            script.add_operation(op);
+        }
+
+        void insert(const path_type& path, size_t position, const TiXmlNode* n)
+        {
+            edit_script::operation op;
+            op.kind = edit_script::operation::INSERT_NODE;
+            op.path = child_path(path, position);
+            op.node.reset( n->Clone() );
+            script.add_operation(op);
+        }
+
+    private:
+        typedef std::pair<size_t, size_t> match_type;  /// positions in 'to' and 'from'
+
+        edit_script&                    script;
+        hash_table                      fromHashes;
+        hash_table                      toHashes;
+        std::deque<pending_pair>        pending;
+
+        // children of the compared pair and their positions in the hash tables
+        std::vector<const TiXmlNode*>   from;
+        std::vector<const TiXmlNode*>   to;
+        std::vector<size_t>             fromEntries;
+        std::vector<size_t>             toEntries;
+        std::vector<match_type>         matches;
+        std::vector<match_type>         anchors;
+    };
+
+    TiXmlNode* resolve(TiXmlNode* root, const path_type& path, size_t length)
+    {
+        TiXmlNode* n = root;
+        for (size_t i = 0; i < length; ++i)
+        {
+            n = path[i] < size_t( n->ChildCount() ) ? n->ChildAt( int(path[i]) ) : 0;
+            if (!n) {
+                throw dom_error("Patch error: invalid path '" + format_path(path) + "'");
+            }
+        }
+        return n;
+    }
+
+    TiXmlElement* resolve_element(TiXmlNode* root, const path_type& path)
+    {
+        TiXmlElement* element = resolve( root, path, path.size() )->ToElement();
+        if (!element) {
+            throw dom_error("Patch error: node at '" + format_path(path) + "' is not an element");
+        }
+        return element;
+    }
+
+} // anonymous namespace
+
+void edit_script::save(document& doc) const
+{
+    doc.reset();
+
+    TiXmlElement* root = new TiXmlElement("diff");
+    doc.get_tixml_document()->LinkEndChild(root);
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        const operation& op = operations[i];
+        TiXmlElement*    e  = new TiXmlElement( kind_names[op.kind] );
+        e->SetAttribute( "path", format_path(op.path) );
+        switch (op.kind)
+        {
+            case operation::INSERT_NODE:
+                if (op.node) {
+                    e->LinkEndChild( op.node->Clone() );
+                }
+                break;
+
+            case operation::UPDATE_VALUE:
+                e->SetAttribute("value", op.value);
+                break;
+
+            case operation::SET_ATTRIBUTE:
+                e->SetAttribute("name", op.name);
+                e->SetAttribute("value", op.value);
+                break;
+
+            case operation::REMOVE_ATTRIBUTE:
+                e->SetAttribute("name", op.name);
+                break;
+
+            default:
+                break;
+        }
+        root->LinkEndChild(e);
+    }
+}
+
+void edit_script::load(const document& doc)
+{
+    const TiXmlElement* root = doc.get_tixml_document()->RootElement();
+    if ( !root || root->ValueStr() != "diff" ) {
+        throw dom_error("Diff format error: root element must be 'diff'");
+    }
+
+    operation_list loaded;
+    for (const TiXmlElement* e = root->FirstChildElement(); e; e = e->NextSiblingElement())
+    {
+        operation op;
+        const char* const* kind = std::find( kind_names, kind_names + 5, e->ValueStr() );
+        if (kind == kind_names + 5) {
+            throw dom_error("Diff format error: unknown operation '" + e->ValueStr() + "'");
+        }
+        op.kind = static_cast<operation::kind_type>(kind - kind_names);
+
+        const char* path  = e->Attribute("path");
+        const char* name  = e->Attribute("name");
+        const char* value = e->Attribute("value");
+        if (!path) {
+            throw dom_error("Diff format error: operation without path");
+        }
+        op.path = parse_path(path);
+
+        switch (op.kind)
+        {
+            case operation::INSERT_NODE:
+                if ( !e->FirstChild() || e->FirstChild()->NextSibling() ) {
+                    throw dom_error("Diff format error: insert must contain one node");
+                }
+                op.node.reset( e->FirstChild()->Clone() );
+                break;
+
+            case operation::UPDATE_VALUE:
+            case operation::SET_ATTRIBUTE:
+            case operation::REMOVE_ATTRIBUTE:
+                if ( (op.kind != operation::UPDATE_VALUE && !name) || (op.kind != operation::REMOVE_ATTRIBUTE && !value) ) {
+                    throw dom_error("Diff format error: missing name or value of '" + e->ValueStr() + "'");
+                }
+                op.name  = name ? name : "";
+                op.value = value ? value : "";
+                break;
+
+            default:
+                break;
+        }
+        loaded.push_back(op);
+    }
+    operations.swap(loaded);
+}
+
+edit_script diff(const document& from, const document& to)
+{
+    edit_script script;
+    differ(script).run( from.get_tixml_document(), to.get_tixml_document() );
+    return script;
+}
+
+void patch(document& doc, const edit_script& script)
+{
+    TiXmlNode* root = doc.get_tixml_document();
+    const edit_script::operation_list& operations = script.get_operations();
+    for (size_t i = 0; i < operations.size(); ++i)
+    {
+        const edit_script::operation& op = operations[i];
+        switch (op.kind)
+        {
+            case edit_script::operation::INSERT_NODE:
+            {
+                if ( op.path.empty() || !op.node ) {
+                    throw dom_error("Patch error: invalid insert");
+                }
+
+                TiXmlNode* parent   = resolve( root, op.path, op.path.size() - 1 );
+                size_t     position = op.path.back();
+                if ( position > size_t( parent->ChildCount() ) ) {
+                    throw dom_error("Patch error: invalid path '" + format_path(op.path) + "'");
+                }
+
+                TiXmlNode* copy   = op.node->Clone();
+                TiXmlNode* before = parent->ChildAt( int(position) );
+                if ( !(before ? parent->LinkBeforeChild(before, copy) : parent->LinkEndChild(copy)) )
+                {
+                    if (before) {
+                        delete copy;
+                    }
+                    throw dom_error("Patch error: can't insert node at '" + format_path(op.path) + "'");
+                }
+                break;
+            }
+
+            case edit_script::operation::DELETE_NODE:
+            {
+                TiXmlNode* n = resolve( root, op.path, op.path.size() );
+                if (n == root) {
+                    throw dom_error("Patch error: document can't be deleted");
+                }
+                n->Parent()->RemoveChild(n);
+                break;
+            }
+
+            case edit_script::operation::UPDATE_VALUE:
+            {
+                TiXmlNode* n = resolve( root, op.path, op.path.size() );
+                if ( !n->ToText() && !n->ToComment() && !n->ToUnknown() ) {
+                    throw dom_error("Patch error: value of the node at '" + format_path(op.path) + "' can't be updated");
+                }
+                n->SetValue(op.value);
+                break;
+            }
+
+            case edit_script::operation::SET_ATTRIBUTE:
+                resolve_element(root, op.path)->SetAttribute(op.name, op.value);
+                break;
+
+            case edit_script::operation::REMOVE_ATTRIBUTE:
+                resolve_element(root, op.path)->RemoveAttribute(op.name);
+                break;
+        }
+    }
+}
+
+} // namespace xmlpp
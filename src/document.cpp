@@ -1,37 +1,170 @@
 #include "document.h"
+#include "binary_format.h"
 #include "tinyxml.h"
 #include <algorithm>
+#include <boost/weak_ptr.hpp>
+#include <cstring>
+#include <fstream>
+#include <vector>
 
 namespace xmlpp {
 
+namespace {
+
+    /// adapts document::parse_filter to the tiny xml filter
+    class function_parse_filter :
+        public TiXmlParseFilter
+    {
+    public:
+        explicit function_parse_filter(const document::parse_filter& _filter) :
+            filter(_filter) {}
+
+        bool AcceptElement(const TiXmlElement& parent, const char* name, size_t length)
+        {
+            return filter( element( const_cast<TiXmlElement*>(&parent) ), name, length );
+        }
+
+    private:
+        document::parse_filter filter;
+    };
+
+    /// skips elements with names from the set, names are compared in place
+    class name_parse_filter :
+        public TiXmlParseFilter
+    {
+    public:
+        explicit name_parse_filter(const std::set<std::string>& _names) :
+            names( _names.begin(), _names.end() ) {}
+
+        bool AcceptElement(const TiXmlElement& /*parent*/, const char* name, size_t length)
+        {
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                if ( names[i].length() == length && memcmp(names[i].data(), name, length) == 0 ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        std::vector<std::string> names;
+    };
+
+    /// tiny xml document reporting whether it is shared by the copies of the document
+    class shared_tree :
+        public TiXmlDocument
+    {
+    public:
+        shared_tree() {}
+
+        // copy of the document doesn't copy the recycler
+        explicit shared_tree(const TiXmlDocument& rhs) :
+            TiXmlDocument(rhs)
+        {
+            SetReuseNodes( rhs.ReuseNodes() );
+        }
+
+        bool IsShared() const { return owners.use_count() > 1; }
+
+        static boost::shared_ptr<TiXmlDocument> create(shared_tree* tree)
+        {
+            boost::shared_ptr<shared_tree> result(tree);
+            result->owners = result;
+            return result;
+        }
+
+    private:
+        boost::weak_ptr<shared_tree> owners;
+    };
+
+    /// settings kept by the document when its content is replaced
+    void copy_settings(const TiXmlDocument& from, TiXmlDocument& to)
+    {
+        to.SetValue( from.ValueStr() );
+        to.SetTabSize( from.TabSize() );
+        to.SetParseFilter( from.ParseFilter() );
+        to.SetMaxDepth( from.MaxDepth() );
+        to.SetWhiteSpaceMode( from.WhiteSpaceMode() );
+        to.SetMicrosoftBOM( from.MicrosoftBOM() );
+        to.SetReuseNodes( from.ReuseNodes() );
+    }
+
+} // anonymous namespace
+
 document::document() :
-    node_impl<TiXmlDocument>(new TiXmlDocument)
+    tree( shared_tree::create(new shared_tree) ),
+    printCache(false)
 {
+    tixmlNode = tree.get();
 }
 
 document::document(const document& rhs) :
-    fileName(rhs.fileName)
+    node_impl<TiXmlDocument>(rhs),
+    tree(rhs.tree),
+    fileName(rhs.fileName),
+    parseFilter(rhs.parseFilter),
+    printCache(rhs.printCache)
 {
 }
 
 document::document(size_t size, const char* source) :
-    node_impl<TiXmlDocument>(new TiXmlDocument)
+    tree( shared_tree::create(new shared_tree) ),
+    printCache(false)
 {
+    tixmlNode = tree.get();
     set_source(size, source);
 }
 
 document::~document()
 {
-    delete tixmlNode;
+}
+
+document& document::operator = (const document& rhs)
+{
+    tree        = rhs.tree;
+    tixmlNode   = tree.get();
+    fileName    = rhs.fileName;
+    parseFilter = rhs.parseFilter;
+    printCache  = rhs.printCache;
+    return *this;
+}
+
+void document::detach()
+{
+    if ( !tree.unique() )
+    {
+        tree      = shared_tree::create( new shared_tree(*tree) );
+        tixmlNode = tree.get();
+    }
+}
+
+void document::detach_empty()
+{
+    if ( !tree.unique() )
+    {
+        boost::shared_ptr<TiXmlDocument> empty( shared_tree::create(new shared_tree) );
+        copy_settings(*tree, *empty);
+        tree      = empty;
+        tixmlNode = tree.get();
+    }
+}
+
+TiXmlDocument* document::query_node()
+{
+    detach();
+    return node_impl<TiXmlDocument>::query_node();
 }
     
 node_iterator document::add_child(node& n)
 {
+    n.prepare_modification();
 	return node_iterator( get_tixml_document()->LinkEndChild( n.get_tixml_node() ) );
 }
 
 void document::set_source(size_t size, const char* source)
 {
+    detach_empty();
     query_node()->Parse(source);
     if ( query_node()->Error() ) {
         throw dom_error( std::string("Parse error: ") + query_node()->ErrorDesc() );
@@ -41,13 +174,85 @@ void document::set_source(size_t size, const char* source)
 
 void document::set_file_source(const std::string& _fileName, TiXmlEncoding encoding)
 {
-    if ( !query_node()->LoadFile(_fileName, encoding) ) {
+    detach_empty();
+    if ( detect_file_compression(_fileName) != COMPRESSION_NONE )
+    {
+        // worker thread decompresses next blocks while we gather the text
+        const size_t            blockSize = 64 * 1024;
+        decompressing_streambuf buffer(_fileName, blockSize);
+        std::vector<char>       text;
+        for (;;)
+        {
+            size_t size = text.size();
+            text.resize(size + blockSize);
+            size_t count = static_cast<size_t>( buffer.sgetn(&text[size], blockSize) );
+            text.resize(size + count);
+            if (count < blockSize) {
+                break;
+            }
+        }
+        text.push_back('\0');
+
+        query_node()->SetValue(_fileName);
+        if ( !query_node()->LoadBuffer(&text[0], text.size() - 1, encoding) ) {
+            throw file_error( std::string("Loading error: ") + query_node()->ErrorDesc() );
+        }
+    }
+    else if ( !query_node()->LoadFile(_fileName, encoding) ) {
         throw file_error( std::string("Loading error: ") + query_node()->ErrorDesc() );
     }
     fileName = _fileName;
     this->on_load();
 }
 
+void document::set_parse_filter(const parse_filter& filter)
+{
+    if (filter) {
+        parseFilter.reset( new function_parse_filter(filter) );
+    }
+    else {
+        parseFilter.reset();
+    }
+    query_node()->SetParseFilter( parseFilter.get() );
+}
+
+void document::skip_elements(const std::set<std::string>& names)
+{
+    parseFilter.reset( new name_parse_filter(names) );
+    query_node()->SetParseFilter( parseFilter.get() );
+}
+
+void document::set_reuse_nodes(bool reuse)
+{
+    query_node()->SetReuseNodes(reuse);
+}
+
+void document::set_max_depth(int depth)
+{
+    query_node()->SetMaxDepth(depth);
+}
+
+void document::set_whitespace_mode(TiXmlWhiteSpaceMode mode)
+{
+    query_node()->SetWhiteSpaceMode(mode);
+}
+
+void document::reset()
+{
+    detach_empty();
+    query_node()->Clear();
+    query_node()->ClearError();
+}
+
+void document::set_print_cache(bool cache)
+{
+    // text kept by the shared tree is freed with it, the copies could still print it
+    printCache = cache;
+    if ( !cache && tree.unique() ) {
+        tree->ClearPrintedText();
+    }
+}
+
 void document::print_file(const std::string& fileName) const 
 { 
     get_tixml_document()->SaveFile(fileName); 
@@ -57,13 +262,72 @@ void document::print_file(std::ostream& os) const
 {
 	TiXmlPrinter printer;
 	printer.SetIndent("\t");
+	printer.SetCacheSubtrees(printCache);
 	get_tixml_document()->Accept(&printer);
 	os << printer.CStr();
 }
 
+void document::print_file(const std::string& fileName, compression_type compression) const
+{
+    TiXmlPrinter printer;
+    printer.SetCacheSubtrees(printCache);
+    get_tixml_document()->Accept(&printer);
+
+    std::string text;
+    if ( get_tixml_document()->MicrosoftBOM() ) {
+        text = "\xef\xbb\xbf";
+    }
+    text += printer.Str();
+    write_compressed_file(fileName, compression, text.size(), text.data());
+}
+
+void document::save_binary(const std::string& fileName) const
+{
+    std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!file) {
+        throw file_error("Saving error: can't open file '" + fileName + "'");
+    }
+    save_binary(file);
+    if (!file) {
+        throw file_error("Saving error: can't write file '" + fileName + "'");
+    }
+}
+
+void document::save_binary(std::ostream& os) const
+{
+    binary_format::write(*get_tixml_document(), os);
+}
+
+void document::load_binary(size_t size, const char* data)
+{
+    detach_empty();
+    binary_format::read(size, data, *query_node());
+    this->on_load();
+}
+
+void document::load_binary(const std::string& _fileName)
+{
+    std::ifstream file(_fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw file_error("Loading error: can't open file '" + _fileName + "'");
+    }
+
+    file.seekg(0, std::ios::end);
+    std::vector<char> data( static_cast<size_t>( file.tellg() ) );
+    file.seekg(0, std::ios::beg);
+    if ( data.empty() || !file.read(&data[0], data.size()) ) {
+        throw file_error("Loading error: can't read file '" + _fileName + "'");
+    }
+
+    detach_empty();
+    binary_format::read(data.size(), &data[0], *query_node());
+    fileName = _fileName;
+    this->on_load();
+}
+
 element_iterator document::first_child_element()
 {
-    TiXmlElement* pElem = query_node()->FirstChildElement();
+    TiXmlElement* pElem = node_impl<TiXmlDocument>::query_node()->FirstChildElement();
     return element_iterator(pElem);
 }
 
@@ -75,7 +339,7 @@ const_element_iterator document::first_child_element() const
 
 element_iterator document::first_child_element(const char* value)
 {
-    TiXmlElement* pElem = query_node()->FirstChildElement(value);
+    TiXmlElement* pElem = node_impl<TiXmlDocument>::query_node()->FirstChildElement(value);
     return element_iterator(pElem);
 }
 
@@ -0,0 +1,358 @@
+#include "document_cache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cassert>
+#include <vector>
+#include <boost/bind.hpp>
+
+namespace xmlpp {
+
+bool document_cache::file_stamp::operator == (const file_stamp& rhs) const
+{
+    return mtime == rhs.mtime
+           && size == rhs.size
+           && inode == rhs.inode
+           && device == rhs.device;
+}
+
+document_cache::document_cache(size_t byteBudget_, bool backgroundReload) :
+    pendingReloads(0),
+    byteBudget(byteBudget_),
+    byteSize(0),
+    checkInterval(1),
+    stopping(false)
+{
+    if (backgroundReload) {
+        reloadThread.reset( new boost::thread( boost::bind(&document_cache::worker, this) ) );
+    }
+}
+
+document_cache::~document_cache()
+{
+    if (reloadThread)
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        reloadThread->join();
+    }
+}
+
+bool document_cache::read_stamp(const std::string& fileName, file_stamp& stamp)
+{
+    struct stat st;
+    if ( stat(fileName.c_str(), &st) != 0 ) {
+        return false;
+    }
+
+    stamp.mtime  = st.st_mtime;
+    stamp.size   = static_cast<unsigned long>(st.st_size);
+    stamp.inode  = static_cast<unsigned long>(st.st_ino);
+    stamp.device = static_cast<unsigned long>(st.st_dev);
+    return true;
+}
+
+document_cache::document_ptr document_cache::load(const std::string& fileName)
+{
+    boost::shared_ptr<document> doc(new document);
+    doc->set_file_source(fileName);
+    return doc;
+}
+
+document_cache::document_ptr document_cache::get(const std::string& fileName)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    entry_iterator i = entries.find(fileName);
+    if ( i == entries.end() )
+    {
+        lock.unlock();
+
+        // parse outside the lock, so other readers are not blocked
+        file_stamp stamp;
+        if ( !read_stamp(fileName, stamp) ) {
+            throw file_error("Loading error: can't access file '" + fileName + "'");
+        }
+
+        document_ptr doc = load(fileName);
+        store(fileName, doc, stamp, true);
+        return doc;
+    }
+
+    lru.splice(lru.begin(), lru, i->second.lruPosition);
+
+    document_ptr doc = i->second.doc;
+    if ( !check_due(i->second, time(0), false) ) {
+        return doc;
+    }
+
+    // stat outside the lock as well, the entry may change meanwhile
+    file_stamp oldStamp = i->second.stamp;
+    lock.unlock();
+
+    file_stamp stamp;
+    bool exists = read_stamp(fileName, stamp);
+
+    lock.lock();
+    if ( !exists || !mark_changed(fileName, oldStamp, stamp) || reloadThread ) {
+        return doc;
+    }
+    lock.unlock();
+
+    // changed file and no background thread: reload it here
+    reload(fileName);
+
+    lock.lock();
+    i = entries.find(fileName);
+    if ( i != entries.end() ) {
+        return i->second.doc;
+    }
+
+    // evicted meanwhile
+    lock.unlock();
+    return get(fileName);
+}
+
+void document_cache::refresh()
+{
+    typedef std::vector< std::pair<std::string, file_stamp> > stamp_vector;
+
+    stamp_vector checked;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        time_t now = time(0);
+        for (entry_iterator i = entries.begin(); i != entries.end(); ++i)
+        {
+            if ( check_due(i->second, now, true) ) {
+                checked.push_back( stamp_vector::value_type(i->first, i->second.stamp) );
+            }
+        }
+    }
+
+    // stat without blocking the readers
+    std::vector<file_stamp> stamps( checked.size() );
+    std::vector<bool>       exists( checked.size() );
+    for (size_t i = 0; i < checked.size(); ++i) {
+        exists[i] = read_stamp(checked[i].first, stamps[i]);
+    }
+
+    std::vector<std::string> changed;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        for (size_t i = 0; i < checked.size(); ++i)
+        {
+            if ( exists[i] && mark_changed(checked[i].first, checked[i].second, stamps[i]) && !reloadThread ) {
+                changed.push_back(checked[i].first);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < changed.size(); ++i) {
+        reload(changed[i]);
+    }
+}
+
+void document_cache::wait()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    while (pendingReloads > 0) {
+        idleCondition.wait(lock);
+    }
+}
+
+void document_cache::erase(const std::string& fileName)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    entry_iterator i = entries.find(fileName);
+    if ( i != entries.end() )
+    {
+        byteSize -= i->second.stamp.size;
+        lru.erase(i->second.lruPosition);
+        entries.erase(i);
+    }
+}
+
+void document_cache::clear()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    entries.clear();
+    lru.clear();
+    byteSize = 0;
+}
+
+void document_cache::set_check_interval(unsigned seconds)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    checkInterval = seconds;
+}
+
+void document_cache::set_byte_budget(size_t byteBudget_)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    byteBudget = byteBudget_;
+    evict();
+}
+
+size_t document_cache::get_byte_budget() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return byteBudget;
+}
+
+size_t document_cache::get_byte_size() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return byteSize;
+}
+
+size_t document_cache::size() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return entries.size();
+}
+
+bool document_cache::check_due(entry& e, time_t now, bool force)
+{
+    if ( e.reloading ) {
+        return false;
+    }
+
+    if ( !force && checkInterval > 0 && now - e.lastCheck < static_cast<time_t>(checkInterval) ) {
+        return false;
+    }
+
+    e.lastCheck = now;
+    return true;
+}
+
+bool document_cache::mark_changed(const std::string& fileName, const file_stamp& oldStamp, const file_stamp& stamp)
+{
+    // entry could be evicted, reloaded or scheduled for reload while the lock was released
+    entry_iterator i = entries.find(fileName);
+    if ( i == entries.end() || i->second.reloading || i->second.stamp != oldStamp || stamp == oldStamp ) {
+        return false;
+    }
+
+    i->second.reloading = true;
+    if (reloadThread)
+    {
+        reloadQueue.push_back(fileName);
+        ++pendingReloads;
+        queueCondition.notify_one();
+    }
+    return true;
+}
+
+void document_cache::reload(const std::string& fileName)
+{
+    file_stamp   stamp;
+    document_ptr doc;
+    if ( read_stamp(fileName, stamp) )
+    {
+        try {
+            doc = load(fileName);
+        }
+        catch (std::exception&) {
+            // file is probably being rewritten, keep the old snapshot until it changes again
+        }
+    }
+
+    if (doc) {
+        store(fileName, doc, stamp, false);
+    }
+    else
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        entry_iterator i = entries.find(fileName);
+        if ( i != entries.end() )
+        {
+            byteSize -= i->second.stamp.size;
+            byteSize += stamp.size;
+            i->second.stamp     = stamp;
+            i->second.reloading = false;
+        }
+    }
+}
+
+void document_cache::store(const std::string& fileName, const document_ptr& doc, const file_stamp& stamp, bool insert)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    entry_iterator i = entries.find(fileName);
+    if ( i == entries.end() )
+    {
+        if (!insert) {
+            return;
+        }
+
+        entry e;
+        e.lastCheck   = 0;
+        e.reloading   = false;
+        e.lruPosition = lru.insert(lru.begin(), fileName);
+        i = entries.insert( entry_map::value_type(fileName, e) ).first;
+    }
+    else
+    {
+        byteSize -= i->second.stamp.size;
+        lru.splice(lru.begin(), lru, i->second.lruPosition);
+    }
+
+    i->second.doc       = doc;
+    i->second.stamp     = stamp;
+    i->second.lastCheck = time(0);
+    i->second.reloading = false;
+    byteSize += stamp.size;
+
+    evict();
+}
+
+void document_cache::evict()
+{
+    // most recently used document is never evicted
+    while ( byteSize > byteBudget && lru.size() > 1 )
+    {
+        entry_iterator i = entries.find( lru.back() );
+        assert( i != entries.end() );
+
+        byteSize -= i->second.stamp.size;
+        entries.erase(i);
+        lru.pop_back();
+    }
+}
+
+void document_cache::worker()
+{
+    for (;;)
+    {
+        std::string fileName;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while ( reloadQueue.empty() && !stopping ) {
+                queueCondition.wait(lock);
+            }
+
+            if (stopping) {
+                break;
+            }
+
+            fileName = reloadQueue.front();
+            reloadQueue.pop_front();
+        }
+
+        reload(fileName);
+
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            --pendingReloads;
+        }
+        idleCondition.notify_all();
+    }
+
+    // release waiters
+    boost::mutex::scoped_lock lock(mutex);
+    reloadQueue.clear();
+    pendingReloads = 0;
+    idleCondition.notify_all();
+}
+
+} // namespace xmlpp
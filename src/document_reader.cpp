@@ -0,0 +1,175 @@
+#include "document_reader.h"
+#include "tinyxml.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace xmlpp {
+
+namespace {
+
+    const size_t block_size = 64 * 1024;
+
+    bool is_blank(const char* first, const char* last)
+    {
+        for (; first < last; ++first)
+        {
+            if ( !isspace( static_cast<unsigned char>(*first) ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // anonymous namespace
+
+document_reader::document_reader(size_t size, const char* data_) :
+    source(SOURCE_BUFFER),
+    data(data_),
+    dataEnd(data_ + size),
+    file(0),
+    fd(-1)
+{
+    init();
+}
+
+document_reader::document_reader(const std::string& fileName) :
+    source(SOURCE_FILE),
+    data(0),
+    dataEnd(0),
+    file(0),
+    fd(-1)
+{
+    file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        throw file_error("Loading error: can't open file '" + fileName + "'");
+    }
+    init();
+}
+
+document_reader::document_reader(int fd_) :
+    source(SOURCE_DESCRIPTOR),
+    data(0),
+    dataEnd(0),
+    file(0),
+    fd(fd_)
+{
+    init();
+}
+
+document_reader::~document_reader()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+void document_reader::init()
+{
+    buffer.resize(block_size + 1);
+    first = 0;
+    last  = 0;
+    eof   = false;
+    count = 0;
+}
+
+bool document_reader::next(document& doc)
+{
+    scanner.Reset();
+    size_t end;
+    while ( (end = scanner.Scan(&buffer[first], last - first)) == TIXML_STRING::npos )
+    {
+        if ( eof || read_block() == 0 )
+        {
+            eof = true;
+            if ( is_blank(&buffer[first], &buffer[last]) )
+            {
+                first = last;
+                return false;
+            }
+            throw dom_error("Parse error: unexpected end of the document");
+        }
+    }
+
+    // terminating null is written after the document, the next one starts there,
+    // the copies of the previous document keep its tree
+    char*          text      = &buffer[first];
+    char           following = text[end];
+    doc.reset();
+    TiXmlDocument* tixmlDocument = doc.get_tixml_document();
+    bool           parsed    = tixmlDocument->LoadBuffer(text, end, TIXML_DEFAULT_ENCODING);
+    text[end] = following;
+    first += end;
+    if (!parsed) {
+        throw dom_error( std::string("Parse error: ") + tixmlDocument->ErrorDesc() );
+    }
+
+    ++count;
+    doc.on_load();
+    return true;
+}
+
+size_t document_reader::read_block()
+{
+    // consumed documents are dropped when the buffer is full, so the rest is moved
+    // once per block even for the small messages. Scanner positions are relative
+    // to the start of the document. One byte is reserved for the terminating null.
+    if (buffer.size() - last < block_size + 1)
+    {
+        memmove(&buffer[0], &buffer[first], last - first);
+        last -= first;
+        first = 0;
+        if (buffer.size() - last < block_size + 1) {
+            buffer.resize( std::max(buffer.size() * 2, last + block_size + 1) );
+        }
+    }
+
+    size_t size = 0;
+    switch (source)
+    {
+        case SOURCE_BUFFER:
+            size = std::min( block_size, size_t(dataEnd - data) );
+            memcpy(&buffer[last], data, size);
+            data += size;
+            break;
+
+        case SOURCE_FILE:
+            size = fread(&buffer[last], 1, block_size, file);
+            if ( size == 0 && ferror(file) ) {
+                throw file_error("Loading error: can't read file");
+            }
+            break;
+
+        case SOURCE_DESCRIPTOR:
+        {
+            for (;;)
+            {
+#ifdef _WIN32
+                int result = _read( fd, &buffer[last], static_cast<unsigned>(block_size) );
+#else
+                ssize_t result = ::read(fd, &buffer[last], block_size);
+#endif
+                if (result >= 0)
+                {
+                    size = static_cast<size_t>(result);
+                    break;
+                }
+                if (errno != EINTR) {
+                    throw file_error( std::string("Loading error: can't read file descriptor: ") + strerror(errno) );
+                }
+            }
+            break;
+        }
+    }
+
+    last += size;
+    return size;
+}
+
+} // namespace xmlpp
@@ -39,56 +39,87 @@ const char* element::get_text() const
     return text ? text : "";
 }
 
-void element::set_text(const char* text)
-{
-    assert(tixmlNode);
+namespace {
 
-    bool updated = false;
-    node_iterator i = first_child();
-    while( i != end_child() )
+    /// keeps the first text node in front of the children, the rest are removed
+    template<typename String>
+    void update_text(TiXmlNode* parent, const String& text)
     {
-        if ( TiXmlText* textNode = i->get_tixml_node()->ToText() )
+        TiXmlText* textNode = 0;
+        for (TiXmlNode* child = parent->FirstChild(); child; )
         {
-            if ( !updated )
+            TiXmlNode* next = child->NextSibling();
+            if ( TiXmlText* childText = child->ToText() )
             {
-                textNode->SetValue(text);
-                updated = true;
-                ++i;
+                if (textNode) {
+                    parent->RemoveChild(childText);
+                }
+                else {
+                    textNode = childText;
+                }
             }
-            else
-            {
-                ++i;
-                tixmlNode->RemoveChild(textNode);
+            child = next;
+        }
+
+        if (!textNode)
+        {
+            textNode = new TiXmlText(text);
+            if ( parent->FirstChild() ) {
+                parent->LinkBeforeChild(parent->FirstChild(), textNode);
+            }
+            else {
+                parent->LinkEndChild(textNode);
             }
+            return;
+        }
+
+        // buffer of the value is reused, unchanged text keeps the cached hashes and printed text
+        if ( textNode != parent->FirstChild() ) {
+            parent->LinkBeforeChild(parent->FirstChild(), textNode);
         }
-        else {
-            ++i;
+        if ( textNode->ValueStr() != text ) {
+            textNode->SetValue(text);
         }
     }
 
-    if ( i == end_child() ) 
-    {
-        TiXmlText* textNode = new TiXmlText(text);
-        tixmlNode->LinkEndChild(textNode);
-    }
+} // anonymous namespace
+
+void element::set_text(const char* text)
+{
+    assert(tixmlNode);
+    prepare_modification();
+    update_text(tixmlNode, text);
+}
+
+void element::set_text(const std::string& text)
+{
+    assert(tixmlNode);
+    prepare_modification();
+    update_text(tixmlNode, text);
 }
 
 node_iterator element::add_child(node& n)
 {
     assert(tixmlNode);
+    prepare_modification();
+    n.prepare_modification();
     return node_iterator( tixmlNode->LinkEndChild( n.get_tixml_node() ) );
 }
 
 node_iterator element::insert_after_child(const node_iterator& where, node& n)
 {
     assert(tixmlNode && where);
-    return node_iterator( tixmlNode->InsertAfterChild( where->get_tixml_node(), *n.get_tixml_node() ) );
+    prepare_modification();
+    n.prepare_modification();
+    return node_iterator( tixmlNode->LinkAfterChild( where->get_tixml_node(), n.get_tixml_node() ) );
 }
 
 node_iterator element::insert_before_child(const node_iterator& where, node& n)
 {
     assert(tixmlNode && where);
-    return node_iterator( tixmlNode->InsertBeforeChild( where->get_tixml_node(), *n.get_tixml_node() ) );
+    prepare_modification();
+    n.prepare_modification();
+    return node_iterator( tixmlNode->LinkBeforeChild( where->get_tixml_node(), n.get_tixml_node() ) );
 }
 
 element_iterator element::next_sibling_element() const
@@ -107,6 +138,7 @@ bool element::has_attribute(const char* name) const
 void element::set_attribute(const char* name, const std::string& text)
 {
     assert(tixmlNode);
+    prepare_modification();
     query_node()->SetAttribute(name, text);
 }
 
@@ -143,13 +175,14 @@ size_t element::read_attribute(const char* name,
 element::attribute_iterator element::first_attribute()
 {
     assert(tixmlNode);
-    return attribute_iterator( query_node()->FirstAttribute() );
+    return attribute_iterator( query_node()->FirstAttribute(), query_node() );
 }
 
 element::const_attribute_iterator element::first_attribute() const
 {
     assert(tixmlNode);
-    return const_attribute_iterator( const_cast<TiXmlAttribute*>( query_node()->FirstAttribute() ) );
+    return const_attribute_iterator( const_cast<TiXmlAttribute*>( query_node()->FirstAttribute() ),
+                                     const_cast<TiXmlElement*>( query_node() ) );
 }
 
 element::attribute_iterator element::first_attribute(const char* name)
@@ -25,6 +25,7 @@ const char* node::get_value() const
 void node::set_value(const char* newVal)
 {
     assert(tixmlNode);
+    prepare_modification();
     tixmlNode->SetValue(newVal);
 }
 
@@ -108,12 +109,76 @@ const_element_iterator node::end_child_element() const
     return const_element_iterator(NULL);
 }
 
+size_t node::child_count() const
+{
+    assert(tixmlNode);
+    return static_cast<size_t>( tixmlNode->ChildCount() );
+}
+
+size_t node::size() const
+{
+    assert(tixmlNode);
+    return static_cast<size_t>( tixmlNode->ChildElementCount() );
+}
+
+element_iterator node::child_element(size_t n)
+{
+    assert(tixmlNode);
+    if ( n >= size() ) {
+        return element_iterator(NULL);
+    }
+    return element_iterator( tixmlNode->ChildElementAt( static_cast<int>(n) ) );
+}
+
+const_element_iterator node::child_element(size_t n) const
+{
+    assert(tixmlNode);
+    if ( n >= size() ) {
+        return const_element_iterator(NULL);
+    }
+    return const_element_iterator( tixmlNode->ChildElementAt( static_cast<int>(n) ) );
+}
+
+indexed_element_iterator node::first_indexed_element()
+{
+    assert(tixmlNode);
+    return indexed_element_iterator(tixmlNode, 0);
+}
+
+const_indexed_element_iterator node::first_indexed_element() const
+{
+    assert(tixmlNode);
+    return const_indexed_element_iterator(tixmlNode, 0);
+}
+
+indexed_element_iterator node::end_indexed_element()
+{
+    assert(tixmlNode);
+    return indexed_element_iterator( tixmlNode, tixmlNode->ChildElementCount() );
+}
+
+const_indexed_element_iterator node::end_indexed_element() const
+{
+    assert(tixmlNode);
+    return const_indexed_element_iterator( tixmlNode, tixmlNode->ChildElementCount() );
+}
+
 void node::clear()
 {
     assert(tixmlNode);
+    prepare_modification();
 	tixmlNode->Clear();
 }
 
+void node::prepare_modification()
+{
+    // parents are walked up, wrappers don't know the document they came from
+    const TiXmlDocument* doc = tixmlNode ? tixmlNode->GetDocument() : 0;
+    if ( doc && doc->IsShared() ) {
+        throw dom_error("Can't modify the tree shared by the document copies, detach the document first");
+    }
+}
+
 bool node::operator == (const node& rhs) const
 {
     return tixmlNode == rhs.tixmlNode;
@@ -128,6 +193,7 @@ std::ostream& operator << (std::ostream& os, const node& n)
 std::istream& operator >> (std::istream& is, node& n)
 {
     assert(n.tixmlNode);
+    n.prepare_modification();
     return is >> *n.tixmlNode;
 }
 
@@ -138,12 +204,13 @@ void replace_node( node& what,
 {                         
     assert( what.get_parent() && with.get_tixml_node() );
 
+    what.prepare_modification();
+    with.prepare_modification();
     TiXmlNode* parentNode = what.get_parent()->get_tixml_node();
-    what.set_tixml_node( parentNode->ReplaceChild( what.get_tixml_node(), *with.get_tixml_node() ) );
-
-    if ( !what.get_tixml_node() ) {
+    if ( !parentNode->LinkReplaceChild( what.get_tixml_node(), with.get_tixml_node() ) ) {
         throw dom_error("Error replacing xml node");
-    }           
+    }
+    what.set_tixml_node( with.get_tixml_node() );
 }
 
 void insert_before_node( node& beforeThis,
@@ -151,10 +218,10 @@ void insert_before_node( node& beforeThis,
 {  
     assert( beforeThis.get_parent() && insertNode.get_tixml_node() );
 
+    beforeThis.prepare_modification();
+    insertNode.prepare_modification();
     TiXmlNode* parentNode = beforeThis.get_parent()->get_tixml_node();
-    insertNode.set_tixml_node( parentNode->InsertBeforeChild( beforeThis.get_tixml_node(), *insertNode.get_tixml_node() ) );
-
-    if ( !insertNode.get_tixml_node() ) {
+    if ( !parentNode->LinkBeforeChild( beforeThis.get_tixml_node(), insertNode.get_tixml_node() ) ) {
         throw dom_error("Error inserting before xml node");
     }
 }
@@ -164,10 +231,10 @@ void insert_after_node( node& afterThis,
 {
     assert( afterThis.get_parent() && insertNode.get_tixml_node() );
 
+    afterThis.prepare_modification();
+    insertNode.prepare_modification();
     TiXmlNode* parentNode = afterThis.get_parent()->get_tixml_node();
-    afterThis.set_tixml_node( parentNode->InsertAfterChild( afterThis.get_tixml_node(), *insertNode.get_tixml_node() ) );
-
-    if ( !afterThis.get_tixml_node() ) {
+    if ( !parentNode->LinkAfterChild( afterThis.get_tixml_node(), insertNode.get_tixml_node() ) ) {
         throw dom_error("Error inserting after xml node");
     }
 }
@@ -175,11 +242,12 @@ void insert_after_node( node& afterThis,
 void add_child( node& parent,
                 node& child )
 {        
-    assert( parent.get_tixml_node() );
+    assert( parent.get_tixml_node() && child.get_tixml_node() );
 
-    child.set_tixml_node( parent.get_tixml_node()->LinkEndChild( child.get_tixml_node() ) );
-
-    if ( !child.get_tixml_node() ) {
+    parent.prepare_modification();
+    child.prepare_modification();
+    // document would be deleted by LinkEndChild, node is kept on other errors
+    if ( child.get_tixml_node()->ToDocument() || !parent.get_tixml_node()->LinkEndChild( child.get_tixml_node() ) ) {
         throw dom_error("Error adding child node");
     } 
 }
@@ -188,6 +256,7 @@ void remove_node( node& what )
 {
     assert( what.get_parent() );
 
+    what.prepare_modification();
     bool res = what.get_parent()->get_tixml_node()->RemoveChild( what.get_tixml_node() );
 
     if (!res) {
@@ -195,4 +264,16 @@ void remove_node( node& what )
     }            
 }
 
+void detach_node( node& what )
+{
+    assert( what.get_tixml_node() );
+
+    what.prepare_modification();
+    // root element is detached from the document too
+    TiXmlNode* parentNode = what.get_tixml_node()->Parent();
+    if ( !parentNode || !parentNode->DetachChild( what.get_tixml_node() ) ) {
+        throw dom_error("Error detaching xml node");
+    }
+}
+
 } // namespace xmlpp
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include "node_pool.h"
+
+namespace xmlpp {
+
+node_pool::scope::scope(node_pool& pool) :
+    previous( TiXmlAllocator::SetCurrent( pool.get_tixml_allocator() ) )
+{
+}
+
+node_pool::scope::~scope()
+{
+    TiXmlAllocator::SetCurrent(previous);
+}
+
+} // namespace xmlpp
@@ -0,0 +1,464 @@
+#include "push_parser.h"
+#include "tinyxml.h"
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+namespace xmlpp {
+
+namespace {
+
+    inline bool is_space(char c)
+    {
+        return isspace( static_cast<unsigned char>(c) ) || c == '\n' || c == '\r';
+    }
+
+    inline bool is_blank(const char* first, const char* last)
+    {
+        while ( first < last && is_space(*first) ) ++first;
+        return first == last;
+    }
+
+    /// case insensitive check of the prefix, like TiXmlBase::StringEqual
+    bool starts_with(const char* str, size_t length, const char* prefix)
+    {
+        size_t prefixLength = strlen(prefix);
+        if (length < prefixLength) {
+            return false;
+        }
+        for (size_t i = 0; i < prefixLength; ++i)
+        {
+            if ( tolower( static_cast<unsigned char>(str[i]) ) != prefix[i] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char utf8_bom[] = "\xef\xbb\xbf";
+
+} // anonymous namespace
+
+push_parser::push_parser(document& doc_) :
+    doc(doc_)
+{
+    reset();
+}
+
+void push_parser::reset()
+{
+    doc.reset();
+    TiXmlDocument* tixmlDocument = doc.get_tixml_document();
+    tixmlDocument->SetMicrosoftBOM(false);
+
+    encoding = TIXML_DEFAULT_ENCODING;
+    stack.assign(1, tixmlDocument);
+    kind     = UNIT_TEXT;
+    scanned  = 0;
+    quote    = 0;
+    pending.clear();
+}
+
+void push_parser::feed(const char* data, size_t size)
+{
+    const char* p    = data;
+    const char* last = data + size;
+    while (p < last)
+    {
+        if (kind == UNIT_TEXT)
+        {
+            const char* lt = static_cast<const char*>( memchr(p, '<', last - p) );
+            if (!lt)
+            {
+                pending.append(p, last);
+                return;
+            }
+
+            if ( pending.empty() ) {
+                process_text(p, lt - p);
+            }
+            else
+            {
+                pending.append(p, lt);
+                process_text( pending.c_str(), pending.size() );
+                pending.clear();
+            }
+            p    = lt;
+            kind = UNIT_MARKUP;
+            continue;
+        }
+
+        if ( kind == UNIT_MARKUP && !classify( p, pending.size() + (last - p) ) )
+        {
+            pending.append(p, last);
+            return;
+        }
+
+        // the kept part of the unit is not scanned if it was too short to classify
+        if ( scanned < pending.size() )
+        {
+            const char* end = scan(pending.data() + scanned, pending.data() + pending.size(), scanned, p);
+            if (end)
+            {
+                std::string rest = pending.substr( end - pending.data() );
+                pending.erase( end - pending.data() );
+                process_markup( pending.c_str(), pending.size() );
+                pending.clear();
+                kind = UNIT_TEXT;
+                feed( rest.data(), rest.size() );
+                continue;
+            }
+        }
+
+        const char* end = scan(p + (scanned - pending.size()), last, scanned, p);
+        if (!end)
+        {
+            pending.append(p, last);
+            return;
+        }
+
+        if ( pending.empty() ) {
+            process_markup(p, end - p);
+        }
+        else
+        {
+            pending.append(p, end);
+            process_markup( pending.c_str(), pending.size() );
+            pending.clear();
+        }
+        p    = end;
+        kind = UNIT_TEXT;
+    }
+}
+
+void push_parser::finish()
+{
+    if (kind != UNIT_TEXT) {
+        fail(TiXmlBase::TIXML_ERROR_UNEXPECTED_END);
+    }
+    if ( !pending.empty() )
+    {
+        process_text( pending.c_str(), pending.size() );
+        pending.clear();
+    }
+    if (stack.size() > 1) {
+        fail(TiXmlBase::TIXML_ERROR_READING_END_TAG);
+    }
+    if ( !doc.get_tixml_document()->FirstChild() ) {
+        fail(TiXmlBase::TIXML_ERROR_DOCUMENT_EMPTY);
+    }
+    doc.on_load();
+}
+
+char push_parser::unit_char(size_t offset, const char* chunk) const
+{
+    return offset < pending.size() ? pending[offset] : chunk[offset - pending.size()];
+}
+
+bool push_parser::classify(const char* chunk, size_t available)
+{
+    static const char   cdata[]      = "<![CDATA[";
+    static const size_t cdataLength  = sizeof(cdata) - 1;
+
+    if (available < 2) {
+        return false;
+    }
+
+    char c = unit_char(1, chunk);
+    if (c == '?')
+    {
+        kind    = UNIT_PI;
+        scanned = 2;
+    }
+    else if (c == '!')
+    {
+        if (available < 4) {
+            return false;
+        }
+
+        if ( unit_char(2, chunk) == '-' && unit_char(3, chunk) == '-' )
+        {
+            kind    = UNIT_COMMENT;
+            scanned = 4;
+        }
+        else
+        {
+            size_t matched = 2;
+            while ( matched < cdataLength && matched < available && unit_char(matched, chunk) == cdata[matched] ) {
+                ++matched;
+            }
+
+            if (matched == cdataLength)
+            {
+                kind    = UNIT_CDATA;
+                scanned = cdataLength;
+            }
+            else if (matched == available) {
+                return false;
+            }
+            else
+            {
+                kind    = UNIT_DECLARATION;
+                scanned = 2;
+            }
+        }
+    }
+    else
+    {
+        kind    = UNIT_TAG;
+        scanned = 1;
+    }
+
+    quote = 0;
+    return true;
+}
+
+const char* push_parser::scan(const char* first, const char* last, size_t offset, const char* chunk)
+{
+    if (kind == UNIT_COMMENT || kind == UNIT_CDATA) {
+        return scan_terminator(first, last, offset, chunk);
+    }
+
+    // tiny xml skips '>' in the quoted values of the tags only, other markup ends at the first one
+    bool quoted = (kind == UNIT_TAG);
+    for (const char* q = first; q < last; ++q)
+    {
+        char c = *q;
+        if (quote)
+        {
+            if (c == quote) quote = 0;
+        }
+        else if ( quoted && (c == '"' || c == '\'') ) quote = c;
+        else if (c == '>')
+        {
+            scanned = offset + (q - first) + 1;
+            return q + 1;
+        }
+    }
+
+    scanned = offset + (last - first);
+    return 0;
+}
+
+const char* push_parser::scan_terminator(const char* first, const char* last, size_t offset, const char* chunk)
+{
+    const char* terminator       = (kind == UNIT_COMMENT) ? "-->" : "]]>";
+    size_t      terminatorLength = 3;
+    size_t      openerLength     = (kind == UNIT_COMMENT) ? 4 : 9;
+
+    // check the characters before every '>', they could be in the previous chunks
+    for (const char* q = first; q < last; ++q)
+    {
+        q = static_cast<const char*>( memchr(q, '>', last - q) );
+        if (!q) {
+            break;
+        }
+
+        size_t end = offset + (q - first);
+        if (end + 1 >= openerLength + terminatorLength)
+        {
+            bool matched = true;
+            for (size_t k = 1; k < terminatorLength && matched; ++k) {
+                matched = unit_char(end - k, chunk) == terminator[terminatorLength - 1 - k];
+            }
+            if (matched)
+            {
+                scanned = end + 1;
+                return q + 1;
+            }
+        }
+    }
+
+    scanned = offset + (last - first);
+    return 0;
+}
+
+void push_parser::process_text(const char* text, size_t length)
+{
+    const char* first = text;
+    const char* last  = text + length;
+    if (stack.size() == 1)
+    {
+        // only byte order mark and white space are allowed around the root
+        TiXmlDocument* tixmlDocument = doc.get_tixml_document();
+        if ( !tixmlDocument->FirstChild() && length >= 3 && memcmp(text, utf8_bom, 3) == 0 )
+        {
+            tixmlDocument->SetMicrosoftBOM(true);
+            if (encoding == TIXML_ENCODING_UNKNOWN) {
+                encoding = TIXML_ENCODING_UTF8;
+            }
+            first += 3;
+        }
+
+        if ( !is_blank(first, last) ) {
+            fail(TiXmlBase::TIXML_ERROR_PARSING_ELEMENT);
+        }
+        return;
+    }
+
+    // white space only text is treated like in TiXmlElement::ReadValue
+    if ( is_blank(first, last) )
+    {
+        TiXmlWhiteSpaceMode mode = doc.get_tixml_document()->WhiteSpaceMode();
+        if (mode != TIXML_WHITESPACE_DROP)
+        {
+            TiXmlText* textNode = new_node(TiXmlNode::TINYXML_TEXT)->ToText();
+            if (mode == TIXML_WHITESPACE_KEEP) {
+                textNode->SetValue( std::string(first, last) );
+            }
+            else {
+                textNode->SetValue(" ");
+            }
+            stack.back()->LinkEndChild(textNode);
+        }
+        return;
+    }
+    if ( TiXmlBase::IsWhiteSpaceCondensed() ) {
+        while ( is_space(*first) ) ++first;
+    }
+
+    // text in place is followed by '<', but entities must not be read beyond it
+    if ( memchr(first, '&', last - first) && *last != '\0' )
+    {
+        scratch.assign(first, last);
+        first = scratch.c_str();
+    }
+
+    TiXmlText* textNode = new_node(TiXmlNode::TINYXML_TEXT)->ToText();
+    textNode->Parse(first, 0, encoding);
+
+    // entities could be decoded to the white space
+    const std::string& value = textNode->ValueStr();
+    if ( is_blank( value.data(), value.data() + value.size() ) ) {
+        doc.get_tixml_document()->Recycler()->Release(textNode);
+    }
+    else {
+        stack.back()->LinkEndChild(textNode);
+    }
+}
+
+void push_parser::process_markup(const char* markup, size_t length)
+{
+    switch (kind)
+    {
+        case UNIT_TAG:
+            if (markup[1] == '/') {
+                end_tag(markup, length);
+            }
+            else {
+                start_tag(markup, length);
+            }
+            break;
+
+        case UNIT_COMMENT:
+            add_node(new_node(TiXmlNode::TINYXML_COMMENT), markup);
+            break;
+
+        case UNIT_CDATA:
+        {
+            TiXmlText* text = new_node(TiXmlNode::TINYXML_TEXT)->ToText();
+            text->SetCDATA(true);
+            add_node(text, markup);
+            break;
+        }
+
+        case UNIT_PI:
+        case UNIT_DECLARATION:
+        {
+            // attributes of the declaration could have entities, parse the terminated copy
+            scratch.assign(markup, length);
+            if ( kind == UNIT_PI && starts_with(markup, length, "<?xml") )
+            {
+                TiXmlDeclaration* decl = new_node(TiXmlNode::TINYXML_DECLARATION)->ToDeclaration();
+                add_node( decl, scratch.c_str() );
+
+                // the same as TiXmlDocument::Parse does
+                if ( stack.size() == 1 && encoding == TIXML_ENCODING_UNKNOWN )
+                {
+                    const char* enc = decl->Encoding();
+                    if ( *enc == 0 || starts_with(enc, strlen(enc), "utf-8") || starts_with(enc, strlen(enc), "utf8") ) {
+                        encoding = TIXML_ENCODING_UTF8;
+                    }
+                    else {
+                        encoding = TIXML_ENCODING_LEGACY;
+                    }
+                }
+            }
+            else {
+                add_node( new_node(TiXmlNode::TINYXML_UNKNOWN), scratch.c_str() );
+            }
+            break;
+        }
+
+        default:
+            assert(!"unexpected markup");
+            break;
+    }
+}
+
+void push_parser::start_tag(const char* tag, size_t length)
+{
+    // element is parsed as the empty one, the content follows in the next units
+    bool empty = tag[length - 2] == '/';
+    scratch.assign(tag, length);
+    if (!empty) {
+        scratch.insert(length - 1, 1, '/');
+    }
+
+    // depth of the new element is the size of the stack, the document is at the bottom
+    int maxDepth = doc.get_tixml_document()->MaxDepth();
+    if ( maxDepth > 0 && stack.size() > size_t(maxDepth) ) {
+        fail(TiXmlBase::TIXML_ERROR_DEPTH_EXCEEDED);
+    }
+
+    TiXmlNode* element = new_node(TiXmlNode::TINYXML_ELEMENT);
+    add_node( element, scratch.c_str() );
+    if (!empty) {
+        stack.push_back(element);
+    }
+}
+
+void push_parser::end_tag(const char* tag, size_t length)
+{
+    if (stack.size() == 1) {
+        fail(TiXmlBase::TIXML_ERROR_READING_END_TAG);
+    }
+
+    const char* name    = tag + 2;
+    const char* nameEnd = name;
+    const char* last    = tag + length - 1;
+    while ( nameEnd < last && !is_space(*nameEnd) ) ++nameEnd;
+
+    const char* p = nameEnd;
+    while ( p < last && is_space(*p) ) ++p;
+
+    const std::string& expected = stack.back()->ValueStr();
+    if ( p != last || expected.length() != size_t(nameEnd - name) || memcmp(expected.data(), name, nameEnd - name) != 0 ) {
+        fail(TiXmlBase::TIXML_ERROR_READING_END_TAG);
+    }
+    stack.pop_back();
+}
+
+TiXmlNode* push_parser::new_node(TiXmlNode::NodeType type)
+{
+    return TiXmlNodeRecycler::NewNode(doc.get_tixml_document(), type);
+}
+
+void push_parser::add_node(TiXmlNode* node, const char* markup)
+{
+    // node is linked first, so errors are reported to the document
+    stack.back()->LinkEndChild(node);
+    if ( !node->Parse(markup, 0, encoding) || doc.get_tixml_document()->Error() ) {
+        fail(TiXmlBase::TIXML_ERROR_PARSING_ELEMENT);
+    }
+}
+
+void push_parser::fail(int errorId)
+{
+    // the first error is kept by the document
+    TiXmlDocument* tixmlDocument = doc.get_tixml_document();
+    tixmlDocument->SetError(errorId, 0, 0, encoding);
+    throw dom_error( std::string("Parse error: ") + tixmlDocument->ErrorDesc() );
+}
+
+} // namespace xmlpp
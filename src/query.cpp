@@ -0,0 +1,575 @@
+#include "query.h"
+#include <cctype>
+
+namespace xmlpp {
+
+namespace {
+
+    class path_parser
+    {
+    public:
+        explicit path_parser(const std::string& path_) :
+            path(path_),
+            pos(0)
+        {}
+
+        void parse(query_program& program)
+        {
+            query_step::axis_type axis = query_step::CHILD;
+
+            skip_spaces();
+            if ( accept("//") )
+            {
+                program.absolute = true;
+                axis = query_step::DESCENDANT;
+            }
+            else if ( accept("/") ) {
+                program.absolute = true;
+            }
+            else if ( accept(".//") ) {
+                axis = query_step::DESCENDANT;
+            }
+            else {
+                accept("./");
+            }
+
+            for (;;)
+            {
+                skip_spaces();
+                if ( accept("text()") )
+                {
+                    if ( program.steps.empty() || axis != query_step::CHILD ) {
+                        error("text() must follow element step");
+                    }
+
+                    skip_spaces();
+                    if ( pos != path.size() ) {
+                        error("text() must be the last step");
+                    }
+
+                    program.textOnly = true;
+                    break;
+                }
+
+                query_step step;
+                step.axis = axis;
+                parse_step(step);
+                program.steps.push_back(step);
+
+                skip_spaces();
+                if ( pos == path.size() ) {
+                    break;
+                }
+                else if ( accept("//") ) {
+                    axis = query_step::DESCENDANT;
+                }
+                else if ( accept("/") ) {
+                    axis = query_step::CHILD;
+                }
+                else {
+                    error("'/' expected");
+                }
+            }
+
+            // contexts of the second descendant step could be nested
+            int numDescendants = 0;
+            for (size_t i = 0; i < program.steps.size(); ++i) {
+                numDescendants += program.steps[i].axis == query_step::DESCENDANT;
+            }
+            program.unique = numDescendants > 1;
+        }
+
+    private:
+        void parse_step(query_step& step)
+        {
+            if ( !accept("*") ) {
+                step.name = parse_name();
+            }
+
+            skip_spaces();
+            while ( accept("[") )
+            {
+                parse_predicate(step);
+                skip_spaces();
+            }
+        }
+
+        void parse_predicate(query_step& step)
+        {
+            query_predicate predicate;
+
+            skip_spaces();
+            if ( accept("@") )
+            {
+                predicate.name = parse_name();
+                skip_spaces();
+                if ( accept("=") )
+                {
+                    predicate.kind  = query_predicate::ATTRIBUTE_EQUAL;
+                    predicate.value = parse_literal();
+                }
+                else {
+                    predicate.kind = query_predicate::HAS_ATTRIBUTE;
+                }
+            }
+            else if ( accept("last()") ) {
+                predicate.kind = query_predicate::LAST;
+            }
+            else if ( pos < path.size() && isdigit( static_cast<unsigned char>(path[pos]) ) )
+            {
+                predicate.kind     = query_predicate::POSITION;
+                predicate.position = parse_number();
+                if (predicate.position < 1) {
+                    error("position must be positive");
+                }
+            }
+            else if ( accept("text()") )
+            {
+                skip_spaces();
+                expect("=");
+                predicate.kind  = query_predicate::TEXT_EQUAL;
+                predicate.value = parse_literal();
+            }
+            else
+            {
+                predicate.name = parse_name();
+                skip_spaces();
+                if ( accept("=") )
+                {
+                    predicate.kind  = query_predicate::CHILD_EQUAL;
+                    predicate.value = parse_literal();
+                }
+                else {
+                    predicate.kind = query_predicate::HAS_CHILD;
+                }
+            }
+
+            skip_spaces();
+            expect("]");
+
+            if ( predicate.kind == query_predicate::POSITION || predicate.kind == query_predicate::LAST ) {
+                step.positional = true;
+            }
+            step.predicates.push_back(predicate);
+        }
+
+        std::string parse_name()
+        {
+            size_t start = pos;
+            while ( pos < path.size() && is_name_char(path[pos]) ) {
+                ++pos;
+            }
+
+            if (start == pos) {
+                error("name expected");
+            }
+            return path.substr(start, pos - start);
+        }
+
+        std::string parse_literal()
+        {
+            skip_spaces();
+            if ( pos == path.size() || (path[pos] != '\'' && path[pos] != '"') ) {
+                error("literal expected");
+            }
+
+            size_t end = path.find(path[pos], pos + 1);
+            if (end == std::string::npos) {
+                error("unterminated literal");
+            }
+
+            std::string literal = path.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+            return literal;
+        }
+
+        int parse_number()
+        {
+            int number = 0;
+            while ( pos < path.size() && isdigit( static_cast<unsigned char>(path[pos]) ) ) {
+                number = number * 10 + (path[pos++] - '0');
+            }
+            return number;
+        }
+
+        static bool is_name_char(char c)
+        {
+            return isalnum( static_cast<unsigned char>(c) )
+                   || c == '_'
+                   || c == '-'
+                   || c == '.'
+                   || c == ':'
+                   || static_cast<unsigned char>(c) >= 0x80;
+        }
+
+        void skip_spaces()
+        {
+            while ( pos < path.size() && isspace( static_cast<unsigned char>(path[pos]) ) ) {
+                ++pos;
+            }
+        }
+
+        bool accept(const char* token)
+        {
+            size_t length = strlen(token);
+            if ( path.compare(pos, length, token) == 0 )
+            {
+                pos += length;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(const char* token)
+        {
+            if ( !accept(token) ) {
+                error( (std::string("'") + token + "' expected").c_str() );
+            }
+        }
+
+        void error(const char* what) const
+        {
+            std::ostringstream ss;
+            ss << "Query syntax error in '" << path << "' at " << pos << ": " << what;
+            throw dom_error( ss.str() );
+        }
+
+    private:
+        const std::string&  path;
+        size_t              pos;
+    };
+
+    bool name_matches(const query_step& step, const TiXmlNode* node)
+    {
+        return node->Type() == TiXmlNode::TINYXML_ELEMENT
+               && ( step.name.empty() || node->ValueStr() == step.name );
+    }
+
+    const char* element_text(const TiXmlElement* element)
+    {
+        const char* text = element->GetText();
+        return text ? text : "";
+    }
+
+    bool has_text(const TiXmlElement* element)
+    {
+        for (const TiXmlNode* child = element->FirstChild(); child; child = child->NextSibling())
+        {
+            if ( child->Type() == TiXmlNode::TINYXML_TEXT ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Test first numPredicates predicates of the step. Positional predicates
+     * count elements passed previous predicates in the counters.
+     */
+    bool test_predicates(const query_step& step, const TiXmlElement* element, int* counters, size_t numPredicates)
+    {
+        for (size_t i = 0; i < numPredicates; ++i)
+        {
+            const query_predicate& predicate = step.predicates[i];
+            switch (predicate.kind)
+            {
+                case query_predicate::HAS_ATTRIBUTE:
+                    if ( !element->Attribute(predicate.name) ) {
+                        return false;
+                    }
+                    break;
+
+                case query_predicate::ATTRIBUTE_EQUAL:
+                {
+                    const std::string* value = element->Attribute(predicate.name);
+                    if ( !value || *value != predicate.value ) {
+                        return false;
+                    }
+                    break;
+                }
+
+                case query_predicate::HAS_CHILD:
+                    if ( !element->FirstChildElement(predicate.name) ) {
+                        return false;
+                    }
+                    break;
+
+                case query_predicate::CHILD_EQUAL:
+                {
+                    const TiXmlElement* child = element->FirstChildElement(predicate.name);
+                    while ( child && predicate.value != element_text(child) ) {
+                        child = child->NextSiblingElement(predicate.name);
+                    }
+
+                    if (!child) {
+                        return false;
+                    }
+                    break;
+                }
+
+                case query_predicate::TEXT_EQUAL:
+                    if ( predicate.value != element_text(element) ) {
+                        return false;
+                    }
+                    break;
+
+                case query_predicate::POSITION:
+                    if ( ++counters[i] != predicate.position ) {
+                        return false;
+                    }
+                    break;
+
+                case query_predicate::LAST:
+                {
+                    // look for the following sibling passing previous predicates
+                    std::vector<int> following(counters, counters + i);
+                    for (const TiXmlNode* sibling = element->NextSibling(); sibling; sibling = sibling->NextSibling())
+                    {
+                        if ( name_matches(step, sibling)
+                             && test_predicates(step, static_cast<const TiXmlElement*>(sibling), following.empty() ? 0 : &following[0], i) )
+                        {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    /** Check if no more elements of the level could pass positional predicates */
+    bool positions_exceeded(const query_step& step, const int* counters)
+    {
+        for (size_t i = 0; i < step.predicates.size(); ++i)
+        {
+            if ( step.predicates[i].kind == query_predicate::POSITION && counters[i] >= step.predicates[i].position ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////////////////
+
+query_state::query_state() :
+    top(0),
+    match(0)
+{
+}
+
+query_state::query_state(const boost::shared_ptr<const query_program>& program_, TiXmlNode* context) :
+    program(program_),
+    top(0),
+    match(0)
+{
+    if ( !program || program->steps.empty() || !context ) {
+        return;
+    }
+
+    if (program->absolute)
+    {
+        while ( context->Parent() ) {
+            context = context->Parent();
+        }
+    }
+
+    frames.resize( program->steps.size() );
+    start_frame(0, context);
+    next();
+}
+
+void query_state::next()
+{
+    match = 0;
+    while ( !frames.empty() )
+    {
+        if ( !advance_frame(top) )
+        {
+            if (top == 0) {
+                frames.clear();
+            }
+            else {
+                --top;
+            }
+            continue;
+        }
+
+        TiXmlElement* element = static_cast<TiXmlElement*>(frames[top].current);
+        if (top + 1 < frames.size())
+        {
+            ++top;
+            start_frame(top, element);
+        }
+        else if ( (!program->textOnly || has_text(element))
+                  && (!program->unique || visited.insert(element).second) )
+        {
+            match = element;
+            return;
+        }
+    }
+}
+
+void query_state::start_frame(size_t step, TiXmlNode* context)
+{
+    frame& f    = frames[step];
+    f.context   = context;
+    f.current   = 0;
+    f.depth     = 0;
+    f.exhausted = false;
+    f.counters.assign(program->steps[step].predicates.size(), 0);
+}
+
+bool query_state::advance_frame(size_t step)
+{
+    if (program->steps[step].axis == query_step::CHILD) {
+        return advance_child(step);
+    }
+    return advance_descendant(step);
+}
+
+bool query_state::advance_child(size_t step)
+{
+    frame&            f = frames[step];
+    const query_step& s = program->steps[step];
+
+    while (!f.exhausted)
+    {
+        // use TiXml lookup by name, so children name index is used if present
+        TiXmlElement* element;
+        if (f.current) {
+            element = s.name.empty() ? f.current->NextSiblingElement() : f.current->NextSiblingElement(s.name);
+        }
+        else {
+            element = s.name.empty() ? f.context->FirstChildElement() : f.context->FirstChildElement(s.name);
+        }
+
+        if (!element)
+        {
+            f.exhausted = true;
+            break;
+        }
+
+        f.current = element;
+        if ( s.predicates.empty() || test_predicates(s, element, &f.counters[0], s.predicates.size()) ) {
+            return true;
+        }
+
+        if ( s.positional && positions_exceeded(s, &f.counters[0]) ) {
+            f.exhausted = true;
+        }
+    }
+
+    return false;
+}
+
+bool query_state::advance_descendant(size_t step)
+{
+    frame&            f             = frames[step];
+    const query_step& s             = program->steps[step];
+    size_t            numPredicates = s.predicates.size();
+
+    while (!f.exhausted)
+    {
+        // preorder walk throught the descendants of the context
+        TiXmlNode* node = f.current;
+        if (!node)
+        {
+            node = f.context->FirstChild();
+            if (!node)
+            {
+                f.exhausted = true;
+                break;
+            }
+        }
+        else if ( node->FirstChild() )
+        {
+            node = node->FirstChild();
+            ++f.depth;
+            f.counters.resize( (f.depth + 1) * numPredicates );
+            std::fill( f.counters.begin() + f.depth * numPredicates, f.counters.end(), 0 );
+        }
+        else
+        {
+            while ( !node->NextSibling() )
+            {
+                node = node->Parent();
+                --f.depth;
+                if (node == f.context)
+                {
+                    f.exhausted = true;
+                    return false;
+                }
+            }
+            node = node->NextSibling();
+        }
+
+        // every descendant is tested as a child of its parent, so positions are per parent
+        f.current = node;
+        if ( name_matches(s, node)
+             && ( numPredicates == 0 || test_predicates(s, static_cast<TiXmlElement*>(node), &f.counters[f.depth * numPredicates], numPredicates) ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+query::query()
+{
+}
+
+query::query(const std::string& path_)
+{
+    compile(path_);
+}
+
+void query::compile(const std::string& path_)
+{
+    boost::shared_ptr<query_program> compiled(new query_program);
+
+    path_parser parser(path_);
+    parser.parse(*compiled);
+
+    path    = path_;
+    program = compiled;
+}
+
+query_iterator query::begin(node& context) const
+{
+    return query_iterator( query_state( program, context.get_tixml_node() ) );
+}
+
+const_query_iterator query::begin(const node& context) const
+{
+    return const_query_iterator( query_state( program, const_cast<TiXmlNode*>( context.get_tixml_node() ) ) );
+}
+
+element_iterator query::select_first(node& context) const
+{
+    query_state state( program, context.get_tixml_node() );
+    return element_iterator( state.get_match() );
+}
+
+const_element_iterator query::select_first(const node& context) const
+{
+    query_state state( program, const_cast<TiXmlNode*>( context.get_tixml_node() ) );
+    return const_element_iterator( state.get_match() );
+}
+
+size_t query::count(const node& context) const
+{
+    size_t      numMatches = 0;
+    query_state state( program, const_cast<TiXmlNode*>( context.get_tixml_node() ) );
+    for (; state.get_match(); state.next()) {
+        ++numMatches;
+    }
+    return numMatches;
+}
+
+} // namespace xmlpp
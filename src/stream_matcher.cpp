@@ -0,0 +1,524 @@
+#include "stream_matcher.h"
+#include "tinyxml.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace xmlpp {
+
+namespace {
+
+    enum markup_kind
+    {
+        MARKUP_START,
+        MARKUP_EMPTY,
+        MARKUP_END,
+        MARKUP_OTHER
+    };
+
+    const size_t max_steps = sizeof(boost::uint64_t) * 8;
+
+    inline bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    const char* find_sequence(const char* first, const char* last, const char* seq)
+    {
+        const char* found = std::search( first, last, seq, seq + strlen(seq) );
+        return found != last ? found + strlen(seq) : 0;
+    }
+
+    /** Find end of the markup starting at '<'.
+     * @return pointer past the closing '>' or NULL if markup is incomplete.
+     */
+    const char* find_markup_end(const char* p, const char* last, markup_kind& kind)
+    {
+        assert(*p == '<');
+        size_t avail = last - p;
+        if (avail < 2) {
+            return 0;
+        }
+
+        if (p[1] == '/')
+        {
+            kind = MARKUP_END;
+            const char* gt = static_cast<const char*>( memchr(p, '>', avail) );
+            return gt ? gt + 1 : 0;
+        }
+
+        kind = MARKUP_OTHER;
+        if (p[1] == '?') {
+            return find_sequence(p + 2, last, "?>");
+        }
+
+        if (p[1] == '!')
+        {
+            if (avail < 4) {
+                return 0;
+            }
+            if (p[2] == '-' && p[3] == '-') {
+                return find_sequence(p + 4, last, "-->");
+            }
+
+            const char   cdata[]    = "<![CDATA[";
+            const size_t cdataLength = sizeof(cdata) - 1;
+            if (avail < cdataLength)
+            {
+                if ( memcmp(p, cdata, avail) == 0 ) {
+                    return 0;
+                }
+            }
+            else if ( memcmp(p, cdata, cdataLength) == 0 ) {
+                return find_sequence(p + cdataLength, last, "]]>");
+            }
+
+            // DOCTYPE or other declaration, could have internal subset
+            int  brackets = 0;
+            char quote    = 0;
+            for (const char* q = p + 2; q < last; ++q)
+            {
+                if (quote) {
+                    if (*q == quote) quote = 0;
+                }
+                else if (*q == '"' || *q == '\'') quote = *q;
+                else if (*q == '[') ++brackets;
+                else if (*q == ']') --brackets;
+                else if (*q == '>' && brackets <= 0) return q + 1;
+            }
+            return 0;
+        }
+
+        // start tag, '>' could appear inside attribute values
+        char quote = 0;
+        for (const char* q = p + 1; q < last; ++q)
+        {
+            if (quote) {
+                if (*q == quote) quote = 0;
+            }
+            else if (*q == '"' || *q == '\'') quote = *q;
+            else if (*q == '>')
+            {
+                kind = (q[-1] == '/') ? MARKUP_EMPTY : MARKUP_START;
+                return q + 1;
+            }
+        }
+        return 0;
+    }
+
+    /** Decode predefined and character entities of the attribute value */
+    void decode_entities(const char* first, const char* last, std::string& out)
+    {
+        static const struct { const char* str; size_t length; char chr; } entities[] =
+        {
+            { "&amp;",  5, '&'  },
+            { "&lt;",   4, '<'  },
+            { "&gt;",   4, '>'  },
+            { "&quot;", 6, '"'  },
+            { "&apos;", 6, '\'' }
+        };
+
+        out.clear();
+        while (first < last)
+        {
+            const char* amp = static_cast<const char*>( memchr(first, '&', last - first) );
+            if (!amp)
+            {
+                out.append(first, last);
+                break;
+            }
+            out.append(first, amp);
+            first = amp;
+
+            bool decoded = false;
+            for (size_t i = 0; i < sizeof(entities) / sizeof(entities[0]) && !decoded; ++i)
+            {
+                if ( size_t(last - first) >= entities[i].length && memcmp(first, entities[i].str, entities[i].length) == 0 )
+                {
+                    out.push_back(entities[i].chr);
+                    first  += entities[i].length;
+                    decoded = true;
+                }
+            }
+
+            if ( !decoded && last - first > 2 && first[1] == '#' )
+            {
+                // numeric reference, only ascii range is decoded
+                bool          hex   = (first[2] == 'x');
+                const char*   q     = first + (hex ? 3 : 2);
+                unsigned long value = strtoul(q, 0, hex ? 16 : 10);
+                const char*   semi  = static_cast<const char*>( memchr(q, ';', last - q) );
+                if (semi && value > 0 && value < 0x80)
+                {
+                    out.push_back( static_cast<char>(value) );
+                    first   = semi + 1;
+                    decoded = true;
+                }
+            }
+
+            if (!decoded) {
+                out.push_back(*first++);
+            }
+        }
+    }
+
+    /** Find attribute in the start tag.
+     * @param p - pointer past the element name.
+     * @param last - pointer to the closing '>'.
+     */
+    bool find_attribute(const char* p, const char* last, const std::string& name, std::string* value)
+    {
+        for (;;)
+        {
+            while (p < last && is_space(*p)) ++p;
+            if (p >= last || *p == '/') {
+                return false;
+            }
+
+            const char* nameStart = p;
+            while (p < last && !is_space(*p) && *p != '=' && *p != '/') ++p;
+            size_t nameLength = p - nameStart;
+
+            while (p < last && is_space(*p)) ++p;
+            if (p >= last || *p != '=') {
+                return false;
+            }
+            ++p;
+            while (p < last && is_space(*p)) ++p;
+            if (p >= last || (*p != '"' && *p != '\'')) {
+                return false;
+            }
+
+            const char* valueStart = p + 1;
+            const char* valueEnd   = static_cast<const char*>( memchr(valueStart, *p, last - valueStart) );
+            if (!valueEnd) {
+                return false;
+            }
+
+            if ( nameLength == name.length() && memcmp(nameStart, name.data(), nameLength) == 0 )
+            {
+                if (value) {
+                    decode_entities(valueStart, valueEnd, *value);
+                }
+                return true;
+            }
+            p = valueEnd + 1;
+        }
+    }
+
+    bool step_matches( const query_step& step,
+                       const char*       name,
+                       size_t            nameLength,
+                       const char*       last,
+                       std::string&      buffer )
+    {
+        if ( !step.name.empty() && (step.name.length() != nameLength || memcmp(step.name.data(), name, nameLength) != 0) ) {
+            return false;
+        }
+
+        for (size_t i = 0; i < step.predicates.size(); ++i)
+        {
+            const query_predicate& pred = step.predicates[i];
+            if (pred.kind == query_predicate::HAS_ATTRIBUTE)
+            {
+                if ( !find_attribute(name + nameLength, last, pred.name, 0) ) {
+                    return false;
+                }
+            }
+            else if ( !find_attribute(name + nameLength, last, pred.name, &buffer) || buffer != pred.value ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // anonymous namespace
+
+stream_matcher::stream_matcher() :
+    chunkSize(64 * 1024),
+    depth(0),
+    liveDepth(0)
+{
+}
+
+size_t stream_matcher::add_path(const std::string& path, const callback_type& callback)
+{
+    return add_path(query(path), callback);
+}
+
+size_t stream_matcher::add_path(const query& q, const callback_type& callback)
+{
+    const query_program* program = q.get_program();
+    if (!program || program->steps.empty()) {
+        throw dom_error("Can't match empty path");
+    }
+    if (program->steps.size() > max_steps) {
+        throw dom_error("Path '" + q.get_path() + "' is too long for streaming");
+    }
+    if (program->textOnly) {
+        throw dom_error("Path '" + q.get_path() + "': text() is not supported for streaming");
+    }
+    for (size_t i = 0; i < program->steps.size(); ++i)
+    {
+        const std::vector<query_predicate>& predicates = program->steps[i].predicates;
+        for (size_t j = 0; j < predicates.size(); ++j)
+        {
+            if ( predicates[j].kind != query_predicate::HAS_ATTRIBUTE && predicates[j].kind != query_predicate::ATTRIBUTE_EQUAL ) {
+                throw dom_error("Path '" + q.get_path() + "': only attribute predicates are supported for streaming");
+            }
+        }
+    }
+
+    path_entry entry;
+    entry.q        = q;
+    entry.callback = callback;
+    paths.push_back(entry);
+    return paths.size() - 1;
+}
+
+void stream_matcher::clear()
+{
+    paths.clear();
+}
+
+void stream_matcher::set_chunk_size(size_t _chunkSize)
+{
+    assert(_chunkSize > 0);
+    chunkSize = _chunkSize;
+}
+
+void stream_matcher::parse(size_t size, const char* source)
+{
+    reset();
+    scan(source, source + size, true);
+    if (depth != 0) {
+        throw dom_error("Unexpected end of the xml stream");
+    }
+}
+
+void stream_matcher::parse(std::istream& is)
+{
+    reset();
+
+    std::vector<char> buffer;
+    size_t            pending = 0;
+    for (;;)
+    {
+        buffer.resize(pending + chunkSize);
+        is.read(&buffer[pending], chunkSize);
+        if ( is.bad() ) {
+            throw dom_error("Can't read xml stream");
+        }
+
+        size_t      size  = pending + static_cast<size_t>( is.gcount() );
+        bool        final = !is;
+        const char* first = &buffer[0];
+        const char* rest  = scan(first, first + size, final);
+        if (final) {
+            break;
+        }
+
+        // keep incomplete markup for the next chunk
+        pending = first + size - rest;
+        if (pending > 0) {
+            memmove(&buffer[0], rest, pending);
+        }
+    }
+
+    if (depth != 0) {
+        throw dom_error("Unexpected end of the xml stream");
+    }
+}
+
+void stream_matcher::parse_file(const std::string& fileName)
+{
+    if ( detect_file_compression(fileName) != COMPRESSION_NONE )
+    {
+        // decompression runs on the worker thread while we scan
+        decompressing_streambuf buffer(fileName, chunkSize);
+        std::istream            is(&buffer);
+        is.exceptions(std::ios::badbit);
+        parse(is);
+        return;
+    }
+
+    std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        throw file_error("Loading error: can't open file '" + fileName + "'");
+    }
+    parse(file);
+}
+
+void stream_matcher::reset()
+{
+    // level 0 is the document, first step of every path is active there
+    masks.assign(paths.size(), 1);
+    depth     = 0;
+    liveDepth = 0;
+    captured.clear();
+    captures.clear();
+}
+
+const char* stream_matcher::scan(const char* p, const char* last, bool final)
+{
+    while (p < last)
+    {
+        const char* lt = static_cast<const char*>( memchr(p, '<', last - p) );
+        if (!lt)
+        {
+            if ( !captures.empty() ) {
+                captured.append(p, last);
+            }
+            return last;
+        }
+
+        if ( !captures.empty() ) {
+            captured.append(p, lt);
+        }
+        p = lt;
+
+        markup_kind kind;
+        const char* markupEnd = find_markup_end(p, last, kind);
+        if (!markupEnd)
+        {
+            if (final) {
+                throw dom_error("Unexpected end of the xml stream");
+            }
+            return p;
+        }
+
+        switch (kind)
+        {
+            case MARKUP_START:
+            case MARKUP_EMPTY:
+                start_element(p, markupEnd, kind == MARKUP_EMPTY);
+                break;
+
+            case MARKUP_END:
+                if ( !captures.empty() ) {
+                    captured.append(p, markupEnd);
+                }
+                end_element();
+                break;
+
+            default:
+                if ( !captures.empty() ) {
+                    captured.append(p, markupEnd);
+                }
+                break;
+        }
+        p = markupEnd;
+    }
+    return p;
+}
+
+void stream_matcher::start_element(const char* tag, const char* tagEnd, bool empty)
+{
+    if ( captures.empty() ) {
+        captured.clear();
+    }
+    size_t start = captured.size();
+
+    // children of the dead element can't match anything, only balance tags
+    if (depth == liveDepth)
+    {
+        const char* name    = tag + 1;
+        const char* nameEnd = name;
+        while ( nameEnd < tagEnd && !is_space(*nameEnd) && *nameEnd != '/' && *nameEnd != '>' ) ++nameEnd;
+
+        size_t numPaths = paths.size();
+        size_t parent   = liveDepth * numPaths;
+        size_t child    = parent + numPaths;
+        masks.resize(child + numPaths);
+
+        std::string buffer;
+        bool        live = false;
+        for (size_t i = 0; i < numPaths; ++i)
+        {
+            const std::vector<query_step>& steps = paths[i].q.get_program()->steps;
+            mask_type active = masks[parent + i];
+            mask_type next   = 0;
+            for (size_t k = 0; k < steps.size() && (active >> k) != 0; ++k)
+            {
+                if ( !((active >> k) & 1) ) {
+                    continue;
+                }
+
+                // descendant step stays active for the deeper elements
+                if (steps[k].axis == query_step::DESCENDANT) {
+                    next |= mask_type(1) << k;
+                }
+
+                if ( step_matches(steps[k], name, nameEnd - name, tagEnd - 1, buffer) )
+                {
+                    if (k + 1 == steps.size())
+                    {
+                        // report once even if several descendant steps matched
+                        if ( captures.empty() || captures.back().depth != depth + 1 || captures.back().path != i )
+                        {
+                            capture c = { start, depth + 1, i };
+                            captures.push_back(c);
+                        }
+                    }
+                    else {
+                        next |= mask_type(1) << (k + 1);
+                    }
+                }
+            }
+            masks[child + i] = next;
+            live = live || next != 0;
+        }
+
+        if (live) {
+            ++liveDepth;
+        }
+        else {
+            masks.resize(child);
+        }
+    }
+    ++depth;
+
+    if ( !captures.empty() ) {
+        captured.append(tag, tagEnd);
+    }
+    if (empty) {
+        end_element();
+    }
+}
+
+void stream_matcher::end_element()
+{
+    if (depth == 0) {
+        throw dom_error("Unexpected end tag in the xml stream");
+    }
+
+    while ( !captures.empty() && captures.back().depth == depth )
+    {
+        capture c = captures.back();
+        captures.pop_back();
+        deliver(c);
+    }
+
+    if (liveDepth == depth)
+    {
+        --liveDepth;
+        masks.resize( (liveDepth + 1) * paths.size() );
+    }
+    --depth;
+}
+
+void stream_matcher::deliver(const capture& c)
+{
+    TiXmlDocument doc;
+    doc.Parse( captured.c_str() + c.start );
+    if ( doc.Error() || !doc.RootElement() ) {
+        throw dom_error( std::string("Parse error: ") + doc.ErrorDesc() );
+    }
+
+    element e( doc.RootElement() );
+    paths[c.path].callback(e);
+}
+
+} // namespace xmlpp
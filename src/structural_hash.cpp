@@ -0,0 +1,342 @@
+#include "structural_hash.h"
+#include "tinyxml.h"
+#include <cstring>
+#include <vector>
+
+namespace xmlpp {
+
+namespace {
+
+    const boost::uint64_t seed_low  = 0x9e3779b97f4a7c15ULL;
+    const boost::uint64_t seed_high = 0xc2b2ae3d27d4eb4fULL;
+    const boost::uint64_t mul_low   = 0x87c37b91114253d5ULL;
+    const boost::uint64_t mul_high  = 0x4cf5ad432745937fULL;
+
+    inline boost::uint64_t rotl(boost::uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    /// final mix of the murmur hash
+    inline boost::uint64_t fmix(boost::uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    /// Accumulates the words into the two independent lanes
+    class hasher
+    {
+    public:
+        hasher() :
+            low(seed_low),
+            high(seed_high),
+            count(0)
+        {}
+
+        void add(boost::uint64_t k)
+        {
+            low  = rotl(low ^ (k * mul_low), 31) * 5 + 0x52dce729;
+            high = rotl(high ^ (k * mul_high), 33) * 5 + 0x38495ab5;
+            ++count;
+        }
+
+        void add(const char* data, size_t size)
+        {
+            const char* last = data + size;
+            for (; last - data >= 8; data += 8)
+            {
+                boost::uint64_t k;
+                memcpy(&k, data, 8);
+                add(k);
+            }
+
+            boost::uint64_t tail = 0;
+            memcpy(&tail, data, last - data);
+            add(tail);
+            add(size);  // delimits the strings
+        }
+
+        void add(const std::string& str) { add( str.data(), str.size() ); }
+
+        void add(const hash_value& value)
+        {
+            add(value.low);
+            add(value.high);
+        }
+
+        hash_value finish() const
+        {
+            boost::uint64_t l = fmix(low ^ count);
+            boost::uint64_t h = fmix(high + l);
+            return hash_value(l, h);
+        }
+
+    private:
+        boost::uint64_t low;
+        boost::uint64_t high;
+        boost::uint64_t count;
+    };
+
+    /// hash the node without children
+    hasher hash_header(const TiXmlNode* node, int flags)
+    {
+        hasher h;
+        h.add( boost::uint64_t( node->Type() ) );
+        if ( node->Type() != TiXmlNode::TINYXML_DOCUMENT ) {
+            h.add( node->ValueStr() );
+        }
+
+        if ( const TiXmlElement* e = node->ToElement() )
+        {
+            if (flags & IGNORE_ATTRIBUTE_ORDER)
+            {
+                // sum of the attribute hashes doesn't depend on their order
+                hash_value     sum;
+                boost::uint64_t count = 0;
+                for (const TiXmlAttribute* a = e->FirstAttribute(); a; a = a->Next(), ++count)
+                {
+                    hasher ha;
+                    ha.add( a->NameTStr() );
+                    ha.add( a->ValueStr() );
+                    hash_value value = ha.finish();
+                    sum.low  += value.low;
+                    sum.high += value.high;
+                }
+                h.add(sum);
+                h.add(count);
+            }
+            else
+            {
+                for (const TiXmlAttribute* a = e->FirstAttribute(); a; a = a->Next())
+                {
+                    h.add( a->NameTStr() );
+                    h.add( a->ValueStr() );
+                }
+            }
+        }
+        else if ( const TiXmlText* text = node->ToText() ) {
+            h.add( boost::uint64_t( text->CDATA() ) );
+        }
+        else if ( const TiXmlDeclaration* decl = node->ToDeclaration() )
+        {
+            h.add( decl->Version(), strlen( decl->Version() ) );
+            h.add( decl->Encoding(), strlen( decl->Encoding() ) );
+            h.add( decl->Standalone(), strlen( decl->Standalone() ) );
+        }
+        return h;
+    }
+
+    bool equal_attributes(const TiXmlElement* lhs, const TiXmlElement* rhs, int flags)
+    {
+        const TiXmlAttribute* a = lhs->FirstAttribute();
+        const TiXmlAttribute* b = rhs->FirstAttribute();
+        if (flags & IGNORE_ATTRIBUTE_ORDER)
+        {
+            // names are unique, so equal counts and found values mean equal sets
+            for (; a && b; a = a->Next(), b = b->Next())
+            {
+                const char* value = rhs->Attribute( a->Name() );
+                if ( !value || a->ValueStr() != value ) {
+                    return false;
+                }
+            }
+            return !a && !b;
+        }
+
+        for (; a && b; a = a->Next(), b = b->Next())
+        {
+            if ( a->NameTStr() != b->NameTStr() || a->ValueStr() != b->ValueStr() ) {
+                return false;
+            }
+        }
+        return !a && !b;
+    }
+
+    /// compare the nodes without children
+    bool equal_header(const TiXmlNode* lhs, const TiXmlNode* rhs, int flags)
+    {
+        if ( lhs->Type() != rhs->Type() || lhs->ChildCount() != rhs->ChildCount() ) {
+            return false;
+        }
+        if ( lhs->Type() != TiXmlNode::TINYXML_DOCUMENT && lhs->ValueStr() != rhs->ValueStr() ) {
+            return false;
+        }
+
+        switch ( lhs->Type() )
+        {
+            case TiXmlNode::TINYXML_ELEMENT:
+                return equal_attributes( lhs->ToElement(), rhs->ToElement(), flags );
+
+            case TiXmlNode::TINYXML_TEXT:
+                return lhs->ToText()->CDATA() == rhs->ToText()->CDATA();
+
+            case TiXmlNode::TINYXML_DECLARATION:
+            {
+                const TiXmlDeclaration* a = lhs->ToDeclaration();
+                const TiXmlDeclaration* b = rhs->ToDeclaration();
+                return strcmp( a->Version(), b->Version() ) == 0
+                    && strcmp( a->Encoding(), b->Encoding() ) == 0
+                    && strcmp( a->Standalone(), b->Standalone() ) == 0;
+            }
+
+            default:
+                return true;
+        }
+    }
+
+    /// cached hash of the subtree if it was computed with the same flags
+    inline const TiXmlSubtreeHash* cached_hash(const TiXmlNode* node, int key)
+    {
+        const TiXmlSubtreeHash* cached = node->SubtreeHash();
+        return cached && cached->flags == key ? cached : 0;
+    }
+
+    /// Node which children are being hashed
+    struct open_node
+    {
+        const TiXmlNode*    node;
+        hasher              hash;
+        size_t              position;   /// position in the table
+
+        open_node(const TiXmlNode* node_, const hasher& hash_, size_t position_) :
+            node(node_),
+            hash(hash_),
+            position(position_)
+        {}
+    };
+
+    /// hashes are stored to the table if it is given, to the nodes with CACHE_HASH otherwise
+    hash_value hash_subtree(const TiXmlNode* root, int flags, hash_table* table)
+    {
+        if (!root) {
+            throw dom_error("Can't hash empty node");
+        }
+
+        // open nodes with the hashes of their headers and finished children
+        int  key   = flags & IGNORE_ATTRIBUTE_ORDER;
+        bool cache = !table && (flags & CACHE_HASH) != 0;
+        std::vector<open_node> open;
+
+        const TiXmlNode* node = root;
+        for (;;)
+        {
+            size_t position = 0;
+            if (table)
+            {
+                position = table->size();
+                table->push_back( subtree_hash() );
+            }
+
+            hash_value value;
+            const TiXmlSubtreeHash* cached = table ? 0 : cached_hash(node, key);
+            if (cached) {
+                value = hash_value(cached->low, cached->high);
+            }
+            else if ( node->FirstChild() )
+            {
+                open.push_back( open_node( node, hash_header(node, key), position ) );
+                node = node->FirstChild();
+                continue;
+            }
+            else
+            {
+                value = hash_header(node, key).finish();
+                if (cache) {
+                    node->SetSubtreeHash(value.low, value.high, key);
+                }
+                else if (table) {
+                    (*table)[position] = subtree_hash(value, 1);
+                }
+            }
+
+            // pass the hash to the parent, finish the parents without more children
+            for (;;)
+            {
+                if ( open.empty() ) {
+                    return value;
+                }
+
+                open_node& parent = open.back();
+                parent.hash.add(value);
+                if ( node->NextSibling() )
+                {
+                    node = node->NextSibling();
+                    break;
+                }
+
+                node  = parent.node;
+                value = parent.hash.finish();
+                if (cache) {
+                    node->SetSubtreeHash(value.low, value.high, key);
+                }
+                else if (table) {
+                    (*table)[parent.position] = subtree_hash( value, table->size() - parent.position );
+                }
+                open.pop_back();
+            }
+        }
+    }
+
+} // anonymous namespace
+
+hash_value structural_hash(const node& n, int flags)
+{
+    return hash_subtree( n.get_tixml_node(), flags, 0 );
+}
+
+hash_value structural_hash(const node& n, int flags, hash_table& table)
+{
+    table.clear();
+    return hash_subtree( n.get_tixml_node(), flags, &table );
+}
+
+bool deep_equal(const node& lhs, const node& rhs, int flags)
+{
+    const TiXmlNode* root = lhs.get_tixml_node();
+    const TiXmlNode* a    = root;
+    const TiXmlNode* b    = rhs.get_tixml_node();
+    if (!a || !b) {
+        return a == b;
+    }
+
+    // both trees are walked in the same order, children counts are equal
+    int key = flags & IGNORE_ATTRIBUTE_ORDER;
+    for (;;)
+    {
+        if (a != b)
+        {
+            const TiXmlSubtreeHash* ha = cached_hash(a, key);
+            const TiXmlSubtreeHash* hb = cached_hash(b, key);
+            if ( ha && hb && (ha->low != hb->low || ha->high != hb->high) ) {
+                return false;
+            }
+            if ( !equal_header(a, b, key) ) {
+                return false;
+            }
+            if ( a->FirstChild() )
+            {
+                a = a->FirstChild();
+                b = b->FirstChild();
+                continue;
+            }
+        }
+
+        while ( a != root && !a->NextSibling() )
+        {
+            a = a->Parent();
+            b = b->Parent();
+        }
+        if (a == root) {
+            return true;
+        }
+        a = a->NextSibling();
+        b = b->NextSibling();
+    }
+}
+
+} // namespace xmlpp
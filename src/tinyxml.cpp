@@ -28,12 +28,51 @@ distribution.
 #include <sstream>
 #include <iostream>
 #endif
+#include <algorithm>
+#include <map>
+#include <vector>
 
 #include "tinyxml.h"
 
 FILE* TiXmlFOpen( const char* filename, const char* mode );
 
 bool TiXmlBase::condenseWhiteSpace = true;
+int TiXmlNode::childIndexThreshold = 0;
+
+// Array of the children of the node, see TiXmlNode::SetChildIndexThreshold.
+struct TiXmlNodeIndex
+{
+	typedef std::vector< TiXmlElement* >			ElementVector;
+	typedef std::map< std::string, ElementVector >	NameMap;
+
+	std::vector< TiXmlNode* >	nodes;
+	ElementVector				elements;
+	NameMap						names;		// built on the first lookup by name
+	bool						hasNames;
+
+	TiXmlNodeIndex() : hasNames( false ) {}
+
+	// Orders elements of the same parent by document order
+	static bool Precedes( const TiXmlNode* position, const TiXmlElement* element );
+};
+
+
+bool TiXmlNodeIndex::Precedes( const TiXmlNode* position, const TiXmlElement* element )
+{
+	return position->indexPosition < element->indexPosition;
+}
+
+// Text of the element kept by the caching printer, see TiXmlPrinter::SetCacheSubtrees.
+struct TiXmlPrintedText
+{
+	TIXML_STRING	text;
+	TIXML_STRING	indent;		// format and depth the text was printed with
+	TIXML_STRING	lineBreak;
+	int				depth;		// -1 while the element is printed
+	size_t			start;		// position of the element in the printer's buffer
+
+	TiXmlPrintedText() : depth( -1 ), start( 0 ) {}
+};
 
 // Microsoft compiler security
 FILE* TiXmlFOpen( const char* filename, const char* mode )
@@ -49,6 +88,141 @@ FILE* TiXmlFOpen( const char* filename, const char* mode )
 	#endif
 }
 
+#if defined(_MSC_VER)
+	#define TIXML_THREAD_LOCAL __declspec(thread)
+#else
+	#define TIXML_THREAD_LOCAL __thread
+#endif
+
+static TIXML_THREAD_LOCAL TiXmlAllocator* currentAllocator = 0;
+
+// Stored before every object, keeps the alignment of the global operator new
+// for the classes of pointers and integers.
+union TiXmlAllocationHeader
+{
+	TiXmlAllocator*	allocator;
+	double			align;
+};
+
+
+TiXmlAllocator* TiXmlAllocator::Current()
+{
+	return currentAllocator;
+}
+
+
+TiXmlAllocator* TiXmlAllocator::SetCurrent( TiXmlAllocator* allocator )
+{
+	TiXmlAllocator* previous = currentAllocator;
+	currentAllocator = allocator;
+	return previous;
+}
+
+
+void* TiXmlBase::operator new( size_t size )
+{
+	TiXmlAllocator* allocator = currentAllocator;
+	size += sizeof( TiXmlAllocationHeader );
+	TiXmlAllocationHeader* header = static_cast< TiXmlAllocationHeader* >( allocator ? allocator->Allocate( size ) : ::operator new( size ) );
+	header->allocator = allocator;
+	return header + 1;
+}
+
+
+void TiXmlBase::operator delete( void* p, size_t size )
+{
+	if ( !p )
+		return;
+
+	TiXmlAllocationHeader* header = static_cast< TiXmlAllocationHeader* >( p ) - 1;
+	if ( header->allocator )
+		header->allocator->Deallocate( header, size + sizeof( TiXmlAllocationHeader ) );
+	else
+		::operator delete( header );
+}
+
+
+TiXmlPoolAllocator::TiXmlPoolAllocator( size_t _chunkSize )
+{
+	for ( int i = 0; i < SIZE_CLASSES; ++i )
+		freeBlocks[i] = 0;
+	chunks = 0;
+	chunkSize = _chunkSize;
+	allocated = 0;
+	reserved = 0;
+}
+
+
+TiXmlPoolAllocator::~TiXmlPoolAllocator()
+{
+	assert( allocated == 0 );
+	while ( chunks )
+	{
+		Chunk* chunk = chunks;
+		chunks = chunk->next;
+		::operator delete( chunk );
+	}
+}
+
+
+void* TiXmlPoolAllocator::Allocate( size_t size )
+{
+	size_t sizeClass = ( size - 1 ) / GRANULARITY;
+	if ( sizeClass >= SIZE_CLASSES )
+	{
+		void* p = ::operator new( size );
+		++allocated;
+		return p;
+	}
+
+	if ( !freeBlocks[sizeClass] )
+		AddChunk( sizeClass );
+
+	Block* block = freeBlocks[sizeClass];
+	freeBlocks[sizeClass] = block->next;
+	++allocated;
+	return block;
+}
+
+
+void TiXmlPoolAllocator::Deallocate( void* p, size_t size )
+{
+	size_t sizeClass = ( size - 1 ) / GRANULARITY;
+	--allocated;
+	if ( sizeClass >= SIZE_CLASSES )
+	{
+		::operator delete( p );
+		return;
+	}
+
+	Block* block = static_cast< Block* >( p );
+	block->next = freeBlocks[sizeClass];
+	freeBlocks[sizeClass] = block;
+}
+
+
+void TiXmlPoolAllocator::AddChunk( size_t sizeClass )
+{
+	// chunk header takes one granule, so the blocks keep the alignment
+	size_t blockSize = ( sizeClass + 1 ) * GRANULARITY;
+	size_t count = chunkSize > GRANULARITY + blockSize ? ( chunkSize - GRANULARITY ) / blockSize : 1;
+	size_t size = GRANULARITY + count * blockSize;
+
+	Chunk* chunk = static_cast< Chunk* >( ::operator new( size ) );
+	chunk->next = chunks;
+	chunks = chunk;
+	reserved += size;
+
+	char* first = reinterpret_cast< char* >( chunk ) + GRANULARITY;
+	for ( size_t i = count; i > 0; --i )
+	{
+		Block* block = reinterpret_cast< Block* >( first + ( i - 1 ) * blockSize );
+		block->next = freeBlocks[sizeClass];
+		freeBlocks[sizeClass] = block;
+	}
+}
+
+
 void TiXmlBase::EncodeString( const TIXML_STRING& str, TIXML_STRING* outString )
 {
 	int i=0;
@@ -141,20 +315,50 @@ TiXmlNode::TiXmlNode( NodeType _type ) : TiXmlBase()
 	lastChild = 0;
 	prev = 0;
 	next = 0;
+	childCount = 0;
+	childElementCount = 0;
+	index = 0;
+	indexPosition = 0;
+	subtreeHash = 0;
+	printedText = 0;
+	printed = false;
 }
 
 
 TiXmlNode::~TiXmlNode()
 {
+	DeleteChildren();
+	delete index;
+	delete subtreeHash;
+	delete printedText;
+}
+
+
+void TiXmlNode::DeleteChildren()
+{
+	// Children of every node are appended to the list before it is deleted,
+	// so the destructors don't recurse however deep the tree is.
 	TiXmlNode* node = firstChild;
+	TiXmlNode* last = lastChild;
 	TiXmlNode* temp = 0;
 
 	while ( node )
 	{
+		if ( node->firstChild )
+		{
+			last->next = node->firstChild;
+			last = node->lastChild;
+			node->firstChild = 0;
+			node->lastChild = 0;
+		}
 		temp = node;
 		node = node->next;
+		temp->parent = 0;	// the parents are being deleted
 		delete temp;
-	}	
+	}
+
+	firstChild = 0;
+	lastChild = 0;
 }
 
 
@@ -171,29 +375,272 @@ void TiXmlNode::Clear()
 	TiXmlNode* node = firstChild;
 	TiXmlNode* temp = 0;
 
-	while ( node )
+	// Content of the document could be kept for the next parse.
+	TiXmlDocument* document = ToDocument();
+	TiXmlNodeRecycler* recycler = ( document && document->ReuseNodes() ) ? document->Recycler() : 0;
+
+	if ( recycler )
 	{
-		temp = node;
-		node = node->next;
-		delete temp;
-	}	
+		while ( node )
+		{
+			temp = node;
+			node = node->next;
+			recycler->Release( temp );
+		}
+	}
+	else
+	{
+		DeleteChildren();
+	}
 
 	firstChild = 0;
 	lastChild = 0;
+	childCount = 0;
+	childElementCount = 0;
+	DropIndex();
+	InvalidateSubtreeCache();
 }
 
 
-TiXmlNode* TiXmlNode::LinkEndChild( TiXmlNode* node )
+void TiXmlNode::ChildLinked( const TiXmlNode* node )
+{
+	++childCount;
+	if ( node->Type() == TINYXML_ELEMENT )
+		++childElementCount;
+	DropIndex();
+	InvalidateSubtreeCache();
+}
+
+
+void TiXmlNode::ChildUnlinked( const TiXmlNode* node )
+{
+	assert( node->parent == this && childCount > 0 );
+	--childCount;
+	if ( node->Type() == TINYXML_ELEMENT )
+		--childElementCount;
+	DropIndex();
+	InvalidateSubtreeCache();
+}
+
+
+void TiXmlNode::DropIndex() const
+{
+	delete index;
+	index = 0;
+}
+
+
+void TiXmlNode::ValueChanged()
+{
+	// name of the element is the key in the parent's index
+	if ( parent && type == TINYXML_ELEMENT )
+		parent->DropIndex();
+	InvalidateSubtreeCache();
+}
+
+
+void TiXmlNode::SetSubtreeHash( unsigned long long low, unsigned long long high, int flags ) const
+{
+	if ( !subtreeHash )
+		subtreeHash = new TiXmlSubtreeHash;
+	subtreeHash->low = low;
+	subtreeHash->high = high;
+	subtreeHash->flags = flags;
+	subtreeHash->valid = true;
+}
+
+
+void TiXmlNode::InvalidateSubtreeCache() const
+{
+	// the valid hash means valid hashes of the descendants, so the ancestors
+	// above the first one without the hash don't have it either
+	for ( const TiXmlNode* node = this; node && node->SubtreeHash(); node = node->parent )
+		node->subtreeHash->valid = false;
+
+	// the same for the printed text, though the text is kept by the elements only
+	for ( const TiXmlNode* node = this; node && node->printed; node = node->parent )
+		node->printed = false;
+}
+
+
+void TiXmlNode::ClearPrintedText() const
+{
+	const TiXmlNode* node = this;
+	for ( ;; )
+	{
+		delete node->printedText;
+		node->printedText = 0;
+		node->printed = false;
+
+		if ( node->firstChild )
+		{
+			node = node->firstChild;
+			continue;
+		}
+		while ( node != this && !node->next )
+			node = node->parent;
+		if ( node == this )
+			return;
+		node = node->next;
+	}
+}
+
+
+const TiXmlNodeIndex* TiXmlNode::Index() const
+{
+	if ( !index && childIndexThreshold > 0 && childCount >= childIndexThreshold )
+	{
+		index = new TiXmlNodeIndex;
+		index->nodes.reserve( childCount );
+		index->elements.reserve( childElementCount );
+		for ( TiXmlNode* node = firstChild; node; node = node->next )
+		{
+			node->indexPosition = static_cast< int >( index->nodes.size() );
+			index->nodes.push_back( node );
+			if ( node->Type() == TINYXML_ELEMENT )
+				index->elements.push_back( static_cast< TiXmlElement* >( node ) );
+		}
+	}
+	return index;
+}
+
+
+const TiXmlElement* TiXmlNode::FindIndexedElement( const char* _value, const TiXmlNode* after, bool* indexed ) const
 {
-	assert( node->parent == 0 || node->parent == this );
-	assert( node->GetDocument() == 0 || node->GetDocument() == this->GetDocument() );
+	if ( !Index() )
+	{
+		*indexed = false;
+		return 0;
+	}
+	*indexed = true;
+
+	if ( !index->hasNames )
+	{
+		for ( size_t i = 0; i < index->elements.size(); ++i )
+			index->names[ index->elements[i]->ValueStr() ].push_back( index->elements[i] );
+		index->hasNames = true;
+	}
+
+	TiXmlNodeIndex::NameMap::const_iterator found = index->names.find( _value );
+	if ( found == index->names.end() )
+		return 0;
+
+	const TiXmlNodeIndex::ElementVector& elements = found->second;
+	TiXmlNodeIndex::ElementVector::const_iterator element = elements.begin();
+	if ( after )
+	{
+		assert( after->parent == this );
+		element = std::upper_bound( elements.begin(), elements.end(), after, TiXmlNodeIndex::Precedes );
+	}
+	return element != elements.end() ? *element : 0;
+}
+
+
+const TiXmlNode* TiXmlNode::ChildAt( int _index ) const
+{
+	if ( _index < 0 || _index >= childCount )
+		return 0;
+
+	const TiXmlNodeIndex* childIndex = Index();
+	if ( childIndex )
+		return childIndex->nodes[_index];
+
+	const TiXmlNode* node;
+	if ( _index < childCount / 2 )
+	{
+		for ( node = firstChild; _index > 0; --_index )
+			node = node->next;
+	}
+	else
+	{
+		for ( node = lastChild, _index = childCount - 1 - _index; _index > 0; --_index )
+			node = node->prev;
+	}
+	return node;
+}
+
+
+const TiXmlElement* TiXmlNode::ChildElementAt( int _index ) const
+{
+	if ( _index < 0 || _index >= childElementCount )
+		return 0;
+
+	const TiXmlNodeIndex* childIndex = Index();
+	if ( childIndex )
+		return childIndex->elements[_index];
+
+	const TiXmlElement* element;
+	if ( _index < childElementCount / 2 )
+	{
+		for ( element = FirstChildElement(); _index > 0; --_index )
+			element = element->NextSiblingElement();
+	}
+	else
+	{
+		const TiXmlNode* node = lastChild;
+		while ( node->Type() != TINYXML_ELEMENT )
+			node = node->prev;
+		element = static_cast< const TiXmlElement* >( node );
+
+		for ( _index = childElementCount - 1 - _index; _index > 0; --_index )
+			element = element->PreviousSiblingElement();
+	}
+	return element;
+}
+
+
+bool TiXmlNode::PrepareLink( TiXmlNode* node )
+{
+	if ( node->Type() == TiXmlNode::TINYXML_DOCUMENT )
+	{
+		if ( GetDocument() ) GetDocument()->SetError( TIXML_ERROR_DOCUMENT_TOP_ONLY, 0, 0, TIXML_ENCODING_UNKNOWN );
+		return false;
+	}
+
+	// the parser sets the parent of the new node before it is linked
+	if ( node->parent && ( node->prev || node->parent->firstChild == node ) )
+	{
+		// the node can't become a child of itself or of its descendant
+		for ( const TiXmlNode* ancestor = this; ancestor; ancestor = ancestor->parent )
+		{
+			if ( ancestor == node )
+				return false;
+		}
+		node->parent->UnlinkChild( node );
+	}
+	return true;
+}
+
+
+void TiXmlNode::UnlinkChild( TiXmlNode* node )
+{
+	ChildUnlinked( node );
+	if ( node->next )
+		node->next->prev = node->prev;
+	else
+		lastChild = node->prev;
 
+	if ( node->prev )
+		node->prev->next = node->next;
+	else
+		firstChild = node->next;
+
+	node->parent = 0;
+	node->prev = 0;
+	node->next = 0;
+}
+
+
+TiXmlNode* TiXmlNode::LinkEndChild( TiXmlNode* node )
+{
 	if ( node->Type() == TiXmlNode::TINYXML_DOCUMENT )
 	{
 		delete node;
 		if ( GetDocument() ) GetDocument()->SetError( TIXML_ERROR_DOCUMENT_TOP_ONLY, 0, 0, TIXML_ENCODING_UNKNOWN );
 		return 0;
 	}
+	if ( node->parent && !PrepareLink( node ) )
+		return 0;
 
 	node->parent = this;
 
@@ -206,6 +653,7 @@ TiXmlNode* TiXmlNode::LinkEndChild( TiXmlNode* node )
 		firstChild = node;			// it was an empty list.
 
 	lastChild = node;
+	ChildLinked( node );
 	return node;
 }
 
@@ -239,21 +687,7 @@ TiXmlNode* TiXmlNode::InsertBeforeChild( TiXmlNode* beforeThis, const TiXmlNode&
 	TiXmlNode* node = addThis.Clone();
 	if ( !node )
 		return 0;
-	node->parent = this;
-
-	node->next = beforeThis;
-	node->prev = beforeThis->prev;
-	if ( beforeThis->prev )
-	{
-		beforeThis->prev->next = node;
-	}
-	else
-	{
-		assert( firstChild == beforeThis );
-		firstChild = node;
-	}
-	beforeThis->prev = node;
-	return node;
+	return LinkBeforeChild( beforeThis, node );
 }
 
 
@@ -271,21 +705,7 @@ TiXmlNode* TiXmlNode::InsertAfterChild( TiXmlNode* afterThis, const TiXmlNode& a
 	TiXmlNode* node = addThis.Clone();
 	if ( !node )
 		return 0;
-	node->parent = this;
-
-	node->prev = afterThis;
-	node->next = afterThis->next;
-	if ( afterThis->next )
-	{
-		afterThis->next->prev = node;
-	}
-	else
-	{
-		assert( lastChild == afterThis );
-		lastChild = node;
-	}
-	afterThis->next = node;
-	return node;
+	return LinkAfterChild( afterThis, node );
 }
 
 
@@ -308,22 +728,77 @@ TiXmlNode* TiXmlNode::ReplaceChild( TiXmlNode* replaceThis, const TiXmlNode& wit
 	TiXmlNode* node = withThis.Clone();
 	if ( !node )
 		return 0;
+	return LinkReplaceChild( replaceThis, node );
+}
+
+
+TiXmlNode* TiXmlNode::LinkBeforeChild( TiXmlNode* beforeThis, TiXmlNode* node )
+{
+	if ( !beforeThis || beforeThis->parent != this || !node )
+		return 0;
+	if ( node == beforeThis )
+		return node;
+	if ( !PrepareLink( node ) )
+		return 0;
+
+	node->parent = this;
+
+	node->next = beforeThis;
+	node->prev = beforeThis->prev;
+	if ( beforeThis->prev )
+	{
+		beforeThis->prev->next = node;
+	}
+	else
+	{
+		assert( firstChild == beforeThis );
+		firstChild = node;
+	}
+	beforeThis->prev = node;
+	ChildLinked( node );
+	return node;
+}
+
+
+TiXmlNode* TiXmlNode::LinkAfterChild( TiXmlNode* afterThis, TiXmlNode* node )
+{
+	if ( !afterThis || afterThis->parent != this || !node )
+		return 0;
+	if ( node == afterThis )
+		return node;
+	if ( !PrepareLink( node ) )
+		return 0;
 
-	node->next = replaceThis->next;
-	node->prev = replaceThis->prev;
+	node->parent = this;
 
-	if ( replaceThis->next )
-		replaceThis->next->prev = node;
+	node->prev = afterThis;
+	node->next = afterThis->next;
+	if ( afterThis->next )
+	{
+		afterThis->next->prev = node;
+	}
 	else
+	{
+		assert( lastChild == afterThis );
 		lastChild = node;
+	}
+	afterThis->next = node;
+	ChildLinked( node );
+	return node;
+}
 
-	if ( replaceThis->prev )
-		replaceThis->prev->next = node;
-	else
-		firstChild = node;
 
-	delete replaceThis;
-	node->parent = this;
+TiXmlNode* TiXmlNode::LinkReplaceChild( TiXmlNode* replaceThis, TiXmlNode* node )
+{
+	if ( !replaceThis || replaceThis->parent != this || !node )
+		return 0;
+	if ( node == replaceThis )
+		return node;
+
+	// the node could be the descendant of the replaced one, it is moved out first
+	if ( !LinkBeforeChild( replaceThis, node ) )
+		return 0;
+	RemoveChild( replaceThis );
 	return node;
 }
 
@@ -340,20 +815,21 @@ bool TiXmlNode::RemoveChild( TiXmlNode* removeThis )
 		return false;
 	}
 
-	if ( removeThis->next )
-		removeThis->next->prev = removeThis->prev;
-	else
-		lastChild = removeThis->prev;
-
-	if ( removeThis->prev )
-		removeThis->prev->next = removeThis->next;
-	else
-		firstChild = removeThis->next;
-
+	UnlinkChild( removeThis );
 	delete removeThis;
 	return true;
 }
 
+
+TiXmlNode* TiXmlNode::DetachChild( TiXmlNode* removeThis )
+{
+	if ( !removeThis || removeThis->parent != this )
+		return 0;
+
+	UnlinkChild( removeThis );
+	return removeThis;
+}
+
 const TiXmlNode* TiXmlNode::FirstChild( const char * _value ) const
 {
 	const TiXmlNode* node;
@@ -442,6 +918,7 @@ void TiXmlElement::RemoveAttribute( const char * name )
 	{
 		attributeSet.Remove( node );
 		delete node;
+		InvalidateSubtreeCache();
 	}
 }
 
@@ -462,6 +939,11 @@ const TiXmlElement* TiXmlNode::FirstChildElement() const
 
 const TiXmlElement* TiXmlNode::FirstChildElement( const char * _value ) const
 {
+	bool indexed;
+	const TiXmlElement* element = FindIndexedElement( _value, 0, &indexed );
+	if ( indexed )
+		return element;
+
 	const TiXmlNode* node;
 
 	for (	node = FirstChild( _value );
@@ -490,8 +972,31 @@ const TiXmlElement* TiXmlNode::NextSiblingElement() const
 }
 
 
+const TiXmlElement* TiXmlNode::PreviousSiblingElement() const
+{
+	const TiXmlNode* node;
+
+	for (	node = PreviousSibling();
+			node;
+			node = node->PreviousSibling() )
+	{
+		if ( node->ToElement() )
+			return node->ToElement();
+	}
+	return 0;
+}
+
+
 const TiXmlElement* TiXmlNode::NextSiblingElement( const char * _value ) const
 {
+	if ( parent )
+	{
+		bool indexed;
+		const TiXmlElement* element = parent->FindIndexedElement( _value, this, &indexed );
+		if ( indexed )
+			return element;
+	}
+
 	const TiXmlNode* node;
 
 	for (	node = NextSibling( _value );
@@ -693,9 +1198,47 @@ int TiXmlElement::QueryDoubleAttribute( const std::string& name, double* dval )
 #endif
 
 
+TiXmlAttribute* TiXmlElement::FindOrCreateAttribute( const char* _name )
+{
+	TiXmlAttribute* attrib = attributeSet.Find( _name );
+	if ( !attrib ) {
+		attrib = TiXmlNodeRecycler::NewAttribute( GetDocument() );
+		attributeSet.Add( attrib );
+		attrib->SetName( _name );
+	}
+	InvalidateSubtreeCache();	// the value is set by the caller
+	return attrib;
+}
+
+
+#ifdef TIXML_USE_STL
+TiXmlAttribute* TiXmlElement::FindOrCreateAttribute( const std::string& _name )
+{
+	TiXmlAttribute* attrib = attributeSet.Find( _name );
+	if ( !attrib ) {
+		attrib = TiXmlNodeRecycler::NewAttribute( GetDocument() );
+		attributeSet.Add( attrib );
+		attrib->SetName( _name );
+	}
+	InvalidateSubtreeCache();	// the value is set by the caller
+	return attrib;
+}
+#endif
+
+
+void TiXmlElement::AppendAttribute( TiXmlDocument* document, const TIXML_STRING& name, const TIXML_STRING& _value )
+{
+	TiXmlAttribute* attrib = TiXmlNodeRecycler::NewAttribute( document );
+	attrib->SetName( name.c_str() );
+	attrib->SetValue( _value.c_str() );
+	attributeSet.Add( attrib );		// asserts the name is unique
+	InvalidateSubtreeCache();
+}
+
+
 void TiXmlElement::SetAttribute( const char * name, int val )
 {	
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( name );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( name );
 	if ( attrib ) {
 		attrib->SetIntValue( val );
 	}
@@ -705,7 +1248,7 @@ void TiXmlElement::SetAttribute( const char * name, int val )
 #ifdef TIXML_USE_STL
 void TiXmlElement::SetAttribute( const std::string& name, int val )
 {	
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( name );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( name );
 	if ( attrib ) {
 		attrib->SetIntValue( val );
 	}
@@ -715,7 +1258,7 @@ void TiXmlElement::SetAttribute( const std::string& name, int val )
 
 void TiXmlElement::SetDoubleAttribute( const char * name, double val )
 {	
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( name );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( name );
 	if ( attrib ) {
 		attrib->SetDoubleValue( val );
 	}
@@ -725,7 +1268,7 @@ void TiXmlElement::SetDoubleAttribute( const char * name, double val )
 #ifdef TIXML_USE_STL
 void TiXmlElement::SetDoubleAttribute( const std::string& name, double val )
 {	
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( name );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( name );
 	if ( attrib ) {
 		attrib->SetDoubleValue( val );
 	}
@@ -735,7 +1278,7 @@ void TiXmlElement::SetDoubleAttribute( const std::string& name, double val )
 
 void TiXmlElement::SetAttribute( const char * cname, const char * cvalue )
 {
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( cname );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( cname );
 	if ( attrib ) {
 		attrib->SetValue( cvalue );
 	}
@@ -745,7 +1288,7 @@ void TiXmlElement::SetAttribute( const char * cname, const char * cvalue )
 #ifdef TIXML_USE_STL
 void TiXmlElement::SetAttribute( const std::string& _name, const std::string& _value )
 {
-	TiXmlAttribute* attrib = attributeSet.FindOrCreate( _name );
+	TiXmlAttribute* attrib = FindOrCreateAttribute( _name );
 	if ( attrib ) {
 		attrib->SetValue( _value );
 	}
@@ -757,51 +1300,84 @@ void TiXmlElement::Print( FILE* cfile, int depth ) const
 {
 	int i;
 	assert( cfile );
-	for ( i=0; i<depth; i++ ) {
-		fprintf( cfile, "    " );
-	}
 
-	fprintf( cfile, "<%s", value.c_str() );
-
-	const TiXmlAttribute* attrib;
-	for ( attrib = attributeSet.First(); attrib; attrib = attrib->Next() )
+	// The subtree is walked by the parent and sibling pointers instead of the
+	// recursion: the start tag is printed when an element is entered, the end
+	// tag when its last child is done.
+	const TiXmlNode* node = this;
+	for ( ;; )
 	{
-		fprintf( cfile, " " );
-		attrib->Print( cfile, depth );
-	}
+		const TiXmlElement* element = node->ToElement();
+		if ( !element )
+		{
+			node->Print( cfile, depth );
+		}
+		else
+		{
+			for ( i=0; i<depth; i++ ) {
+				fprintf( cfile, "    " );
+			}
 
-	// There are 3 different formatting approaches:
-	// 1) An element without children is printed as a <foo /> node
-	// 2) An element with only a text child is printed as <foo> text </foo>
-	// 3) An element with children is printed on multiple lines.
-	TiXmlNode* node;
-	if ( !firstChild )
-	{
-		fprintf( cfile, " />" );
-	}
-	else if ( firstChild == lastChild && firstChild->ToText() )
-	{
-		fprintf( cfile, ">" );
-		firstChild->Print( cfile, depth + 1 );
-		fprintf( cfile, "</%s>", value.c_str() );
-	}
-	else
-	{
-		fprintf( cfile, ">" );
+			fprintf( cfile, "<%s", element->value.c_str() );
 
-		for ( node = firstChild; node; node=node->NextSibling() )
-		{
-			if ( !node->ToText() )
+			const TiXmlAttribute* attrib;
+			for ( attrib = element->attributeSet.First(); attrib; attrib = attrib->Next() )
+			{
+				fprintf( cfile, " " );
+				attrib->Print( cfile, depth );
+			}
+
+			// There are 3 different formatting approaches:
+			// 1) An element without children is printed as a <foo /> node
+			// 2) An element with only a text child is printed as <foo> text </foo>
+			// 3) An element with children is printed on multiple lines.
+			if ( !element->firstChild )
+			{
+				fprintf( cfile, " />" );
+			}
+			else if ( element->firstChild == element->lastChild && element->firstChild->ToText() )
+			{
+				fprintf( cfile, ">" );
+				element->firstChild->Print( cfile, depth + 1 );
+				fprintf( cfile, "</%s>", element->value.c_str() );
+			}
+			else
 			{
-				fprintf( cfile, "\n" );
+				fprintf( cfile, ">" );
+				node = element->firstChild;
+				++depth;
+				if ( !node->ToText() )
+				{
+					fprintf( cfile, "\n" );
+				}
+				continue;
 			}
-			node->Print( cfile, depth+1 );
 		}
-		fprintf( cfile, "\n" );
-		for( i=0; i<depth; ++i ) {
-			fprintf( cfile, "    " );
+
+		// the node is done, go to the next sibling or close the parents
+		for ( ;; )
+		{
+			if ( node == this )
+				return;
+
+			if ( node->next )
+			{
+				node = node->next;
+				if ( !node->ToText() )
+				{
+					fprintf( cfile, "\n" );
+				}
+				break;
+			}
+
+			node = node->parent;
+			--depth;
+			fprintf( cfile, "\n" );
+			for( i=0; i<depth; ++i ) {
+				fprintf( cfile, "    " );
+			}
+			fprintf( cfile, "</%s>", node->value.c_str() );
 		}
-		fprintf( cfile, "</%s>", value.c_str() );
 	}
 }
 
@@ -813,6 +1389,48 @@ void TiXmlElement::CopyTo( TiXmlElement* target ) const
 
 	// Element class: 
 	// Clone the attributes, then clone the children.
+	CopyAttributesTo( target );
+
+	// Descendants are copied without recursion: elements are copied without
+	// children and entered, other nodes are cloned.
+	const TiXmlNode* node = firstChild;
+	TiXmlNode* parent = target;
+	while ( node )
+	{
+		const TiXmlElement* element = node->ToElement();
+		TiXmlNode* copy;
+		if ( element )
+		{
+			TiXmlElement* elementCopy = new TiXmlElement( element->Value() );
+			element->TiXmlNode::CopyTo( elementCopy );
+			element->CopyAttributesTo( elementCopy );
+			copy = elementCopy;
+		}
+		else
+		{
+			copy = node->Clone();
+		}
+		parent->LinkEndChild( copy );
+
+		if ( element && element->firstChild )
+		{
+			parent = copy;
+			node = element->firstChild;
+			continue;
+		}
+
+		while ( node != this && !node->next )
+		{
+			node = node->parent;
+			parent = parent->parent;
+		}
+		node = ( node != this ) ? node->next : 0;
+	}
+}
+
+
+void TiXmlElement::CopyAttributesTo( TiXmlElement* target ) const
+{
 	const TiXmlAttribute* attribute = 0;
 	for(	attribute = attributeSet.First();
 	attribute;
@@ -820,25 +1438,47 @@ void TiXmlElement::CopyTo( TiXmlElement* target ) const
 	{
 		target->SetAttribute( attribute->Name(), attribute->Value() );
 	}
-
-	TiXmlNode* node = 0;
-	for ( node = firstChild; node; node = node->NextSibling() )
-	{
-		target->LinkEndChild( node->Clone() );
-	}
 }
 
+
 bool TiXmlElement::Accept( TiXmlVisitor* visitor ) const
 {
-	if ( visitor->VisitEnter( *this, attributeSet.First() ) ) 
+	// Same order of the calls as of the recursive visit: if a child returns
+	// false, its siblings are skipped and the parent is exited.
+	const TiXmlNode* node = this;
+	for ( ;; )
 	{
-		for ( const TiXmlNode* node=FirstChild(); node; node=node->NextSibling() )
+		bool result;
+		const TiXmlElement* element = node->ToElement();
+		if ( element )
 		{
-			if ( !node->Accept( visitor ) )
+			if ( visitor->VisitEnter( *element, element->attributeSet.First() ) && element->firstChild )
+			{
+				node = element->firstChild;
+				continue;
+			}
+			result = visitor->VisitExit( *element );
+		}
+		else
+		{
+			result = node->Accept( visitor );
+		}
+
+		for ( ;; )
+		{
+			if ( node == this )
+				return result;
+
+			if ( result && node->next )
+			{
+				node = node->next;
 				break;
+			}
+
+			node = node->parent;
+			result = visitor->VisitExit( *node->ToElement() );
 		}
 	}
-	return visitor->VisitExit( *this );
 }
 
 
@@ -866,10 +1506,165 @@ const char* TiXmlElement::GetText() const
 }
 
 
+TiXmlNodeRecycler::TiXmlNodeRecycler()
+{
+	enabled = false;
+	for ( int i = 0; i < TiXmlNode::TINYXML_TYPECOUNT; ++i )
+		nodes[i] = 0;
+	attributes = 0;
+}
+
+
+TiXmlNodeRecycler::~TiXmlNodeRecycler()
+{
+	Free();
+}
+
+
+void TiXmlNodeRecycler::SetEnabled( bool enable )
+{
+	enabled = enable;
+	if ( !enabled )
+		Free();
+}
+
+
+TiXmlNode* TiXmlNodeRecycler::NewNode( TiXmlDocument* document, TiXmlNode::NodeType type )
+{
+	TiXmlNodeRecycler* recycler = document ? document->Recycler() : 0;
+	if ( recycler && recycler->nodes[type] )
+	{
+		TiXmlNode* node = recycler->nodes[type];
+		recycler->nodes[type] = node->next;
+		node->next = 0;
+		return node;
+	}
+
+	switch ( type )
+	{
+		case TiXmlNode::TINYXML_ELEMENT:		return new TiXmlElement( "" );
+		case TiXmlNode::TINYXML_COMMENT:		return new TiXmlComment();
+		case TiXmlNode::TINYXML_UNKNOWN:		return new TiXmlUnknown();
+		case TiXmlNode::TINYXML_TEXT:			return new TiXmlText( "" );
+		case TiXmlNode::TINYXML_DECLARATION:	return new TiXmlDeclaration();
+		default:								break;
+	}
+	assert( 0 );
+	return 0;
+}
+
+
+TiXmlAttribute* TiXmlNodeRecycler::NewAttribute( TiXmlDocument* document )
+{
+	TiXmlNodeRecycler* recycler = document ? document->Recycler() : 0;
+	if ( recycler && recycler->attributes )
+	{
+		TiXmlAttribute* attribute = recycler->attributes;
+		recycler->attributes = attribute->next;
+		attribute->next = 0;
+		return attribute;
+	}
+	return new TiXmlAttribute();
+}
+
+
+void TiXmlNodeRecycler::Release( TiXmlNode* node )
+{
+	assert( node && !node->ToDocument() );
+	if ( !enabled )
+	{
+		delete node;
+		return;
+	}
+
+	// Released nodes are queued through their 'next' pointers, children are
+	// appended to the queue, so the subtree is released without recursion.
+	// The queue is kept in the reverse order, so the root is reused first.
+	TiXmlNode* last = node;
+	TiXmlNode* queued = 0;
+	node->next = 0;
+	while ( node )
+	{
+		if ( node->firstChild )
+		{
+			last->next = node->firstChild;
+			last = node->lastChild;
+		}
+		node->prev = queued;
+		queued = node;
+		node = node->next;
+	}
+
+	while ( queued )
+	{
+		TiXmlNode* current = queued;
+		queued = queued->prev;
+
+		current->firstChild = 0;
+		current->lastChild = 0;
+		current->childCount = 0;
+		current->childElementCount = 0;
+		current->DropIndex();
+		if ( current->subtreeHash )
+			current->subtreeHash->valid = false;
+		delete current->printedText;
+		current->printedText = 0;
+		current->printed = false;
+
+		current->parent = 0;
+		current->prev = 0;
+		current->userData = 0;
+		current->location.Clear();
+
+		if ( TiXmlElement* element = current->ToElement() )
+		{
+			while ( TiXmlAttribute* attribute = element->attributeSet.First() )
+			{
+				element->attributeSet.Remove( attribute );
+				attribute->document = 0;
+				attribute->prev = 0;
+				attribute->next = attributes;
+				attributes = attribute;
+			}
+		}
+		else if ( TiXmlText* text = current->ToText() )
+		{
+			text->SetCDATA( false );
+		}
+
+		current->next = nodes[current->Type()];
+		nodes[current->Type()] = current;
+	}
+}
+
+
+void TiXmlNodeRecycler::Free()
+{
+	for ( int i = 0; i < TiXmlNode::TINYXML_TYPECOUNT; ++i )
+	{
+		while ( nodes[i] )
+		{
+			TiXmlNode* node = nodes[i];
+			nodes[i] = node->next;
+			delete node;
+		}
+	}
+	while ( attributes )
+	{
+		TiXmlAttribute* attribute = attributes;
+		attributes = attribute->next;
+		delete attribute;
+	}
+}
+
+
 TiXmlDocument::TiXmlDocument() : TiXmlNode( TiXmlNode::TINYXML_DOCUMENT )
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	parseFilter = 0;
+	maxDepth = 0;
+	whiteSpaceMode = TIXML_WHITESPACE_DROP;
 	ClearError();
 }
 
@@ -877,6 +1672,9 @@ TiXmlDocument::TiXmlDocument( const char * documentName ) : TiXmlNode( TiXmlNode
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	parseFilter = 0;
+	maxDepth = 0;
+	whiteSpaceMode = TIXML_WHITESPACE_DROP;
 	value = documentName;
 	ClearError();
 }
@@ -887,6 +1685,9 @@ TiXmlDocument::TiXmlDocument( const std::string& documentName ) : TiXmlNode( TiX
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	parseFilter = 0;
+	maxDepth = 0;
+	whiteSpaceMode = TIXML_WHITESPACE_DROP;
     value = documentName;
 	ClearError();
 }
@@ -993,6 +1794,18 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 		return false;
 	}
 
+	bool result = LoadBuffer( buf, length, encoding );
+	delete [] buf;
+	return result;
+}
+
+
+bool TiXmlDocument::LoadBuffer( char* buf, size_t length, TiXmlEncoding encoding )
+{
+	// Delete the existing data:
+	Clear();
+	location.Clear();
+
 	// Process the buffer in place to normalize new lines. (See comment above.)
 	// Copies from the 'p' to 'q' pointer, where p can advance faster if
 	// a newline-carriage return is hit.
@@ -1030,8 +1843,6 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 	*q = 0;
 
 	Parse( buf, 0, encoding );
-
-	delete [] buf;
 	return !Error();
 }
 
@@ -1077,6 +1888,9 @@ void TiXmlDocument::CopyTo( TiXmlDocument* target ) const
 	target->tabsize = tabsize;
 	target->errorLocation = errorLocation;
 	target->useMicrosoftBOM = useMicrosoftBOM;
+	target->parseFilter = parseFilter;
+	target->maxDepth = maxDepth;
+	target->whiteSpaceMode = whiteSpaceMode;
 
 	TiXmlNode* node = 0;
 	for ( node = firstChild; node; node = node->NextSibling() )
@@ -1397,6 +2211,7 @@ void TiXmlDeclaration::CopyTo( TiXmlDeclaration* target ) const
 	target->version = version;
 	target->encoding = encoding;
 	target->standalone = standalone;
+	target->InvalidateSubtreeCache();
 }
 
 
@@ -1634,14 +2449,7 @@ TiXmlHandle TiXmlHandle::Child( int count ) const
 {
 	if ( node )
 	{
-		int i;
-		TiXmlNode* child = node->FirstChild();
-		for (	i=0;
-				child && i<count;
-				child = child->NextSibling(), ++i )
-		{
-			// nothing
-		}
+		TiXmlNode* child = node->ChildAt( count );
 		if ( child )
 			return TiXmlHandle( child );
 	}
@@ -1672,14 +2480,7 @@ TiXmlHandle TiXmlHandle::ChildElement( int count ) const
 {
 	if ( node )
 	{
-		int i;
-		TiXmlElement* child = node->FirstChildElement();
-		for (	i=0;
-				child && i<count;
-				child = child->NextSiblingElement(), ++i )
-		{
-			// nothing
-		}
+		TiXmlElement* child = node->ChildElementAt( count );
 		if ( child )
 			return TiXmlHandle( child );
 	}
@@ -1718,6 +2519,31 @@ bool TiXmlPrinter::VisitExit( const TiXmlDocument& )
 
 bool TiXmlPrinter::VisitEnter( const TiXmlElement& element, const TiXmlAttribute* firstAttribute )
 {
+	if ( cacheSubtrees )
+	{
+		TiXmlPrintedText* cached = element.printedText;
+		if ( element.ChildElementCount() == 0 )
+		{
+			// leaf elements are formatted about as fast as copied
+			delete cached;
+			element.printedText = 0;
+		}
+		else if ( cached && element.printed && cached->depth == depth
+				  && cached->indent == indent && cached->lineBreak == lineBreak )
+		{
+			buffer += cached->text;
+			cachedElement = &element;
+			return false;
+		}
+		else
+		{
+			if ( !cached )
+				element.printedText = cached = new TiXmlPrintedText;
+			cached->depth = -1;
+			cached->start = buffer.size();
+		}
+	}
+
 	DoIndent();
 	buffer += "<";
 	buffer += element.Value();
@@ -1755,6 +2581,12 @@ bool TiXmlPrinter::VisitEnter( const TiXmlElement& element, const TiXmlAttribute
 
 bool TiXmlPrinter::VisitExit( const TiXmlElement& element )
 {
+	if ( &element == cachedElement )
+	{
+		cachedElement = 0;
+		return true;
+	}
+
 	--depth;
 	if ( !element.FirstChild() ) 
 	{
@@ -1775,12 +2607,38 @@ bool TiXmlPrinter::VisitExit( const TiXmlElement& element )
 		buffer += ">";
 		DoLineBreak();
 	}
+	if ( cacheSubtrees )
+		KeepPrintedText( element );
 	return true;
 }
 
 
+void TiXmlPrinter::KeepPrintedText( const TiXmlElement& element )
+{
+	// the descendants are marked already, so the change of any of them resets the element
+	element.printed = true;
+	TiXmlPrintedText* cached = element.printedText;
+	if ( !cached )
+		return;
+
+	size_t length = buffer.size() - cached->start;
+	if ( length > cacheLimit )
+	{
+		delete cached;
+		element.printedText = 0;
+		return;
+	}
+	cached->text.assign( buffer, cached->start, length );
+	cached->indent = indent;
+	cached->lineBreak = lineBreak;
+	cached->depth = depth;
+}
+
+
 bool TiXmlPrinter::Visit( const TiXmlText& text )
 {
+	if ( cacheSubtrees )
+		text.printed = true;
 	if ( text.CDATA() )
 	{
 		DoIndent();
@@ -1809,6 +2667,8 @@ bool TiXmlPrinter::Visit( const TiXmlText& text )
 
 bool TiXmlPrinter::Visit( const TiXmlDeclaration& declaration )
 {
+	if ( cacheSubtrees )
+		declaration.printed = true;
 	DoIndent();
 	declaration.Print( 0, 0, &buffer );
 	DoLineBreak();
@@ -1818,6 +2678,8 @@ bool TiXmlPrinter::Visit( const TiXmlDeclaration& declaration )
 
 bool TiXmlPrinter::Visit( const TiXmlComment& comment )
 {
+	if ( cacheSubtrees )
+		comment.printed = true;
 	DoIndent();
 	buffer += "<!--";
 	buffer += comment.Value();
@@ -1829,6 +2691,8 @@ bool TiXmlPrinter::Visit( const TiXmlComment& comment )
 
 bool TiXmlPrinter::Visit( const TiXmlUnknown& unknown )
 {
+	if ( cacheSubtrees )
+		unknown.printed = true;
 	DoIndent();
 	buffer += "<";
 	buffer += unknown.Value();
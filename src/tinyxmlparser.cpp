@@ -176,23 +176,36 @@ class TiXmlParsingData
 
 	const TiXmlCursor& Cursor()	{ return cursor; }
 
+	// The document being parsed, so the nodes don't walk up to the root to find it.
+	TiXmlDocument* Document() const	{ return document; }
+
   private:
 	// Only used by the document!
-	TiXmlParsingData( const char* start, int _tabsize, int row, int col )
+	TiXmlParsingData( TiXmlDocument* _document, const char* start, int _tabsize, int row, int col )
 	{
 		assert( start );
+		document = _document;
 		stamp = start;
 		tabsize = _tabsize;
 		cursor.row = row;
 		cursor.col = col;
 	}
 
+	TiXmlDocument*	document;
 	TiXmlCursor		cursor;
 	const char*		stamp;
 	int				tabsize;
 };
 
 
+// Nodes parsed by the document get it with the parsing data, nodes parsed
+// on their own (e.g. by the push parser) look it up.
+static TiXmlDocument* ParsingDocument( TiXmlNode* node, TiXmlParsingData* data )
+{
+	return data ? data->Document() : node->GetDocument();
+}
+
+
 void TiXmlParsingData::Stamp( const char* now, TiXmlEncoding encoding )
 {
 	assert( now );
@@ -361,6 +374,77 @@ const char* TiXmlBase::SkipWhiteSpace( const char* p, TiXmlEncoding encoding )
 	return p;
 }
 
+/*static*/ const char* TiXmlBase::SkipElement( const char* p )
+{
+	assert( p && *p == '<' );
+
+	// Only the markup matters here, so jump from '<' to '<' with strchr,
+	// which the C library implements with vector instructions.
+	int depth = 0;
+	while ( p )
+	{
+		p = strchr( p, '<' );
+		if ( !p )
+			return 0;
+
+		if ( p[1] == '/' )
+		{
+			p = strchr( p, '>' );
+			if ( !p )
+				return 0;
+			++p;
+			if ( --depth == 0 )
+				return p;
+		}
+		else if ( p[1] == '!' && p[2] == '-' && p[3] == '-' )
+		{
+			p = strstr( p + 4, "-->" );
+			if ( p ) p += 3;
+		}
+		else if ( strncmp( p, "<![CDATA[", 9 ) == 0 )
+		{
+			p = strstr( p + 9, "]]>" );
+			if ( p ) p += 3;
+		}
+		else if ( p[1] == '?' )
+		{
+			p = strstr( p + 2, "?>" );
+			if ( p ) p += 2;
+		}
+		else if ( p[1] == '!' )
+		{
+			p = strchr( p, '>' );
+			if ( p ) ++p;
+		}
+		else
+		{
+			// Start tag. Attribute values may contain '>'.
+			const char* q = p + 1;
+			char quote = 0;
+			for ( ; *q; ++q )
+			{
+				if ( quote )
+				{
+					if ( *q == quote ) quote = 0;
+				}
+				else if ( *q == '"' || *q == '\'' )
+					quote = *q;
+				else if ( *q == '>' )
+					break;
+			}
+			if ( !*q )
+				return 0;
+
+			if ( q[-1] != '/' )
+				++depth;
+			else if ( depth == 0 )
+				return q + 1;
+			p = q + 1;
+		}
+	}
+	return 0;
+}
+
 #ifdef TIXML_USE_STL
 /*static*/ bool TiXmlBase::StreamWhiteSpace( std::istream * in, TIXML_STRING * tag )
 {
@@ -636,67 +720,214 @@ const char* TiXmlBase::ReadText(	const char* p,
 	return p;
 }
 
-#ifdef TIXML_USE_STL
 
-void TiXmlDocument::StreamIn( std::istream * in, TIXML_STRING * tag )
+void TiXmlStreamScanner::Reset( size_t start )
 {
-	// The basic issue with a document is that we don't know what we're
-	// streaming. Read something presumed to be a tag (and hope), then
-	// identify it, and call the appropriate stream method on the tag.
-	//
-	// This "pre-streaming" will never read the closing ">" so the
-	// sub-tag can orient itself.
+	state = SCAN_TEXT;
+	depth = 0;
+	quote = 0;
+	unitStart = 0;
+	pos = start;
+}
 
-	if ( !StreamTo( in, '<', tag ) ) 
-	{
-		SetError( TIXML_ERROR_PARSING_EMPTY, 0, 0, TIXML_ENCODING_UNKNOWN );
-		return;
-	}
 
-	while ( in->good() )
+size_t TiXmlStreamScanner::Scan( const char* data, size_t length )
+{
+	while ( pos < length )
 	{
-		int tagIndex = (int) tag->length();
-		while ( in->good() && in->peek() != '>' )
+		switch ( state )
 		{
-			int c = in->get();
-			if ( c <= 0 )
+			case SCAN_TEXT:
 			{
-				SetError( TIXML_ERROR_EMBEDDED_NULL, 0, 0, TIXML_ENCODING_UNKNOWN );
+				const char* lt = (const char*) memchr( data + pos, '<', length - pos );
+				if ( !lt )
+				{
+					pos = length;
+					break;
+				}
+				unitStart = lt - data;
+				pos = unitStart + 1;
+				state = SCAN_MARKUP;
 				break;
 			}
-			(*tag) += (char) c;
-		}
 
-		if ( in->good() )
-		{
-			// We now have something we presume to be a node of 
-			// some sort. Identify it, and call the node to
-			// continue streaming.
-			TiXmlNode* node = Identify( tag->c_str() + tagIndex, TIXML_DEFAULT_ENCODING );
+			case SCAN_MARKUP:
+			{
+				// Up to 9 bytes are needed to identify the markup, as in TiXmlNode::Identify.
+				const char* cdataHeader = "<![CDATA[";
+				const char* p = data + unitStart;
+				size_t available = length - unitStart;
+				if ( available < 2 )
+					return TIXML_STRING::npos;
+
+				if ( p[1] == '?' )
+				{
+					state = SCAN_OTHER;
+				}
+				else if ( p[1] == '!' )
+				{
+					size_t n = available < 9 ? available : 9;
+					if ( available < 4 )
+						return TIXML_STRING::npos;
+					if ( p[2] == '-' && p[3] == '-' )
+					{
+						state = SCAN_COMMENT;
+						pos = unitStart + 4;
+					}
+					else if ( strncmp( p, cdataHeader, n ) == 0 )
+					{
+						if ( n < 9 )
+							return TIXML_STRING::npos;
+						state = SCAN_CDATA;
+						pos = unitStart + 9;
+					}
+					else
+					{
+						state = SCAN_OTHER;
+					}
+				}
+				else
+				{
+					state = SCAN_TAG;
+					quote = 0;
+				}
+				break;
+			}
 
-			if ( node )
+			case SCAN_TAG:
 			{
-				node->StreamIn( in, tag );
-				bool isElement = node->ToElement() != 0;
-				delete node;
-				node = 0;
-
-				// If this is the root element, we're done. Parsing will be
-				// done by the >> operator.
-				if ( isElement )
+				// '>' could be in the quoted attribute values
+				for ( ; pos < length; ++pos )
 				{
-					return;
+					char c = data[pos];
+					if ( quote )
+					{
+						if ( c == quote )
+							quote = 0;
+					}
+					else if ( c == '"' || c == '\'' )
+						quote = c;
+					else if ( c == '>' )
+						break;
 				}
+				if ( pos == length )
+					break;
+
+				++pos;
+				state = SCAN_TEXT;
+				if ( data[unitStart + 1] == '/' )
+					--depth;
+				else if ( data[pos - 2] != '/' )
+					++depth;
+
+				if ( depth <= 0 )
+					return pos;
+				break;
 			}
-			else
+
+			case SCAN_COMMENT:
+				if ( ScanTo( data, length, "--", 4 ) )
+					state = SCAN_TEXT;
+				break;
+
+			case SCAN_CDATA:
+				if ( ScanTo( data, length, "]]", 9 ) )
+					state = SCAN_TEXT;
+				break;
+
+			case SCAN_OTHER:
+				if ( ScanTo( data, length, "", 1 ) )
+					state = SCAN_TEXT;
+				break;
+		}
+	}
+	return TIXML_STRING::npos;
+}
+
+
+bool TiXmlStreamScanner::ScanTo( const char* data, size_t length, const char* terminator, size_t openerLength )
+{
+	size_t terminatorLength = strlen( terminator );
+	while ( pos < length )
+	{
+		const char* gt = (const char*) memchr( data + pos, '>', length - pos );
+		if ( !gt )
+		{
+			pos = length;
+			return false;
+		}
+
+		size_t end = gt - data;
+		pos = end + 1;
+		if (    end >= unitStart + openerLength + terminatorLength
+			 && memcmp( gt - terminatorLength, terminator, terminatorLength ) == 0 )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+#ifdef TIXML_USE_STL
+
+bool TiXmlStreamScanner::Read( std::istream* in, TIXML_STRING* tag )
+{
+	const std::streamsize blockSize = 64 * 1024;
+
+	std::streambuf* buf = in->rdbuf();
+	if ( !in->good() || !buf )
+		return false;
+
+	for ( ;; )
+	{
+		if ( buf->sgetc() == std::char_traits< char >::eof() )
+		{
+			in->setstate( std::ios::eofbit | std::ios::failbit );
+			return false;
+		}
+
+		std::streamsize available = buf->in_avail();
+		if ( available <= 0 )
+			available = 1;
+		else if ( available > blockSize )
+			available = blockSize;
+
+		size_t length = tag->length();
+		tag->resize( length + (size_t) available );
+		tag->resize( length + (size_t) buf->sgetn( &(*tag)[length], available ) );
+
+		size_t end = Scan( tag->data(), tag->length() );
+		if ( end != TIXML_STRING::npos )
+		{
+			for ( size_t i = tag->length(); i > end; --i )
 			{
-				SetError( TIXML_ERROR, 0, 0, TIXML_ENCODING_UNKNOWN );
-				return;
+				if ( buf->sputbackc( (*tag)[i - 1] ) == std::char_traits< char >::eof() )
+				{
+					in->setstate( std::ios::badbit );
+					break;
+				}
 			}
+			tag->resize( end );
+			return true;
 		}
 	}
-	// We should have returned sooner.
-	SetError( TIXML_ERROR, 0, 0, TIXML_ENCODING_UNKNOWN );
+}
+
+
+void TiXmlDocument::StreamIn( std::istream * in, TIXML_STRING * tag )
+{
+	// The stream is read by blocks up to the end of the root element, with
+	// the declarations and comments before it. Parsing will be done by the >> operator.
+	TiXmlStreamScanner scanner;
+	scanner.Reset( tag->length() );
+	if ( !scanner.Read( in, tag ) )
+	{
+		if ( tag->empty() )
+			SetError( TIXML_ERROR_PARSING_EMPTY, 0, 0, TIXML_ENCODING_UNKNOWN );
+		else
+			SetError( TIXML_ERROR, 0, 0, TIXML_ENCODING_UNKNOWN );
+	}
 }
 
 #endif
@@ -728,7 +959,7 @@ const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiX
 		location.row = 0;
 		location.col = 0;
 	}
-	TiXmlParsingData data( p, TabSize(), location.row, location.col );
+	TiXmlParsingData data( this, p, TabSize(), location.row, location.col );
 	location = data.Cursor();
 
 	if ( encoding == TIXML_ENCODING_UNKNOWN )
@@ -753,7 +984,7 @@ const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiX
 
 	while ( p && *p )
 	{
-		TiXmlNode* node = Identify( p, encoding );
+		TiXmlNode* node = Identify( p, encoding, this );
 		if ( node )
 		{
 			p = node->Parse( p, &data, encoding );
@@ -815,7 +1046,7 @@ void TiXmlDocument::SetError( int err, const char* pError, TiXmlParsingData* dat
 }
 
 
-TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
+TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding, TiXmlDocument* document )
 {
 	TiXmlNode* returnNode = 0;
 
@@ -849,21 +1080,21 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Declaration\n" );
 		#endif
-		returnNode = new TiXmlDeclaration();
+		returnNode = TiXmlNodeRecycler::NewNode( document, TINYXML_DECLARATION );
 	}
 	else if ( StringEqual( p, commentHeader, false, encoding ) )
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Comment\n" );
 		#endif
-		returnNode = new TiXmlComment();
+		returnNode = TiXmlNodeRecycler::NewNode( document, TINYXML_COMMENT );
 	}
 	else if ( StringEqual( p, cdataHeader, false, encoding ) )
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing CDATA\n" );
 		#endif
-		TiXmlText* text = new TiXmlText( "" );
+		TiXmlText* text = TiXmlNodeRecycler::NewNode( document, TINYXML_TEXT )->ToText();
 		text->SetCDATA( true );
 		returnNode = text;
 	}
@@ -872,7 +1103,7 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Unknown(1)\n" );
 		#endif
-		returnNode = new TiXmlUnknown();
+		returnNode = TiXmlNodeRecycler::NewNode( document, TINYXML_UNKNOWN );
 	}
 	else if (    IsAlpha( *(p+1), encoding )
 			  || *(p+1) == '_' )
@@ -880,14 +1111,14 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Element\n" );
 		#endif
-		returnNode = new TiXmlElement( "" );
+		returnNode = TiXmlNodeRecycler::NewNode( document, TINYXML_ELEMENT );
 	}
 	else
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Unknown(2)\n" );
 		#endif
-		returnNode = new TiXmlUnknown();
+		returnNode = TiXmlNodeRecycler::NewNode( document, TINYXML_UNKNOWN );
 	}
 
 	if ( returnNode )
@@ -902,148 +1133,36 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 
 void TiXmlElement::StreamIn (std::istream * in, TIXML_STRING * tag)
 {
-	// We're called with some amount of pre-parsing. That is, some of "this"
-	// element is in "tag". Go ahead and stream to the closing ">"
-	while( in->good() )
+	// The element is read by blocks up to its closing tag, see TiXmlDocument::StreamIn.
+	TiXmlStreamScanner scanner;
+	scanner.Reset( tag->length() );
+	if ( !scanner.Read( in, tag ) )
 	{
-		int c = in->get();
-		if ( c <= 0 )
-		{
-			TiXmlDocument* document = GetDocument();
-			if ( document )
-				document->SetError( TIXML_ERROR_EMBEDDED_NULL, 0, 0, TIXML_ENCODING_UNKNOWN );
-			return;
-		}
-		(*tag) += (char) c ;
-		
-		if ( c == '>' )
-			break;
+		TiXmlDocument* document = GetDocument();
+		if ( document )
+			document->SetError( TIXML_ERROR_READING_END_TAG, 0, 0, TIXML_ENCODING_UNKNOWN );
 	}
+}
 
-	if ( tag->length() < 3 ) return;
-
-	// Okay...if we are a "/>" tag, then we're done. We've read a complete tag.
-	// If not, identify and stream.
-
-	if (    tag->at( tag->length() - 1 ) == '>' 
-		 && tag->at( tag->length() - 2 ) == '/' )
-	{
-		// All good!
-		return;
-	}
-	else if ( tag->at( tag->length() - 1 ) == '>' )
-	{
-		// There is more. Could be:
-		//		text
-		//		cdata text (which looks like another node)
-		//		closing tag
-		//		another node.
-		for ( ;; )
-		{
-			StreamWhiteSpace( in, tag );
-
-			// Do we have text?
-			if ( in->good() && in->peek() != '<' ) 
-			{
-				// Yep, text.
-				TiXmlText text( "" );
-				text.StreamIn( in, tag );
-
-				// What follows text is a closing tag or another node.
-				// Go around again and figure it out.
-				continue;
-			}
-
-			// We now have either a closing tag...or another node.
-			// We should be at a "<", regardless.
-			if ( !in->good() ) return;
-			assert( in->peek() == '<' );
-			int tagIndex = (int) tag->length();
-
-			bool closingTag = false;
-			bool firstCharFound = false;
-
-			for( ;; )
-			{
-				if ( !in->good() )
-					return;
-
-				int c = in->peek();
-				if ( c <= 0 )
-				{
-					TiXmlDocument* document = GetDocument();
-					if ( document )
-						document->SetError( TIXML_ERROR_EMBEDDED_NULL, 0, 0, TIXML_ENCODING_UNKNOWN );
-					return;
-				}
-				
-				if ( c == '>' )
-					break;
-
-				*tag += (char) c;
-				in->get();
-
-				// Early out if we find the CDATA id.
-				if ( c == '[' && tag->size() >= 9 )
-				{
-					size_t len = tag->size();
-					const char* start = tag->c_str() + len - 9;
-					if ( strcmp( start, "<![CDATA[" ) == 0 ) {
-						assert( !closingTag );
-						break;
-					}
-				}
-
-				if ( !firstCharFound && c != '<' && !IsWhiteSpace( c ) )
-				{
-					firstCharFound = true;
-					if ( c == '/' )
-						closingTag = true;
-				}
-			}
-			// If it was a closing tag, then read in the closing '>' to clean up the input stream.
-			// If it was not, the streaming will be done by the tag.
-			if ( closingTag )
-			{
-				if ( !in->good() )
-					return;
-
-				int c = in->get();
-				if ( c <= 0 )
-				{
-					TiXmlDocument* document = GetDocument();
-					if ( document )
-						document->SetError( TIXML_ERROR_EMBEDDED_NULL, 0, 0, TIXML_ENCODING_UNKNOWN );
-					return;
-				}
-				assert( c == '>' );
-				*tag += (char) c;
+#endif
 
-				// We are done, once we've found our closing tag.
-				return;
-			}
-			else
-			{
-				// If not a closing tag, id it, and stream.
-				const char* tagloc = tag->c_str() + tagIndex;
-				TiXmlNode* node = Identify( tagloc, TIXML_DEFAULT_ENCODING );
-				if ( !node )
-					return;
-				node->StreamIn( in, tag );
-				delete node;
-				node = 0;
+const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
+{
+	bool empty = false;
+	p = ReadStartTag( p, data, encoding, &empty );
+	if ( !p || empty )
+		return p;
 
-				// No return: go around from the beginning: text, closing tag, or node.
-			}
-		}
-	}
+	// Read the value -- which can include other elements --
+	// and the end tag.
+	return ReadValue( p, data, encoding );
 }
-#endif
 
-const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
+
+const char* TiXmlElement::ReadStartTag( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding, bool* empty )
 {
 	p = SkipWhiteSpace( p, encoding );
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
 
 	if ( !p || !*p )
 	{
@@ -1075,11 +1194,8 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 		return 0;
 	}
 
-    TIXML_STRING endTag ("</");
-	endTag += value;
-
 	// Check for and read attributes. Also look for an empty
-	// tag or an end tag.
+	// tag or the end of the start tag.
 	while ( p && *p )
 	{
 		pErr = p;
@@ -1098,48 +1214,19 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 				if ( document ) document->SetError( TIXML_ERROR_PARSING_EMPTY, p, data, encoding );		
 				return 0;
 			}
+			*empty = true;
 			return (p+1);
 		}
 		else if ( *p == '>' )
 		{
 			// Done with attributes (if there were any.)
-			// Read the value -- which can include other
-			// elements -- read the end tag, and return.
-			++p;
-			p = ReadValue( p, data, encoding );		// Note this is an Element method, and will set the error if one happens.
-			if ( !p || !*p ) {
-				// We were looking for the end tag, but found nothing.
-				// Fix for [ 1663758 ] Failure to report error on bad XML
-				if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
-				return 0;
-			}
-
-			// We should find the end tag now
-			// note that:
-			// </foo > and
-			// </foo> 
-			// are both valid end tags.
-			if ( StringEqual( p, endTag.c_str(), false, encoding ) )
-			{
-				p += endTag.length();
-				p = SkipWhiteSpace( p, encoding );
-				if ( p && *p && *p == '>' ) {
-					++p;
-					return p;
-				}
-				if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
-				return 0;
-			}
-			else
-			{
-				if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
-				return 0;
-			}
+			*empty = false;
+			return (p+1);
 		}
 		else
 		{
 			// Try to read an attribute:
-			TiXmlAttribute* attrib = new TiXmlAttribute();
+			TiXmlAttribute* attrib = TiXmlNodeRecycler::NewAttribute( document );
 			if ( !attrib )
 			{
 				return 0;
@@ -1176,9 +1263,63 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 }
 
 
+const char* TiXmlElement::ReadEndTag( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
+{
+	TiXmlDocument* document = ParsingDocument( this, data );
+
+	// We should find the end tag now
+	// note that:
+	// </foo > and
+	// </foo> 
+	// are both valid end tags.
+	// The name is compared in place, without building the end tag string.
+	if ( p[0] == '<' && p[1] == '/' && strncmp( p + 2, value.c_str(), value.length() ) == 0 )
+	{
+		p += 2 + value.length();
+		p = SkipWhiteSpace( p, encoding );
+		if ( p && *p && *p == '>' ) {
+			++p;
+			return p;
+		}
+		if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
+		return 0;
+	}
+	else
+	{
+		if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
+		return 0;
+	}
+}
+
+
+bool TiXmlElement::AcceptChild( TiXmlParseFilter* filter, const char* p ) const
+{
+	assert( filter && *p == '<' );
+
+	const char* name = p + 1;
+	const char* nameEnd = name;
+	while ( *nameEnd && !IsWhiteSpace( *nameEnd ) && *nameEnd != '/' && *nameEnd != '>' )
+		++nameEnd;
+	return filter->AcceptElement( *this, name, nameEnd - name );
+}
+
+
 const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
 {
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
+	TiXmlParseFilter* filter = document ? document->ParseFilter() : 0;
+	int maxDepth = document ? document->MaxDepth() : 0;
+	TiXmlWhiteSpaceMode whiteSpaceMode = document ? document->WhiteSpaceMode() : TIXML_WHITESPACE_DROP;
+
+	// Child elements are read in the same loop: the element being read is
+	// entered after its start tag, and left for its parent after its end tag.
+	TiXmlElement* element = this;
+	int depth = 0;
+	if ( maxDepth > 0 )
+	{
+		for ( const TiXmlNode* node = this; node && node->ToElement(); node = node->parent )
+			++depth;
+	}
 
 	// Read in text and elements in any order.
 	const char* pWithWhiteSpace = p;
@@ -1186,10 +1327,28 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 
 	while ( p && *p )
 	{
+		if ( *p == '<' && p != pWithWhiteSpace && whiteSpaceMode != TIXML_WHITESPACE_DROP )
+		{
+			// White space only text, it is already scanned, so the node
+			// is only allocated if the text is kept.
+			TiXmlText* textNode = TiXmlNodeRecycler::NewNode( document, TINYXML_TEXT )->ToText();
+			if ( data )
+			{
+				data->Stamp( pWithWhiteSpace, encoding );
+				textNode->location = data->Cursor();
+			}
+
+			if ( whiteSpaceMode == TIXML_WHITESPACE_KEEP )
+				textNode->value.assign( pWithWhiteSpace, p - pWithWhiteSpace );
+			else
+				textNode->value = " ";
+			element->LinkEndChild( textNode );
+		}
+
 		if ( *p != '<' )
 		{
 			// Take what we have, make a text element.
-			TiXmlText* textNode = new TiXmlText( "" );
+			TiXmlText* textNode = TiXmlNodeRecycler::NewNode( document, TINYXML_TEXT )->ToText();
 
 			if ( !textNode )
 			{
@@ -1208,7 +1367,9 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 			}
 
 			if ( !textNode->Blank() )
-				LinkEndChild( textNode );
+				element->LinkEndChild( textNode );
+			else if ( document )
+				document->Recycler()->Release( textNode );
 			else
 				delete textNode;
 		} 
@@ -1219,20 +1380,57 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 			// a TiXmlText in the "CDATA" style.
 			if ( StringEqual( p, "</", false, encoding ) )
 			{
-				return p;
+				p = element->ReadEndTag( p, data, encoding );
+				if ( !p || element == this )
+					return p;
+
+				element = element->parent->ToElement();
+				--depth;
+			}
+			else if ( filter && p[1] != '!' && p[1] != '?' && !element->AcceptChild( filter, p ) )
+			{
+				// Unwanted element, skip it without building the nodes.
+				const char* pErr = p;
+				p = SkipElement( p );
+				if ( !p )
+				{
+					if ( document ) document->SetError( TIXML_ERROR_PARSING_ELEMENT, pErr, data, encoding );
+					return 0;
+				}
 			}
 			else
 			{
-				TiXmlNode* node = Identify( p, encoding );
-				if ( node )
+				TiXmlNode* node = element->Identify( p, encoding, document );
+				if ( !node )
+				{
+					// the same error as the recursive parser reported
+					if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, 0, 0, encoding );
+					return 0;
+				}
+
+				TiXmlElement* child = node->ToElement();
+				if ( !child )
 				{
 					p = node->Parse( p, data, encoding );
-					LinkEndChild( node );
-				}				
-				else
+					element->LinkEndChild( node );
+				}
+				else if ( maxDepth > 0 && depth >= maxDepth )
 				{
+					if ( document ) document->SetError( TIXML_ERROR_DEPTH_EXCEEDED, p, data, encoding );
+					delete child;
 					return 0;
 				}
+				else
+				{
+					bool empty = false;
+					p = child->ReadStartTag( p, data, encoding, &empty );
+					element->LinkEndChild( child );
+					if ( p && !empty )
+					{
+						element = child;
+						++depth;
+					}
+				}
 			}
 		}
 		pWithWhiteSpace = p;
@@ -1242,8 +1440,14 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 	if ( !p )
 	{
 		if ( document ) document->SetError( TIXML_ERROR_READING_ELEMENT_VALUE, 0, 0, encoding );
-	}	
-	return p;
+	}
+	else
+	{
+		// We were looking for the end tag, but found nothing.
+		// Fix for [ 1663758 ] Failure to report error on bad XML
+		if ( document ) document->SetError( TIXML_ERROR_READING_END_TAG, p, data, encoding );
+	}
+	return 0;
 }
 
 
@@ -1274,7 +1478,7 @@ void TiXmlUnknown::StreamIn( std::istream * in, TIXML_STRING * tag )
 
 const char* TiXmlUnknown::Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
 {
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
 	p = SkipWhiteSpace( p, encoding );
 
 	if ( data )
@@ -1335,7 +1539,7 @@ void TiXmlComment::StreamIn( std::istream * in, TIXML_STRING * tag )
 
 const char* TiXmlComment::Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
 {
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
 	value = "";
 
 	p = SkipWhiteSpace( p, encoding );
@@ -1495,7 +1699,7 @@ void TiXmlText::StreamIn( std::istream * in, TIXML_STRING * tag )
 const char* TiXmlText::Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding )
 {
 	value = "";
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
 
 	if ( data )
 	{
@@ -1536,9 +1740,9 @@ const char* TiXmlText::Parse( const char* p, TiXmlParsingData* data, TiXmlEncodi
 
 		const char* end = "<";
 		p = ReadText( p, &value, ignoreWhite, end, false, encoding );
-		if ( p )
+		if ( p && *(p-1) == '<' )
 			return p-1;	// don't truncate the '<'
-		return 0;
+		return p;	// end of the input, not the '<'
 	}
 }
 
@@ -1571,7 +1775,7 @@ const char* TiXmlDeclaration::Parse( const char* p, TiXmlParsingData* data, TiXm
 	p = SkipWhiteSpace( p, _encoding );
 	// Find the beginning, find the end, and look for
 	// the stuff in-between.
-	TiXmlDocument* document = GetDocument();
+	TiXmlDocument* document = ParsingDocument( this, data );
 	if ( !p || !*p || !StringEqual( p, "<?xml", true, _encoding ) )
 	{
 		if ( document ) document->SetError( TIXML_ERROR_PARSING_DECLARATION, 0, 0, _encoding );
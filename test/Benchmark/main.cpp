@@ -0,0 +1,840 @@
+#include "compact_document.h"
+#include "diff.h"
+#include "document.h"
+#include "document_reader.h"
+#include "node_pool.h"
+#include "structural_hash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using namespace xmlpp;
+
+/** Bytes currently allocated by the operator new, benchmarks are single threaded */
+size_t allocated_bytes = 0;
+
+namespace {
+
+    /** Size of the block is stored in front of it, union keeps the malloc alignment */
+    union allocation_header
+    {
+        size_t      size;
+        long double alignment;
+    };
+
+} // anonymous namespace
+
+void* operator new(size_t size)
+{
+    allocation_header* header = static_cast<allocation_header*>( std::malloc( sizeof(allocation_header) + size ) );
+    if (!header) {
+        throw std::bad_alloc();
+    }
+
+    header->size     = size;
+    allocated_bytes += size;
+    return header + 1;
+}
+
+void operator delete(void* p) throw()
+{
+    if (p)
+    {
+        allocation_header* header = static_cast<allocation_header*>(p) - 1;
+        allocated_bytes -= header->size;
+        std::free(header);
+    }
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* p) throw()
+{
+    operator delete(p);
+}
+
+// sized versions are not forwarded to the replaced ones by every runtime
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) throw()
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t) throw()
+{
+    operator delete(p);
+}
+#endif
+
+/** Measures time of the scope and prints it on destruction */
+class scoped_timer
+{
+public:
+    explicit scoped_timer(const char* name_) :
+        name(name_),
+        start( std::clock() )
+    {}
+
+    ~scoped_timer()
+    {
+        double seconds = double( std::clock() - start ) / CLOCKS_PER_SEC;
+        std::printf("%-48s %10.3f ms\n", name, seconds * 1000.0);
+    }
+
+private:
+    const char*     name;
+    std::clock_t    start;
+};
+
+/** Make document with numElements children of the root, every child has numAttributes attributes */
+std::string make_source(int numElements, int numAttributes)
+{
+    std::ostringstream ss;
+    ss << "<root>";
+    for (int i = 0; i < numElements; ++i)
+    {
+        ss << "<item";
+        for (int j = 0; j < numAttributes; ++j) {
+            ss << " attr" << j << "=\"" << i + j << "\"";
+        }
+        ss << ">text " << i << "</item>";
+    }
+    ss << "</root>";
+    return ss.str();
+}
+
+/** Element accessors used to downcast the node by dynamic_cast on every call */
+void bench_attribute_access(int numElements, int numAttributes, int numPasses)
+{
+    std::string source = make_source(numElements, numAttributes);
+    document    doc( source.size(), source.c_str() );
+
+    element root = *doc.first_child_element("root");
+
+    // what every accessor used to do
+    {
+        scoped_timer timer("attribute access, dynamic_cast downcast");
+        size_t found = 0;
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (const_element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i)
+            {
+                const TiXmlNode* node = i->get_tixml_node();
+                for (int j = 0; j < numAttributes; ++j)
+                {
+                    const TiXmlElement* e = dynamic_cast<const TiXmlElement*>(node);
+                    found += e->Attribute("attr3") != 0;
+                }
+            }
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    {
+        scoped_timer timer("attribute access, type tag downcast");
+        size_t found = 0;
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (const_element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i)
+            {
+                const TiXmlNode* node = i->get_tixml_node();
+                for (int j = 0; j < numAttributes; ++j)
+                {
+                    const TiXmlElement* e = tixml_node_cast<TiXmlElement>(node);
+                    found += e->Attribute("attr3") != 0;
+                }
+            }
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    // xmlpp accessors
+    {
+        scoped_timer timer("element::has_attribute + get_attribute");
+        size_t found = 0;
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (const_element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i)
+            {
+                for (int j = 0; j < numAttributes; ++j)
+                {
+                    if ( i->has_attribute("attr3") ) {
+                        found += *i->get_attribute("attr3") != 0;
+                    }
+                }
+            }
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    {
+        scoped_timer timer("element::get_text");
+        size_t length = 0;
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (const_element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i) {
+                length += std::strlen( i->get_text() );
+            }
+        }
+        std::cout << "(length " << length << ")" << std::endl;
+    }
+}
+
+/** Lookups of the children by name among the many siblings */
+void bench_name_lookup(int numElements, int numLookups)
+{
+    std::ostringstream ss;
+    ss << "<Store>";
+    for (int i = 0; i < numElements; ++i) {
+        ss << "<Item" << i << "/>";
+    }
+    ss << "</Store>";
+
+    std::string source = ss.str();
+    int         thresholds[] = { 0, 1 };
+    const char* names[]      = { "first_child_element(name), no index", "first_child_element(name), name index" };
+    for (int t = 0; t < 2; ++t)
+    {
+        TiXmlNode::SetChildIndexThreshold(thresholds[t]);
+
+        document       doc( source.size(), source.c_str() );
+        element store = *doc.first_child_element("Store");
+
+        scoped_timer timer(names[t]);
+        size_t found = 0;
+        for (int i = 0; i < numLookups; ++i)
+        {
+            std::ostringstream name;
+            name << "Item" << (i * 7919) % numElements;
+            found += store.first_child_element( name.str().c_str() ) != store.end_child_element();
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+    TiXmlNode::SetChildIndexThreshold(0);
+}
+
+/** Parsing of the feed where only small part of every entry is used */
+void bench_parse_filter(int numEntries)
+{
+    std::ostringstream ss;
+    ss << "<feed>";
+    for (int i = 0; i < numEntries; ++i)
+    {
+        ss << "<entry id=\"" << i << "\"><title>entry " << i << "</title><payload>";
+        for (int j = 0; j < 9; ++j) {
+            ss << "<field name=\"f" << j << "\" type=\"string\">value " << j << "</field>";
+        }
+        ss << "</payload></entry>";
+    }
+    ss << "</feed>";
+    std::string source = ss.str();
+
+    {
+        scoped_timer timer("parse, all elements");
+        document doc( source.size(), source.c_str() );
+        std::cout << "(entries " << doc.first_child_element()->size() << ")" << std::endl;
+    }
+
+    {
+        scoped_timer timer("parse, skip payload");
+        std::set<std::string> names;
+        names.insert("payload");
+
+        document doc;
+        doc.skip_elements(names);
+        doc.set_source( source.size(), source.c_str() );
+        std::cout << "(entries " << doc.first_child_element()->size() << ")" << std::endl;
+    }
+}
+
+/** Reloading of the document from xml and from the binary format */
+void bench_binary_load(int numElements, int numAttributes)
+{
+    std::string source = make_source(numElements, numAttributes);
+    document    doc( source.size(), source.c_str() );
+
+    std::ostringstream os;
+    doc.save_binary(os);
+    std::string data = os.str();
+    std::cout << "(xml " << source.size() << " bytes, binary " << data.size() << " bytes)" << std::endl;
+
+    // documents are destroyed after the timers
+    {
+        document     loaded;
+        scoped_timer timer("load, parse xml");
+        loaded.set_source( source.size(), source.c_str() );
+    }
+
+    {
+        document     loaded;
+        scoped_timer timer("load, binary format");
+        loaded.load_binary( data.size(), data.data() );
+    }
+}
+
+/** Reading of the document from the file stream and by the file name */
+void bench_stream_load(int numElements, int numAttributes)
+{
+    std::string source = make_source(numElements, numAttributes);
+    {
+        std::ofstream file("bench_stream_load.xml", std::ios::out | std::ios::binary);
+        file.write( source.data(), source.size() );
+    }
+
+    {
+        document     loaded;
+        scoped_timer timer("load, set_file_source");
+        loaded.set_file_source("bench_stream_load.xml");
+    }
+
+    {
+        document      loaded;
+        scoped_timer  timer("load, operator>>");
+        std::ifstream file("bench_stream_load.xml", std::ios::in | std::ios::binary);
+        file >> loaded;
+    }
+
+    std::remove("bench_stream_load.xml");
+}
+
+/** Stream of small messages, one document per message */
+void bench_document_reader(int numMessages)
+{
+    std::vector<std::string> messages;
+    std::string              stream;
+    for (int i = 0; i < numMessages; ++i)
+    {
+        std::ostringstream ss;
+        ss << "<message id='" << i << "'><from>a</from><to>b</to><body>text " << i << "</body></message>\n";
+        messages.push_back( ss.str() );
+        stream += messages.back();
+    }
+
+    {
+        scoped_timer timer("messages, new document per message");
+        size_t found = 0;
+        for (size_t i = 0; i < messages.size(); ++i)
+        {
+            document doc( messages[i].size(), messages[i].c_str() );
+            found += doc.first_child_element()->size();
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    {
+        scoped_timer    timer("messages, document_reader");
+        document_reader reader( stream.size(), stream.data() );
+        document        doc;
+        size_t          found = 0;
+        while ( reader.next(doc) ) {
+            found += doc.first_child_element()->size();
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    {
+        scoped_timer    timer("messages, document_reader reusing nodes");
+        document_reader reader( stream.size(), stream.data() );
+        document        doc;
+        size_t          found = 0;
+        doc.set_reuse_nodes(true);
+        while ( reader.next(doc) ) {
+            found += doc.first_child_element()->size();
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+}
+
+/** Add the child with an attribute and text to every item and remove it */
+size_t churn_nodes(document& doc)
+{
+    size_t found = 0;
+    element_iterator root = doc.first_child_element();
+    for (element_iterator i = root->first_child_element(); i != root->end_child_element(); ++i)
+    {
+        element child("update");
+        child.set_attribute("state", "new");
+        child.set_text("value");
+        i->add_child(child);
+        found += i->size();
+        remove_node(child);
+    }
+    return found;
+}
+
+/** Children are added and removed from every element, like updates of the long lived document */
+void bench_node_churn(int numElements, int numPasses)
+{
+    std::string source = make_source(numElements, 2);
+
+    {
+        scoped_timer timer("add and remove nodes, global heap");
+        document doc( source.size(), source.c_str() );
+        size_t   found = 0;
+        for (int pass = 0; pass < numPasses; ++pass) {
+            found += churn_nodes(doc);
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+
+    {
+        scoped_timer     timer("add and remove nodes, node_pool");
+        node_pool        pool;
+        node_pool::scope scope(pool);
+        document         doc( source.size(), source.c_str() );
+        size_t           found = 0;
+        for (int pass = 0; pass < numPasses; ++pass) {
+            found += churn_nodes(doc);
+        }
+        std::cout << "(found " << found << ")" << std::endl;
+    }
+}
+
+/** Children of the root are reversed by moving every one to the front */
+void bench_move_subtrees(int numElements, int numAttributes)
+{
+    std::string source = make_source(numElements, numAttributes);
+
+    {
+        document   doc( source.size(), source.c_str() );
+        TiXmlNode* root = doc.first_child_element()->get_tixml_node();
+        {
+            scoped_timer timer("reverse children, copy and remove");
+            for (TiXmlNode* child = root->FirstChild()->NextSibling(); child; )
+            {
+                TiXmlNode* next = child->NextSibling();
+                root->InsertBeforeChild( root->FirstChild(), *child );
+                root->RemoveChild(child);
+                child = next;
+            }
+        }
+        std::cout << "(first " << root->FirstChildElement()->Attribute("attr0") << ")" << std::endl;
+    }
+
+    {
+        document         doc( source.size(), source.c_str() );
+        element_iterator root = doc.first_child_element();
+        {
+            scoped_timer timer("reverse children, insert_before_node");
+            for (element_iterator child = ++root->first_child_element(); child != root->end_child_element(); )
+            {
+                element moved = *child++;
+                element first = *root->first_child_element();
+                insert_before_node(first, moved);
+            }
+        }
+        std::cout << "(first " << root->first_child_element()->get_attribute("attr0") << ")" << std::endl;
+    }
+}
+
+/** Records of many small documents are merged into one */
+void bench_merge_documents(int numDocuments)
+{
+    std::ostringstream ss;
+    ss << "<Cars>";
+    for (int i = 0; i < 10; ++i) {
+        ss << "<Car id='" << i << "' make='make " << i << "'><Model>model " << i << "</Model><Year>2010</Year></Car>";
+    }
+    ss << "</Cars>";
+    std::string source = ss.str();
+
+    std::vector<document*> inbound;
+    for (int i = 0; i < numDocuments; ++i) {
+        inbound.push_back( new document( source.size(), source.c_str() ) );
+    }
+
+    {
+        scoped_timer timer("merge records, clone");
+        document     aggregate;
+        element      cars("Cars");
+        aggregate.add_child(cars);
+        for (size_t i = 0; i < inbound.size(); ++i)
+        {
+            TiXmlNode* root = inbound[i]->first_child_element()->get_tixml_node();
+            for (TiXmlNode* car = root->FirstChild(); car; car = car->NextSibling()) {
+                cars.get_tixml_node()->LinkEndChild( car->Clone() );
+            }
+        }
+        std::cout << "(merged " << cars.size() << ") ";
+    }
+
+    {
+        scoped_timer timer("merge records, add_child");
+        document     aggregate;
+        element      cars("Cars");
+        aggregate.add_child(cars);
+        for (size_t i = 0; i < inbound.size(); ++i)
+        {
+            element_iterator root = inbound[i]->first_child_element();
+            while ( root->size() > 0 )
+            {
+                element car = *root->first_child_element();
+                add_child(cars, car);
+            }
+        }
+        std::cout << "(merged " << cars.size() << ") ";
+    }
+
+    for (size_t i = 0; i < inbound.size(); ++i) {
+        delete inbound[i];
+    }
+}
+
+/** Parsing of the pretty printed document, white space between the tags is dropped, kept or collapsed */
+void bench_whitespace(int numEntries)
+{
+    std::ostringstream ss;
+    ss << "<feed>\n";
+    for (int i = 0; i < numEntries; ++i)
+    {
+        ss << "    <entry id=\"" << i << "\">\n        <title>entry " << i << "</title>\n        <payload>\n";
+        for (int j = 0; j < 9; ++j) {
+            ss << "            <field name=\"f" << j << "\">value " << j << "</field>\n";
+        }
+        ss << "        </payload>\n    </entry>\n";
+    }
+    ss << "</feed>\n";
+    std::string source = ss.str();
+    std::cout << "(xml " << source.size() << " bytes)" << std::endl;
+
+    const TiXmlWhiteSpaceMode modes[] = { TIXML_WHITESPACE_DROP, TIXML_WHITESPACE_KEEP, TIXML_WHITESPACE_COLLAPSE };
+    const char*               names[] = { "parse indented, drop white space", "parse indented, keep white space", "parse indented, collapse white space" };
+    for (int i = 0; i < 3; ++i)
+    {
+        document     doc;
+        doc.set_whitespace_mode(modes[i]);
+        scoped_timer timer(names[i]);
+        doc.set_source( source.size(), source.c_str() );
+    }
+}
+
+/** Deduplication of the records and detection of the changes by the structural hash */
+void bench_structural_hash(int numRecords)
+{
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < numRecords; ++i) {
+        ss << "<record id='" << i % 1000 << "' kind='k'><name>name " << i % 1000 << "</name><value>" << i % 7 << "</value></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+    document    doc( source.size(), source.c_str() );
+    element     root = *doc.first_child_element();
+
+    {
+        scoped_timer          timer("dedupe records, printed strings");
+        std::set<std::string> unique;
+        for (element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i)
+        {
+            std::ostringstream os;
+            os << *i;
+            unique.insert( os.str() );
+        }
+        std::cout << "(unique " << unique.size() << ") ";
+    }
+
+    {
+        scoped_timer         timer("dedupe records, structural_hash");
+        std::set<hash_value> unique;
+        for (element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i) {
+            unique.insert( structural_hash(*i) );
+        }
+        std::cout << "(unique " << unique.size() << ") ";
+    }
+
+    // one record is changed between the checks
+    const int numChanges = 100;
+    {
+        scoped_timer timer("detect changes, rehash document");
+        for (int i = 0; i < numChanges; ++i)
+        {
+            root.child_element(i * 7)->set_attribute("kind", i % 2 ? "a" : "b");
+            structural_hash(doc);
+        }
+    }
+
+    structural_hash(doc, CACHE_HASH);
+    {
+        scoped_timer timer("detect changes, cached hashes");
+        for (int i = 0; i < numChanges; ++i)
+        {
+            root.child_element(i * 7)->set_attribute("kind", i % 2 ? "b" : "a");
+            structural_hash(doc, CACHE_HASH);
+        }
+    }
+}
+
+/** Edit script of the few changes of the big document */
+void bench_diff(int numRecords, int numChanges)
+{
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < numRecords; ++i) {
+        ss << "<record id='" << i << "' kind='k'><name>name " << i << "</name><value>" << i % 7 << "</value></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+
+    document from( source.size(), source.c_str() );
+    document to( source.size(), source.c_str() );
+    element  root = *to.first_child_element();
+    for (int i = 0; i < numChanges; ++i) {
+        root.child_element(i * (numRecords / numChanges))->set_attribute("kind", "changed");
+    }
+
+    edit_script script;
+    {
+        scoped_timer timer("diff documents");
+        script = diff(from, to);
+    }
+
+    document saved;
+    script.save(saved);
+    std::ostringstream os;
+    os << saved;
+    std::cout << "(xml " << source.size() << " bytes, script " << os.str().size() << " bytes)" << std::endl;
+
+    {
+        scoped_timer timer("patch document");
+        patch(from, script);
+    }
+}
+
+void bench_copy_documents(int numRecords, int numCopies)
+{
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < numRecords; ++i) {
+        ss << "<record id='" << i << "' kind='k'><name>name " << i << "</name><value>" << i % 7 << "</value></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+    document    templ( source.size(), source.c_str() );
+
+    {
+        scoped_timer timer("copy template, deep copies");
+        for (int i = 0; i < numCopies; ++i)
+        {
+            TiXmlDocument copy( *templ.get_tixml_document() );
+            copy.RootElement()->FirstChildElement()->SetAttribute("kind", "changed");
+        }
+    }
+
+    {
+        scoped_timer          timer("copy template, shared copies");
+        std::vector<document> copies(numCopies, templ);
+        for (int i = 0; i < numCopies; ++i) {
+            static_cast<const document&>(copies[i]).first_child_element()->first_child_element()->get_attribute("kind");
+        }
+    }
+
+    {
+        scoped_timer timer("copy template, detached copies");
+        for (int i = 0; i < numCopies; ++i)
+        {
+            document copy(templ);
+            copy.detach();
+            copy.first_child_element()->first_child_element()->set_attribute("kind", "changed");
+        }
+    }
+}
+
+void bench_print_cache(int numRecords, int numSaves)
+{
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < numRecords; ++i) {
+        ss << "<record id='" << i << "' kind='k'><name>name " << i << "</name><value>" << i % 7 << "</value></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+    document    doc( source.size(), source.c_str() );
+    element     root = *doc.first_child_element();
+
+    // few elements are changed between the saves
+    size_t size = 0;
+    {
+        scoped_timer timer("checkpoint, print document");
+        for (int i = 0; i < numSaves; ++i)
+        {
+            for (int j = 0; j < 3; ++j) {
+                root.child_element( (i * 3 + j) * 7 % numRecords )->set_attribute("kind", i % 2 ? "a" : "b");
+            }
+            std::ostringstream os;
+            doc.print_file(os);
+        }
+    }
+
+    doc.set_print_cache(true);
+    {
+        std::ostringstream os;
+        doc.print_file(os);
+    }
+    {
+        scoped_timer timer("checkpoint, print cache");
+        for (int i = 0; i < numSaves; ++i)
+        {
+            for (int j = 0; j < 3; ++j) {
+                root.child_element( (i * 3 + j) * 7 % numRecords )->set_attribute("kind", i % 2 ? "b" : "a");
+            }
+            std::ostringstream os;
+            doc.print_file(os);
+            size = os.str().size();
+        }
+        std::cout << "(" << size << " bytes) ";
+    }
+}
+
+/** Values are saved like by text_serialization_policy::save and container_to_string::save,
+ * the serialization headers are not compiled by the benchmark.
+ */
+void bench_save_text(int numElements, int numPasses)
+{
+    std::string source = make_source(numElements, 0);
+    document    doc( source.size(), source.c_str() );
+    element     root = *doc.first_child_element();
+
+    {
+        scoped_timer timer("save values, text policy");
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            int value = pass;
+            for (element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i, ++value)
+            {
+                std::ostringstream ss;
+                ss << value;
+                i->set_text( ss.str() );
+            }
+        }
+    }
+
+    {
+        scoped_timer        timer("save containers, container to string");
+        std::vector<char>   letters(16, 'a');
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            letters[pass % letters.size()] = 'b';
+            for (element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i)
+            {
+                std::ostringstream ss;
+                std::copy( letters.begin(), letters.end(), std::ostream_iterator<char>(ss) );
+                i->set_text( ss.str().c_str() );
+            }
+        }
+        std::cout << "(children " << root.first_child_element()->child_count() << ") ";
+    }
+}
+
+/** Memory and traversal time of the read only records in the DOM and in the compact document */
+void bench_compact_document(int numRecords, int numPasses)
+{
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < numRecords; ++i) {
+        ss << "<record id='" << i << "' kind='k'><name>name " << i << "</name><value>" << i % 7 << "</value></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+
+    size_t   before = allocated_bytes;
+    document doc( source.size(), source.c_str() );
+    size_t   domBytes = allocated_bytes - before;
+
+    before = allocated_bytes;
+    compact_document compact(doc);
+    size_t           compactBytes = allocated_bytes - before;
+    std::cout << "(xml " << source.size() << " bytes, dom " << domBytes << " bytes, compact " << compactBytes
+              << " bytes, reported " << compact.get_memory_usage() << " bytes)" << std::endl;
+
+    {
+        scoped_timer timer("read records, dom");
+        size_t       length = 0;
+        element      root   = *doc.first_child_element();
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (const_element_iterator i = root.first_child_element(); i != root.end_child_element(); ++i) {
+                length += std::strlen( i->get_attribute("kind") ) + std::strlen( i->first_child_element()->get_text() );
+            }
+        }
+        std::cout << "(length " << length << ")" << std::endl;
+    }
+
+    {
+        scoped_timer             timer("read records, compact document");
+        size_t                   length = 0;
+        compact_element_iterator root   = compact.first_child_element();
+        for (int pass = 0; pass < numPasses; ++pass)
+        {
+            for (compact_element_iterator i = root->first_child_element(); i != root->end_child_element(); ++i) {
+                length += std::strlen( i->get_attribute("kind") ) + std::strlen( i->first_child_element()->get_text() );
+            }
+        }
+        std::cout << "(length " << length << ")" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+    std::cout << "attribute access" << std::endl;
+    bench_attribute_access(10000 * scale, 8, 20);
+
+    std::cout << "name lookup" << std::endl;
+    bench_name_lookup(100000 * scale, 2000);
+
+    std::cout << "parse filter" << std::endl;
+    bench_parse_filter(50000 * scale);
+
+    std::cout << "binary format" << std::endl;
+    bench_binary_load(100000 * scale, 8);
+
+    std::cout << "stream input" << std::endl;
+    bench_stream_load(100000 * scale, 8);
+
+    std::cout << "concatenated documents" << std::endl;
+    bench_document_reader(200000 * scale);
+
+    std::cout << "node churn" << std::endl;
+    bench_node_churn(100000 * scale, 10);
+
+    std::cout << "moving subtrees" << std::endl;
+    bench_move_subtrees(100000 * scale, 8);
+
+    std::cout << "merging documents" << std::endl;
+    bench_merge_documents(20000 * scale);
+
+    // scale 10 gives the 100 MB corpus
+    std::cout << "white space" << std::endl;
+    bench_whitespace(20000 * scale);
+
+    std::cout << "structural hash" << std::endl;
+    bench_structural_hash(100000 * scale);
+
+    std::cout << "diff" << std::endl;
+    bench_diff(100000 * scale, 100);
+
+    std::cout << "shared copies" << std::endl;
+    bench_copy_documents(100000 * scale, 20);
+
+    std::cout << "print cache" << std::endl;
+    bench_print_cache(100000 * scale, 20);
+
+    std::cout << "set text" << std::endl;
+    bench_save_text(100000 * scale, 20);
+
+    std::cout << "compact document" << std::endl;
+    bench_compact_document(100000 * scale, 20);
+
+    return 0;
+}
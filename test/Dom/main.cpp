@@ -0,0 +1,1665 @@
+#include "compact_document.h"
+#include "diff.h"
+#include "document.h"
+#include "document_cache.h"
+#include "document_reader.h"
+#include "node_pool.h"
+#include "push_parser.h"
+#include "query.h"
+#include "structural_hash.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#define BOOST_TEST_MODULE DomTest
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+    const char* table_source = 
+        "<table>"
+        "<!-- header -->"
+        "<row id='0'/>text<row id='1'/><column/><row id='2'/><row id='3'/>"
+        "</table>";
+
+    int row_id(const xmlpp::element& e)
+    {
+        int id = -1;
+        return e.get_attribute_value("id", id);
+    }
+
+    /// skips everything inside of the element with the specified name
+    bool skip_inside(const xmlpp::element& parent, const char* /*name*/, size_t /*length*/, const std::string& skipped)
+    {
+        return parent.get_value() != skipped;
+    }
+
+    void write_file(const char* fileName, const std::string& content)
+    {
+        std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+
+    /// compares compact element and its subtree with the DOM element
+    void check_compact(const xmlpp::element& e, const xmlpp::compact_element& c)
+    {
+        BOOST_CHECK_EQUAL( std::string( c.get_value() ), e.get_value() );
+        BOOST_CHECK_EQUAL( std::string( c.get_text() ), e.get_text() );
+
+        xmlpp::element::const_attribute_iterator         ea = e.first_attribute();
+        xmlpp::compact_element::const_attribute_iterator ca = c.first_attribute();
+        for (; ea != e.end_attribute() && ca != c.end_attribute(); ++ea, ++ca)
+        {
+            BOOST_CHECK_EQUAL( std::string( ca->get_name() ), ea->get_name() );
+            BOOST_CHECK_EQUAL( std::string( ca->get_value() ), ea->get_value() );
+        }
+        BOOST_CHECK( ea == e.end_attribute() && ca == c.end_attribute() );
+
+        xmlpp::const_element_iterator  ei = e.first_child_element();
+        xmlpp::compact_element_iterator ci = c.first_child_element();
+        for (; ei != e.end_child_element() && ci != c.end_child_element(); ++ei, ++ci) {
+            check_compact(*ei, *ci);
+        }
+        BOOST_CHECK( ei == e.end_child_element() && ci == c.end_child_element() );
+    }
+
+    std::string cached_text(const xmlpp::document_cache::document_ptr& doc)
+    {
+        const char* text = doc ? doc->first_child_element()->get_text() : 0;
+        return text ? text : "";
+    }
+
+    /// reads the document from the cache, counts snapshots that are neither of the written versions
+    void read_cached(xmlpp::document_cache& cache, const char* fileName, boost::mutex& mutex, int& failures)
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            bool failed = false;
+            try
+            {
+                std::string text = cached_text( cache.get(fileName) );
+                failed = (text != "1" && text != "22" && text != "333");
+            }
+            catch (std::exception&) {
+                failed = true;
+            }
+
+            if (failed)
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                ++failures;
+            }
+        }
+    }
+
+} // anonymous namespace
+
+// child counts are maintained on insert/remove
+BOOST_AUTO_TEST_CASE(dom_test_0)
+{
+    using namespace xmlpp;
+
+    document doc( strlen(table_source), table_source );
+    element table = *doc.first_child_element("table");
+
+    BOOST_CHECK_EQUAL( table.child_count(), 7u );
+    BOOST_CHECK_EQUAL( table.size(), 5u );
+
+    element row("row");
+    row.set_attribute_value("id", 4);
+    add_child(table, row);
+    BOOST_CHECK_EQUAL( table.child_count(), 8u );
+    BOOST_CHECK_EQUAL( table.size(), 6u );
+
+    element column = *table.first_child_element("column");
+    remove_node(column);
+    BOOST_CHECK_EQUAL( table.child_count(), 7u );
+    BOOST_CHECK_EQUAL( table.size(), 5u );
+
+    element first = *table.first_child_element();
+    element other("other");
+    replace_node(first, other);
+    BOOST_CHECK_EQUAL( table.size(), 5u );
+    BOOST_CHECK_EQUAL( std::string(table.child_element(0)->get_value()), "other" );
+
+    table.clear();
+    BOOST_CHECK_EQUAL( table.child_count(), 0u );
+    BOOST_CHECK_EQUAL( table.size(), 0u );
+}
+
+// indexed access with and without child index
+BOOST_AUTO_TEST_CASE(dom_test_1)
+{
+    using namespace xmlpp;
+
+    int thresholds[] = { 0, 1 };
+    for (int t = 0; t < 2; ++t)
+    {
+        TiXmlNode::SetChildIndexThreshold(thresholds[t]);
+
+        document doc( strlen(table_source), table_source );
+        element table = *doc.first_child_element("table");
+
+        BOOST_CHECK_EQUAL( std::string(table.child_element(2)->get_value()), "column" );
+        BOOST_CHECK_EQUAL( row_id(*table.child_element(3)), 2 );
+        BOOST_CHECK( table.child_element(5) == table.end_child_element() );
+        BOOST_CHECK( table.get_tixml_node()->ChildAt(2)->ToText() );
+        BOOST_CHECK( !table.get_tixml_node()->ChildAt(7) );
+
+        // index is dropped on mutation
+        element row("row");
+        row.set_attribute_value("id", 4);
+        insert_before_node(*table.child_element(0), row);
+        BOOST_CHECK_EQUAL( row_id(*table.child_element(0)), 4 );
+        BOOST_CHECK_EQUAL( row_id(*table.child_element(1)), 0 );
+
+        // random access iterators
+        const element& ctable = table;
+        const_indexed_element_iterator first = ctable.first_indexed_element();
+        const_indexed_element_iterator last  = ctable.end_indexed_element();
+        BOOST_CHECK_EQUAL( last - first, 6 );
+        BOOST_CHECK_EQUAL( row_id(first[5]), 3 );
+        BOOST_CHECK_EQUAL( row_id(*(last - 2)), 2 );
+
+        const_indexed_element_iterator i = first + 4;
+        --i;
+        BOOST_CHECK_EQUAL( std::string(i->get_value()), "column" );
+        ++i;
+        BOOST_CHECK_EQUAL( row_id(*i), 2 );
+
+        int count = 0;
+        for (indexed_element_iterator j = table.first_indexed_element(); j != table.end_indexed_element(); ++j) {
+            ++count;
+        }
+        BOOST_CHECK_EQUAL( count, 6 );
+    }
+
+    TiXmlNode::SetChildIndexThreshold(0);
+}
+
+// lookups by name with and without name index
+BOOST_AUTO_TEST_CASE(dom_test_2)
+{
+    using namespace xmlpp;
+
+    int thresholds[] = { 0, 1 };
+    for (int t = 0; t < 2; ++t)
+    {
+        TiXmlNode::SetChildIndexThreshold(thresholds[t]);
+
+        document doc( strlen(table_source), table_source );
+        element table = *doc.first_child_element("table");
+        TiXmlNode* tableNode = table.get_tixml_node();
+
+        BOOST_CHECK_EQUAL( row_id(*table.first_child_element("row")), 0 );
+        BOOST_CHECK( table.first_child_element("cell") == table.end_child_element() );
+        BOOST_CHECK( doc.first_child_element("table") != doc.end_child_element() );
+
+        // iterate rows by name, starting from non matching node as well
+        TiXmlElement* column = tableNode->FirstChildElement("column");
+        BOOST_CHECK_EQUAL( row_id( element(column->NextSiblingElement("row")) ), 2 );
+        BOOST_CHECK( !column->NextSiblingElement("column") );
+        BOOST_CHECK_EQUAL( row_id( element(tableNode->FirstChild()->NextSiblingElement("row")) ), 0 );
+
+        int count = 0;
+        for (TiXmlElement* row = tableNode->FirstChildElement("row"); row; row = row->NextSiblingElement("row")) {
+            BOOST_CHECK_EQUAL( row_id( element(row) ), count++ );
+        }
+        BOOST_CHECK_EQUAL( count, 4 );
+
+        // renaming invalidates index
+        column->SetValue("row");
+        BOOST_CHECK( !tableNode->FirstChildElement("column") );
+        BOOST_CHECK( tableNode->FirstChildElement("row")->NextSiblingElement("row")->NextSiblingElement("row") == column );
+
+        // so does insertion
+        element cell("cell");
+        add_child(table, cell);
+        BOOST_CHECK( table.first_child_element("cell") == element_iterator(cell) );
+        BOOST_CHECK( TiXmlHandle(tableNode).FirstChildElement("cell").ToElement() == cell.get_tixml_element() );
+    }
+
+    TiXmlNode::SetChildIndexThreshold(0);
+}
+
+// parse filter skips subtrees
+BOOST_AUTO_TEST_CASE(dom_test_3)
+{
+    using namespace xmlpp;
+
+    const char* source =
+        "<feed>"
+        "<entry id='1'><title>one</title></entry>"
+        "<ad kind='a>b'><entry id='x'/><![CDATA[</ad>]]><!-- </ad> --><ad><x/></ad>text</ad>"
+        "<entry id='2'><title>two</title><ad/></entry>"
+        "<ad/>"
+        "</feed>";
+
+    std::set<std::string> names;
+    names.insert("ad");
+
+    document doc;
+    doc.skip_elements(names);
+    doc.set_source( strlen(source), source );
+
+    element feed = *doc.first_child_element("feed");
+    BOOST_CHECK_EQUAL( feed.size(), 2u );
+    BOOST_CHECK_EQUAL( row_id( *feed.child_element(0) ), 1 );
+    BOOST_CHECK_EQUAL( row_id( *feed.child_element(1) ), 2 );
+    BOOST_CHECK_EQUAL( feed.child_element(1)->size(), 1u );
+    BOOST_CHECK_EQUAL( std::string( feed.child_element(1)->first_child_element("title")->get_text() ), "two" );
+
+    // callback gets the parent
+    document entries;
+    entries.set_parse_filter( boost::bind(&skip_inside, _1, _2, _3, std::string("entry")) );
+    entries.set_source( strlen(source), source );
+    BOOST_CHECK_EQUAL( entries.first_child_element()->size(), 4u );
+    BOOST_CHECK_EQUAL( entries.first_child_element()->child_element(0)->child_count(), 0u );
+
+    // unbalanced skipped element is an error
+    const char* broken = "<feed><ad><x></ad></feed>";
+    document    brokenDoc;
+    brokenDoc.skip_elements(names);
+    BOOST_CHECK_THROW( brokenDoc.set_source( strlen(broken), broken ), dom_error );
+
+    // empty filter parses everything
+    document all;
+    all.skip_elements(names);
+    all.set_parse_filter( document::parse_filter() );
+    all.set_source( strlen(source), source );
+    BOOST_CHECK_EQUAL( all.first_child_element()->size(), 4u );
+}
+
+// binary format round trip
+BOOST_AUTO_TEST_CASE(dom_test_4)
+{
+    using namespace xmlpp;
+
+    const char* source =
+        "\xef\xbb\xbf<?xml version='1.0' encoding='UTF-8' standalone='yes'?>"
+        "<!DOCTYPE feed>"
+        "<!-- comment -->"
+        "<feed lang='en' title='a &amp; b &lt;c&gt;'>"
+        "<entry id='1'>one &amp; two</entry>"
+        "<entry id='2'><![CDATA[<raw>]]></entry>"
+        "<entry/>"
+        "<empty></empty>"
+        "</feed>";
+
+    document doc( strlen(source), source );
+    std::ostringstream expected;
+    doc.print_file(expected);
+
+    std::ostringstream binary;
+    doc.save_binary(binary);
+    std::string data = binary.str();
+
+    document loaded;
+    loaded.load_binary( data.size(), data.data() );
+    std::ostringstream actual;
+    loaded.print_file(actual);
+    BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+    BOOST_CHECK( loaded.get_tixml_document()->MicrosoftBOM() );
+    BOOST_CHECK_EQUAL( loaded.first_child_element()->size(), 4u );
+
+    // loading replaces the content
+    loaded.load_binary( data.size(), data.data() );
+    BOOST_CHECK_EQUAL( loaded.get_tixml_document()->ChildCount(), 4 );
+
+    // corrupt data
+    BOOST_CHECK_THROW( loaded.load_binary( strlen(source), source ), dom_error );
+    BOOST_CHECK_THROW( loaded.load_binary( data.size() - 1, data.data() ), dom_error );
+    for (size_t length = 0; length < data.size(); ++length) {
+        BOOST_CHECK_THROW( loaded.load_binary( length, data.data() ), dom_error );
+    }
+    std::string extra = data + "x";
+    BOOST_CHECK_THROW( loaded.load_binary( extra.size(), extra.data() ), dom_error );
+    BOOST_CHECK_THROW( loaded.load_binary("no_such_file.bin"), file_error );
+
+    // duplicate attribute: name index of 'y' is replaced by the one of 'x'
+    const char* attributes = "<a x='1' y='2'/>";
+    std::ostringstream duplicate;
+    document( strlen(attributes), attributes ).save_binary(duplicate);
+    data = duplicate.str();
+    size_t value = data.find("\x01" "1");
+    BOOST_REQUIRE( value != std::string::npos && value > 0 );
+    data[value + 2] = data[value - 1];
+    try
+    {
+        loaded.load_binary( data.size(), data.data() );
+        BOOST_ERROR("duplicate attribute is loaded");
+    }
+    catch (dom_error& error) {
+        BOOST_CHECK_EQUAL( error.what(), std::string("Binary format error: duplicate attribute") );
+    }
+}
+
+// compressed files
+BOOST_AUTO_TEST_CASE(dom_test_5)
+{
+    using namespace xmlpp;
+
+    std::ostringstream ss;
+    ss << "<feed>";
+    for (int i = 0; i < 1000; ++i) {
+        ss << "<entry id='" << i << "'>entry " << i << "</entry>";
+    }
+    ss << "</feed>";
+    std::string source = ss.str();
+
+    document doc( source.size(), source.c_str() );
+    std::ostringstream expected;
+    doc.print_file(expected);
+
+    // text of the printed files
+    TiXmlPrinter printer;
+    doc.get_tixml_document()->Accept(&printer);
+    std::string printed = printer.Str();
+
+    if ( compression_supported(COMPRESSION_GZIP) )
+    {
+        doc.print_file("dom_test_5.xml.gz", COMPRESSION_GZIP);
+        BOOST_CHECK_EQUAL( detect_file_compression("dom_test_5.xml.gz"), COMPRESSION_GZIP );
+
+        document loaded;
+        loaded.set_file_source("dom_test_5.xml.gz");
+        std::ostringstream actual;
+        loaded.print_file(actual);
+        BOOST_CHECK( actual.str() == expected.str() );
+
+        // small blocks and short queue
+        {
+            decompressing_streambuf buffer("dom_test_5.xml.gz", 7, 2);
+            std::istream is(&buffer);
+            std::ostringstream text;
+            text << is.rdbuf();
+            BOOST_CHECK( text.str() == printed );
+        }
+
+        // consumer stops early
+        {
+            decompressing_streambuf buffer("dom_test_5.xml.gz", 16, 1);
+            BOOST_CHECK_EQUAL( buffer.sgetc(), '<' );
+        }
+
+        // truncated file
+        std::string compressed;
+        {
+            std::ifstream file("dom_test_5.xml.gz", std::ios::in | std::ios::binary);
+            compressed.assign( std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() );
+        }
+        {
+            std::ofstream file("dom_test_5_truncated.xml.gz", std::ios::out | std::ios::binary);
+            file.write( compressed.data(), compressed.size() / 2 );
+        }
+        BOOST_CHECK_THROW( loaded.set_file_source("dom_test_5_truncated.xml.gz"), file_error );
+
+        std::remove("dom_test_5.xml.gz");
+        std::remove("dom_test_5_truncated.xml.gz");
+    }
+
+    if ( !compression_supported(COMPRESSION_ZSTD) ) {
+        BOOST_CHECK_THROW( doc.print_file("dom_test_5.xml.zst", COMPRESSION_ZSTD), file_error );
+    }
+
+    // uncompressed file is passed as is
+    doc.print_file("dom_test_5.xml", COMPRESSION_NONE);
+    BOOST_CHECK_EQUAL( detect_file_compression("dom_test_5.xml"), COMPRESSION_NONE );
+    {
+        decompressing_streambuf buffer("dom_test_5.xml", 5);
+        std::istream is(&buffer);
+        std::ostringstream text;
+        text << is.rdbuf();
+        BOOST_CHECK( text.str() == printed );
+    }
+    std::remove("dom_test_5.xml");
+}
+
+// push parser
+BOOST_AUTO_TEST_CASE(dom_test_6)
+{
+    using namespace xmlpp;
+
+    const std::string source =
+        "\xef\xbb\xbf<?xml version='1.0' encoding='UTF-8'?>\n"
+        "<!DOCTYPE feed SYSTEM 'feed.dtd'>\n"
+        "<!-- comment -- with > -->\n"
+        "<feed lang='en' title=\"a &amp; b > c\">\n"
+        "  <entry id='1'>one &amp; two</entry>\n"
+        "  <entry id='2'><![CDATA[<raw> ]] ]> ]]]></entry>\n"
+        "  <entry id='3' />\n"
+        "  <?target data ?>\n"
+        "  <empty></empty >\n"
+        "</feed>\n";
+
+    document expectedDoc( source.size(), source.data() );
+    std::ostringstream expected;
+    expectedDoc.print_file(expected);
+
+    // chunks split everywhere
+    const size_t chunkSizes[] = { 1, 2, 3, 5, 7, 11, 64, 1024 };
+    for (size_t i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++i)
+    {
+        document doc;
+        push_parser parser(doc);
+        for (size_t offset = 0; offset < source.size(); offset += chunkSizes[i]) {
+            parser.feed( source.data() + offset, std::min(chunkSizes[i], source.size() - offset) );
+        }
+        parser.finish();
+
+        std::ostringstream actual;
+        doc.print_file(actual);
+        BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+        BOOST_CHECK( doc.get_tixml_document()->MicrosoftBOM() );
+    }
+
+    // depth of the open elements
+    document doc;
+    push_parser parser(doc);
+    parser.feed("<a><b", 5);
+    BOOST_CHECK_EQUAL( parser.get_depth(), 1u );
+    parser.feed("><c/>", 5);
+    BOOST_CHECK_EQUAL( parser.get_depth(), 2u );
+    BOOST_CHECK_EQUAL( doc.first_child_element()->size(), 1u );
+    parser.feed("</b></a>", 8);
+    BOOST_CHECK_EQUAL( parser.get_depth(), 0u );
+    parser.finish();
+
+    // errors
+    parser.reset();
+    BOOST_CHECK_THROW( parser.feed("<a></b>", 7), dom_error );
+    BOOST_CHECK( doc.get_tixml_document()->Error() );
+
+    parser.reset();
+    BOOST_CHECK( !doc.get_tixml_document()->Error() );
+    parser.feed("<a><b>text</b", 13);
+    BOOST_CHECK_THROW( parser.finish(), dom_error );
+    BOOST_CHECK_EQUAL( doc.get_tixml_document()->ErrorId(), int(TiXmlBase::TIXML_ERROR_UNEXPECTED_END) );
+    BOOST_CHECK_EQUAL( doc.get_tixml_document()->ErrorDesc(), std::string("Error unexpected end of input inside the markup.") );
+
+    parser.reset();
+    parser.feed("<a>", 3);
+    BOOST_CHECK_THROW( parser.finish(), dom_error );
+
+    parser.reset();
+    BOOST_CHECK_THROW( parser.feed("text<a/>", 8), dom_error );
+
+    parser.reset();
+    BOOST_CHECK_THROW( parser.finish(), dom_error );
+}
+
+// stream input reads one document and leaves the rest in the stream
+BOOST_AUTO_TEST_CASE(dom_test_7)
+{
+    using namespace xmlpp;
+
+    const std::string source =
+        "<?xml version='1.0'?>\n"
+        "<!-- comment <a> -->\n"
+        "<feed title=\"a > b\">\n"
+        "  <entry id='1'>one &amp; two</entry>\n"
+        "  <entry id='2'><![CDATA[</feed> ]]></entry>\n"
+        "  <feed/>\n"
+        "</feed>";
+
+    document expectedDoc( source.size(), source.data() );
+    std::ostringstream expected;
+    expectedDoc.print_file(expected);
+
+    std::string twice = source + "\n" + source + " tail";
+    {
+        std::istringstream is(twice);
+        document first;
+        document second;
+        is >> first >> second;
+        BOOST_CHECK( !first.get_tixml_document()->Error() );
+        BOOST_CHECK( !second.get_tixml_document()->Error() );
+
+        std::ostringstream actual;
+        first.print_file(actual);
+        BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+        actual.str("");
+        second.print_file(actual);
+        BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+
+        std::string rest;
+        is >> rest;
+        BOOST_CHECK_EQUAL( rest, "tail" );
+    }
+
+    // stream buffer returning small blocks
+    {
+        std::ofstream file("dom_test_7.xml", std::ios::out | std::ios::binary);
+        file << twice;
+    }
+    {
+        decompressing_streambuf buffer("dom_test_7.xml", 3);
+        std::istream is(&buffer);
+        document doc;
+        is >> doc;
+
+        std::ostringstream actual;
+        doc.print_file(actual);
+        BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+        BOOST_CHECK_EQUAL( is.get(), '\n' );
+    }
+    std::remove("dom_test_7.xml");
+
+    // element
+    {
+        std::istringstream is("<entry id='3'><a/>text</entry><next/>");
+        const char* rootSource = "<root><entry/></root>";
+        document doc( strlen(rootSource), rootSource );
+        element_iterator entry = doc.first_child_element()->first_child_element();
+        is >> *entry;
+        BOOST_CHECK_EQUAL( row_id(*entry), 3 );
+        BOOST_CHECK_EQUAL( entry->size(), 1u );
+        BOOST_CHECK_EQUAL( is.get(), '<' );
+    }
+
+    // truncated document
+    {
+        std::istringstream is( source.substr(0, source.size() - 3) );
+        document doc;
+        is >> doc;
+        BOOST_CHECK( doc.get_tixml_document()->Error() );
+        BOOST_CHECK( is.fail() );
+    }
+}
+
+// concatenated documents
+BOOST_AUTO_TEST_CASE(dom_test_8)
+{
+    using namespace xmlpp;
+
+    // large messages span several blocks of the reader
+    std::ostringstream ss;
+    for (int i = 0; i < 3000; ++i)
+    {
+        if (i % 3 == 0) ss << "<?xml version='1.0'?>";
+        ss << "<message id='" << i << "'>";
+        for (int j = 0; j < (i % 100 == 0 ? 5000 : 1); ++j) {
+            ss << "<a b='>'><!-- > --><![CDATA[</message>]]></a>";
+        }
+        ss << "</message>";
+        if (i % 2 == 0) ss << "\r\n";
+    }
+    const std::string source = ss.str();
+
+    {
+        document_reader reader( source.size(), source.data() );
+        document        doc;
+        int             ids = 0;
+        while ( reader.next(doc) )
+        {
+            BOOST_REQUIRE_EQUAL( row_id(*doc.first_child_element()), int(reader.get_count() - 1) );
+            ++ids;
+        }
+        BOOST_CHECK_EQUAL( ids, 3000 );
+        BOOST_CHECK( !reader.next(doc) );
+    }
+
+    {
+        std::ofstream file("dom_test_8.xml", std::ios::out | std::ios::binary);
+        file << source << "<message id='3000'><a/>";
+    }
+    {
+        document_reader reader("dom_test_8.xml");
+        document        doc;
+        while ( reader.get_count() < 3000 ) {
+            BOOST_REQUIRE( reader.next(doc) );
+        }
+        BOOST_CHECK_THROW( reader.next(doc), dom_error );
+    }
+    std::remove("dom_test_8.xml");
+    BOOST_CHECK_THROW( document_reader("no_such_file.xml"), file_error );
+
+    // malformed document in the stream
+    {
+        const char*     messages = "<a/><b></c><d/>";
+        document_reader reader( strlen(messages), messages );
+        document        doc;
+        BOOST_CHECK( reader.next(doc) );
+        BOOST_CHECK_THROW( reader.next(doc), dom_error );
+    }
+
+    // file descriptor
+    {
+        FILE* file = std::tmpfile();
+        fputs("<a/>\n<b/>\n", file);
+        rewind(file);
+        document_reader reader( fileno(file) );
+        document        doc;
+        BOOST_CHECK( reader.next(doc) );
+        BOOST_CHECK( reader.next(doc) );
+        BOOST_CHECK_EQUAL( doc.first_child_element()->get_value(), "b" );
+        BOOST_CHECK( !reader.next(doc) );
+        fclose(file);
+    }
+}
+
+// nodes are reused for the next parse
+BOOST_AUTO_TEST_CASE(dom_test_9)
+{
+    using namespace xmlpp;
+
+    const std::string first  = "<?xml version='1.0'?><feed a='1' b='2'><entry id='1'>text</entry><!-- c --><x/></feed>";
+    const std::string second = "<feed c='3'><entry id='2'><![CDATA[data]]></entry>more<entry id='3'/></feed>";
+
+    document doc;
+    doc.set_reuse_nodes(true);
+    doc.set_source( first.size(), first.c_str() );
+    const TiXmlNode*                root = doc.first_child_element()->get_tixml_node();
+    std::set<const TiXmlAttribute*> attributes;
+    for (const TiXmlAttribute* attr = root->ToElement()->FirstAttribute(); attr; attr = attr->Next()) {
+        attributes.insert(attr);
+    }
+
+    doc.reset();
+    doc.set_source( second.size(), second.c_str() );
+    BOOST_CHECK( doc.first_child_element()->get_tixml_node() == root );
+    BOOST_CHECK( attributes.count( root->ToElement()->FirstAttribute() ) );
+
+    // the result is the same as of the new document
+    document expectedDoc( second.size(), second.c_str() );
+    std::ostringstream expected;
+    expectedDoc.print_file(expected);
+    std::ostringstream actual;
+    doc.print_file(actual);
+    BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+
+    // binary format and push parser reuse the nodes too
+    std::ostringstream binary;
+    expectedDoc.save_binary(binary);
+    std::string data = binary.str();
+    doc.load_binary( data.size(), data.data() );
+    BOOST_CHECK( doc.first_child_element()->get_tixml_node() == root );
+
+    push_parser parser(doc);
+    parser.feed( first.data(), first.size() );
+    parser.finish();
+    BOOST_CHECK( doc.first_child_element()->get_tixml_node() == root );
+
+    // nodes are freed when reuse is turned off
+    doc.set_reuse_nodes(false);
+    doc.reset();
+    doc.set_source( second.size(), second.c_str() );
+    actual.str("");
+    doc.print_file(actual);
+    BOOST_CHECK_EQUAL( actual.str(), expected.str() );
+}
+
+// nodes created in the scope of the pool are allocated from it and returned to it
+BOOST_AUTO_TEST_CASE(dom_test_10)
+{
+    using namespace xmlpp;
+
+    node_pool pool;
+    {
+        document doc;
+        {
+            node_pool::scope scope(pool);
+            BOOST_CHECK( TiXmlAllocator::Current() == pool.get_tixml_allocator() );
+            doc.set_source( strlen(table_source), table_source );
+        }
+        BOOST_CHECK( TiXmlAllocator::Current() == 0 );
+
+        // table, comment, rows and their attributes, text and column
+        size_t parsed = pool.get_allocated();
+        BOOST_CHECK_EQUAL( parsed, size_t(12) );
+        BOOST_CHECK( pool.get_reserved() > 0 );
+
+        element_iterator table = doc.first_child_element("table");
+        element row;
+        {
+            node_pool::scope scope(pool);
+            row = element("row");
+            row.set_attribute("id", "4");
+            row.set_text("text");
+            table->add_child(row);
+        }
+        BOOST_CHECK_EQUAL( pool.get_allocated(), parsed + 3 );
+        BOOST_CHECK_EQUAL( table->size(), size_t(6) );
+
+        // nodes are returned to the pool out of its scope, new ones use the heap
+        remove_node(row);
+        BOOST_CHECK_EQUAL( pool.get_allocated(), parsed );
+        table->first_child_element("column")->set_text("text");
+        BOOST_CHECK_EQUAL( pool.get_allocated(), parsed );
+
+        // scopes are nested
+        node_pool inner;
+        {
+            node_pool::scope scope(pool);
+            {
+                node_pool::scope innerScope(inner);
+                BOOST_CHECK( TiXmlAllocator::Current() == inner.get_tixml_allocator() );
+            }
+            BOOST_CHECK( TiXmlAllocator::Current() == pool.get_tixml_allocator() );
+        }
+    }
+    BOOST_CHECK_EQUAL( pool.get_allocated(), size_t(0) );
+}
+
+// nodes are moved by the mutation functions, not copied
+BOOST_AUTO_TEST_CASE(dom_test_11)
+{
+    using namespace xmlpp;
+
+    int thresholds[] = { 0, 1 };
+    for (int t = 0; t < 2; ++t)
+    {
+        TiXmlNode::SetChildIndexThreshold(thresholds[t]);
+
+        document doc( strlen(table_source), table_source );
+        element_iterator table = doc.first_child_element("table");
+
+        // attached node is moved within the parent
+        element last  = *table->child_element(4);
+        element first = *table->child_element(0);
+        TiXmlNode* moved = last.get_tixml_node();
+        insert_before_node(first, last);
+        BOOST_CHECK( last.get_tixml_node() == moved );
+        BOOST_CHECK( table->child_element(0)->get_tixml_node() == moved );
+        BOOST_CHECK_EQUAL( row_id(*table->child_element(1)), 0 );
+        BOOST_CHECK_EQUAL( table->child_count(), 7u );
+        BOOST_CHECK_EQUAL( table->size(), 5u );
+
+        // insert_after_node keeps the position node
+        element row("row");
+        row.set_attribute_value("id", 4);
+        insert_after_node(first, row);
+        BOOST_CHECK( first.get_tixml_node()->NextSibling() == row.get_tixml_node() );
+        BOOST_CHECK_EQUAL( row_id(*table->child_element(2)), 4 );
+        BOOST_CHECK_EQUAL( table->size(), 6u );
+
+        // node is moved between the parents
+        element column = *table->first_child_element("column");
+        node_iterator inserted = column.insert_before_child( table->first_child(), row );
+        BOOST_CHECK( inserted == column.end_child() );
+        add_child(column, row);
+        BOOST_CHECK( row.get_parent()->get_tixml_node() == column.get_tixml_node() );
+        BOOST_CHECK_EQUAL( table->size(), 5u );
+        BOOST_CHECK_EQUAL( column.size(), 1u );
+
+        // element could be replaced by its own child
+        element child("cell");
+        column.insert_after_child( column.first_child(), child );
+        BOOST_CHECK_EQUAL( column.size(), 2u );
+        replace_node(column, row);
+        BOOST_CHECK( column.get_tixml_node() == row.get_tixml_node() );
+        BOOST_CHECK_EQUAL( row_id(*table->child_element(3)), 4 );
+        BOOST_CHECK_EQUAL( table->size(), 5u );
+        BOOST_CHECK_EQUAL( table->first_child_element("column"), table->end_child_element() );
+
+        // element can't be moved into itself or its descendant
+        BOOST_CHECK_THROW( add_child(row, *table), dom_error );
+        BOOST_CHECK_THROW( add_child(row, row), dom_error );
+        BOOST_CHECK_EQUAL( table->size(), 5u );
+
+        std::ostringstream ss;
+        doc.print_file(ss);
+        std::string expected =
+            "<table>\n"
+            "\t<!-- header -->\n"
+            "\t<row id=\"3\" />\n"
+            "\t<row id=\"0\" />\n"
+            "\ttext\n"
+            "\t<row id=\"1\" />\n"
+            "\t<row id=\"4\" />\n"
+            "\t<row id=\"2\" />\n"
+            "</table>\n";
+        BOOST_CHECK_EQUAL( ss.str(), expected );
+    }
+
+    TiXmlNode::SetChildIndexThreshold(0);
+}
+
+// subtrees are moved between the documents without copying
+BOOST_AUTO_TEST_CASE(dom_test_12)
+{
+    using namespace xmlpp;
+
+    const char* inbound_source = "<Cars><Car id='1'><Make>A</Make></Car><Car id='2'><Make>B</Make></Car></Cars>";
+
+    node_pool pool;
+    {
+        document aggregate;
+        element  cars("Cars");
+        aggregate.add_child(cars);
+
+        // inbound documents are allocated from the pool, the records outlive them
+        for (int i = 0; i < 3; ++i)
+        {
+            node_pool::scope scope(pool);
+            document inbound( strlen(inbound_source), inbound_source );
+            element_iterator first = inbound.first_child_element()->first_child_element();
+            TiXmlNode* record = first->get_tixml_node();
+            element car = *first;
+            add_child(cars, car);
+            BOOST_CHECK( cars.get_tixml_node()->LastChild() == record );
+            BOOST_CHECK( car.get_tixml_node()->GetDocument() == aggregate.get_tixml_document() );
+            BOOST_CHECK_EQUAL( inbound.first_child_element()->size(), 1u );
+        }
+        BOOST_CHECK_EQUAL( cars.size(), 3u );
+        BOOST_CHECK( pool.get_allocated() > 0 );
+
+        // detached node is owned by the caller
+        element car = *cars.first_child_element();
+        detach_node(car);
+        BOOST_CHECK( !car.get_tixml_node()->Parent() );
+        BOOST_CHECK_EQUAL( cars.size(), 2u );
+        insert_before_node(*cars.first_child_element(), car);
+        BOOST_CHECK_EQUAL( cars.size(), 3u );
+
+        detach_node(car);
+        delete car.get_tixml_node();
+        BOOST_CHECK_EQUAL( cars.size(), 2u );
+        element loose("Car");
+        BOOST_CHECK_THROW( detach_node(loose), dom_error );
+        delete loose.get_tixml_node();
+
+        // root element of the document could be detached too
+        document inbound( strlen(inbound_source), inbound_source );
+        element root = *inbound.first_child_element();
+        detach_node(root);
+        BOOST_CHECK( !inbound.get_tixml_document()->FirstChild() );
+        add_child(cars, root);
+        BOOST_CHECK_EQUAL( cars.size(), 3u );
+
+        std::ostringstream ss;
+        aggregate.print_file(ss);
+        BOOST_CHECK_EQUAL( ss.str(),
+            "<Cars>\n"
+            "\t<Car id=\"1\">\n\t\t<Make>A</Make>\n\t</Car>\n"
+            "\t<Car id=\"1\">\n\t\t<Make>A</Make>\n\t</Car>\n"
+            "\t<Cars>\n"
+            "\t\t<Car id=\"1\">\n\t\t\t<Make>A</Make>\n\t\t</Car>\n"
+            "\t\t<Car id=\"2\">\n\t\t\t<Make>B</Make>\n\t\t</Car>\n"
+            "\t</Cars>\n"
+            "</Cars>\n" );
+    }
+    BOOST_CHECK_EQUAL( pool.get_allocated(), size_t(0) );
+}
+
+// deep documents are parsed, copied, printed and deleted without recursion
+BOOST_AUTO_TEST_CASE(dom_test_13)
+{
+    using namespace xmlpp;
+
+    const int depth = 200000;
+    std::string source;
+    for (int i = 0; i < depth; ++i) {
+        source += "<e a=\"1\">";
+    }
+    source += "text";
+    for (int i = 0; i < depth; ++i) {
+        source += "</e>";
+    }
+
+    {
+        document doc( source.size(), source.c_str() );
+        const TiXmlNode* node = doc.get_tixml_document();
+        int count = 0;
+        while ( const TiXmlElement* child = node->FirstChildElement() )
+        {
+            node = child;
+            ++count;
+        }
+        BOOST_CHECK_EQUAL( count, depth );
+        BOOST_CHECK_EQUAL( std::string( node->ToElement()->GetText() ), "text" );
+
+        // printing and copying keep the results of the recursive versions
+        std::ostringstream ss;
+        ss << doc;
+        BOOST_CHECK( ss.str() == source );
+
+        TiXmlDocument copy( *doc.get_tixml_document() );
+        std::ostringstream copied;
+        copied << copy;
+        BOOST_CHECK( copied.str() == source );
+
+        std::ostringstream binary;
+        doc.save_binary(binary);
+        std::string data = binary.str();
+        document loaded;
+        loaded.load_binary( data.size(), data.data() );
+        std::ostringstream reloaded;
+        reloaded << loaded;
+        BOOST_CHECK( reloaded.str() == source );
+
+        // reused nodes are released without recursion too
+        doc.set_reuse_nodes(true);
+        doc.reset();
+        doc.set_source( source.size(), source.c_str() );
+    }
+
+    // depth limit
+    const char* nested = "<a><b><c/></b><b>text</b></a>";
+    document doc;
+    doc.set_max_depth(3);
+    doc.set_source( strlen(nested), nested );
+
+    doc.reset();
+    doc.set_max_depth(2);
+    BOOST_CHECK_THROW( doc.set_source( strlen(nested), nested ), dom_error );
+    BOOST_CHECK_EQUAL( doc.get_tixml_document()->ErrorId(), int(TiXmlBase::TIXML_ERROR_DEPTH_EXCEEDED) );
+
+    push_parser parser(doc);
+    BOOST_CHECK_THROW( parser.feed( nested, strlen(nested) ), dom_error );
+    BOOST_CHECK_EQUAL( doc.get_tixml_document()->ErrorId(), int(TiXmlBase::TIXML_ERROR_DEPTH_EXCEEDED) );
+}
+
+// white space only text is dropped, kept or collapsed
+BOOST_AUTO_TEST_CASE(dom_test_14)
+{
+    using namespace xmlpp;
+
+    const char* source = "<a>\n  <b>x</b>\n  <c/>\n</a>";
+
+    document doc( strlen(source), source );
+    BOOST_CHECK_EQUAL( doc.get_tixml_document()->RootElement()->ChildCount(), 2 );
+
+    doc.reset();
+    doc.set_whitespace_mode(TIXML_WHITESPACE_KEEP);
+    doc.set_source( strlen(source), source );
+    const TiXmlNode* root = doc.get_tixml_document()->RootElement();
+    BOOST_CHECK_EQUAL( root->ChildCount(), 5 );
+    BOOST_CHECK_EQUAL( root->FirstChild()->ValueStr(), "\n  " );
+    BOOST_CHECK_EQUAL( root->LastChild()->ValueStr(), "\n" );
+    BOOST_CHECK_EQUAL( root->FirstChild()->NextSibling()->FirstChild()->ValueStr(), "x" );
+    BOOST_CHECK_EQUAL( root->FirstChild()->Row(), 1 );
+    BOOST_CHECK_EQUAL( root->FirstChild()->Column(), 4 );
+
+    doc.reset();
+    doc.set_whitespace_mode(TIXML_WHITESPACE_COLLAPSE);
+    doc.set_source( strlen(source), source );
+    root = doc.get_tixml_document()->RootElement();
+    BOOST_CHECK_EQUAL( root->ChildCount(), 5 );
+    BOOST_CHECK_EQUAL( root->FirstChild()->ValueStr(), " " );
+    BOOST_CHECK_EQUAL( root->LastChild()->ValueStr(), " " );
+
+    // push parser builds the same nodes
+    doc.set_whitespace_mode(TIXML_WHITESPACE_KEEP);
+    push_parser parser(doc);
+    for (const char* p = source; *p; ++p) {
+        parser.feed(p, 1);
+    }
+    parser.finish();
+    root = doc.get_tixml_document()->RootElement();
+    BOOST_CHECK_EQUAL( root->ChildCount(), 5 );
+    BOOST_CHECK_EQUAL( root->FirstChild()->ValueStr(), "\n  " );
+    BOOST_CHECK_EQUAL( root->LastChild()->ValueStr(), "\n" );
+}
+
+// subtrees are compared and hashed structurally
+BOOST_AUTO_TEST_CASE(dom_test_15)
+{
+    using namespace xmlpp;
+
+    const char* source   = "<?xml version='1.0'?><cfg><a x='1' y='2'>text</a><!-- c --><b/></cfg>";
+    const char* reversed = "<?xml version='1.0'?><cfg><a y='2' x='1'>text</a><!-- c --><b/></cfg>";
+    const char* changed  = "<?xml version='1.0'?><cfg><a x='1' y='2'>text</a><!-- c --><b z='3'/></cfg>";
+
+    document doc( strlen(source), source );
+    document same( strlen(source), source );
+    document other( strlen(reversed), reversed );
+    document modified( strlen(changed), changed );
+
+    BOOST_CHECK( !(doc == same) );
+    BOOST_CHECK( deep_equal(doc, same) );
+    BOOST_CHECK( structural_hash(doc) == structural_hash(same) );
+    BOOST_CHECK( !deep_equal(doc, modified) );
+    BOOST_CHECK( structural_hash(doc) != structural_hash(modified) );
+
+    // attribute order
+    BOOST_CHECK( !deep_equal(doc, other) );
+    BOOST_CHECK( structural_hash(doc) != structural_hash(other) );
+    BOOST_CHECK( deep_equal(doc, other, IGNORE_ATTRIBUTE_ORDER) );
+    BOOST_CHECK( structural_hash(doc, IGNORE_ATTRIBUTE_ORDER) == structural_hash(other, IGNORE_ATTRIBUTE_ORDER) );
+
+    // subtrees of the different documents
+    BOOST_CHECK( deep_equal( *doc.first_child_element(), *same.first_child_element() ) );
+    BOOST_CHECK( structural_hash( *doc.first_child_element()->first_child_element(), IGNORE_ATTRIBUTE_ORDER )
+                 == structural_hash( *other.first_child_element()->first_child_element(), IGNORE_ATTRIBUTE_ORDER ) );
+
+    // hashes of all the subtrees are stored to the table in the document order, the nodes are not modified
+    hash_table table;
+    BOOST_CHECK( structural_hash(modified, IGNORE_ATTRIBUTE_ORDER | CACHE_HASH, table) == structural_hash(modified, IGNORE_ATTRIBUTE_ORDER) );
+    BOOST_CHECK( modified.get_tixml_document()->SubtreeHash() == 0 );
+    BOOST_REQUIRE_EQUAL( table.size(), 7u );
+    BOOST_CHECK_EQUAL( table[0].size, 7u );
+    BOOST_CHECK_EQUAL( table[1].size, 1u );     // declaration
+    BOOST_CHECK_EQUAL( table[2].size, 5u );     // cfg
+    BOOST_CHECK_EQUAL( table[3].size, 2u );     // a
+    BOOST_CHECK( table[2].hash == structural_hash( *modified.first_child_element(), IGNORE_ATTRIBUTE_ORDER ) );
+    BOOST_CHECK( table[6].hash == structural_hash( *modified.first_child_element()->first_child_element("b"), IGNORE_ATTRIBUTE_ORDER ) );
+
+    // cached hashes are dropped when the subtree changes
+    hash_value hash = structural_hash(doc, CACHE_HASH);
+    BOOST_CHECK( hash == structural_hash(doc) );
+    BOOST_CHECK( doc.get_tixml_document()->SubtreeHash() != 0 );
+    BOOST_CHECK( doc.get_tixml_document()->RootElement()->FirstChild()->SubtreeHash() != 0 );
+
+    element b = *doc.first_child_element()->first_child_element("b");
+    b.set_attribute("z", "3");
+    BOOST_CHECK( doc.get_tixml_document()->SubtreeHash() == 0 );
+    BOOST_CHECK( doc.get_tixml_document()->RootElement()->FirstChild()->SubtreeHash() != 0 );
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) == structural_hash(modified) );
+    BOOST_CHECK( deep_equal(doc, modified) );
+
+    b.get_tixml_node()->ToElement()->RemoveAttribute("z");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) == hash );
+
+    TiXmlNode* text = doc.first_child_element()->first_child_element("a")->get_tixml_node()->FirstChild();
+    text->SetValue("other");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) != hash );
+    text->SetValue("text");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) == hash );
+
+    // changes through the attribute wrappers are tracked, diff finds them
+    document copy( strlen(source), source );
+    BOOST_CHECK( diff(copy, doc).empty() );
+    attribute x = *doc.first_child_element()->first_child_element("a")->first_attribute("x");
+    x.set_value("9");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) != hash );
+    BOOST_CHECK_EQUAL( diff(copy, doc).size(), size_t(1) );
+    x.set_name("w");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) != hash );
+    x.set_name("x");
+    x.set_value("1");
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) == hash );
+    BOOST_CHECK( diff(copy, doc).empty() );
+
+    // moved subtree drops the hashes of both parents
+    structural_hash(same, CACHE_HASH);
+    element moved = *same.first_child_element()->first_child_element("b");
+    add_child(*doc.first_child_element(), moved);
+    BOOST_CHECK( same.get_tixml_document()->SubtreeHash() == 0 );
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) != hash );
+    BOOST_CHECK( !deep_equal(doc, modified) );
+
+    // reused nodes don't keep the hashes
+    doc.set_reuse_nodes(true);
+    doc.reset();
+    doc.set_source( strlen(source), source );
+    BOOST_CHECK( doc.get_tixml_document()->RootElement()->FirstChild()->SubtreeHash() == 0 );
+    BOOST_CHECK( structural_hash(doc, CACHE_HASH) == hash );
+}
+
+// edit script transforms one document into another
+BOOST_AUTO_TEST_CASE(dom_test_16)
+{
+    using namespace xmlpp;
+
+    const char* sources[][2] =
+    {
+        { "<cfg><a x='1'>text</a><b/><c/></cfg>", "<cfg><a x='1'>text</a><b/><c/></cfg>" },
+        { "<cfg><a x='1'>text</a><b/><c/></cfg>", "<cfg><a x='2' y='3'>other</a><b/><c/></cfg>" },
+        { "<cfg><a x='1'>text</a><b/><c/></cfg>", "<cfg><c/><a x='1'>text</a><b/></cfg>" },
+        { "<cfg><a x='1'>text</a><b/><c/></cfg>", "<cfg><b/><d><e/></d><!-- c --></cfg>" },
+        { "<cfg><a><b><c z='1'/></b></a></cfg>", "<cfg><a><b><c/>text</b></a></cfg>" },
+        { "<?xml version='1.0'?><cfg/>", "<?xml version='1.1'?><other>text</other>" },
+    };
+
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i)
+    {
+        document from( strlen(sources[i][0]), sources[i][0] );
+        document to( strlen(sources[i][1]), sources[i][1] );
+
+        edit_script script = diff(from, to);
+        BOOST_CHECK_EQUAL( script.empty(), i == 0 );
+        BOOST_CHECK( from.get_tixml_document()->SubtreeHash() == 0 );
+        BOOST_CHECK( to.get_tixml_document()->SubtreeHash() == 0 );
+
+        // script is saved as xml and in the binary format
+        document saved;
+        script.save(saved);
+        std::ostringstream text;
+        text << saved;
+        document parsed( text.str().size(), text.str().c_str() );
+        edit_script loaded;
+        loaded.load(parsed);
+        BOOST_CHECK_EQUAL( loaded.size(), script.size() );
+
+        std::ostringstream binary;
+        saved.save_binary(binary);
+        document binaryLoaded;
+        binaryLoaded.load_binary( binary.str().size(), binary.str().data() );
+        edit_script binaryScript;
+        binaryScript.load(binaryLoaded);
+
+        document patched( strlen(sources[i][0]), sources[i][0] );
+        patch(patched, loaded);
+        BOOST_CHECK( deep_equal(patched, to) );
+
+        document binaryPatched( strlen(sources[i][0]), sources[i][0] );
+        patch(binaryPatched, binaryScript);
+        BOOST_CHECK( deep_equal(binaryPatched, to) );
+    }
+
+    // small change of the big document gives the small script
+    std::ostringstream ss;
+    ss << "<records>";
+    for (int i = 0; i < 1000; ++i) {
+        ss << "<record id='" << i << "'><name>name " << i << "</name></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+    document from( source.size(), source.c_str() );
+    document to( source.size(), source.c_str() );
+    element  records = *to.first_child_element();
+    records.child_element(10)->set_attribute("id", "changed");
+    remove_node( *records.child_element(500) );
+    element inserted("record");
+    insert_before_node( *records.child_element(700), inserted );
+
+    edit_script script = diff(from, to);
+    BOOST_CHECK_EQUAL( script.size(), 3u );
+    patch(from, script);
+    BOOST_CHECK( deep_equal(from, to) );
+
+    // random edits
+    std::srand(16);
+    for (int n = 0; n < 50; ++n)
+    {
+        document a( source.size(), source.c_str() );
+        document b( source.size(), source.c_str() );
+        for (int k = 0; k < 20; ++k)
+        {
+            TiXmlNode* root = b.get_tixml_document()->RootElement();
+            TiXmlNode* record = root->ChildAt( std::rand() % root->ChildCount() );
+            switch ( std::rand() % 4 )
+            {
+                case 0: root->RemoveChild(record); break;
+                case 1: root->LinkEndChild(record); break;
+                case 2: record->ToElement()->SetAttribute("id", k); break;
+                case 3: record->FirstChild()->FirstChild()->SetValue("changed"); break;
+            }
+        }
+
+        patch( a, diff(a, b) );
+        BOOST_CHECK( deep_equal(a, b) );
+    }
+
+    // script doesn't fit the document
+    edit_script::operation op;
+    op.kind = edit_script::operation::DELETE_NODE;
+    op.path.push_back(0);
+    op.path.push_back(5000);
+    edit_script invalid;
+    invalid.add_operation(op);
+    BOOST_CHECK_THROW( patch(from, invalid), dom_error );
+}
+
+// copies of the document share the tree for reading
+BOOST_AUTO_TEST_CASE(dom_test_17)
+{
+    using namespace xmlpp;
+
+    const char* source = "<cfg><a x=\"1\">text</a><b/></cfg>";
+
+    document templ( strlen(source), source );
+    const document& constTempl = templ;
+    document copy(templ);
+    const document& constCopy = copy;
+    BOOST_CHECK( copy.is_shared() && templ.is_shared() );
+    BOOST_CHECK( constCopy.get_tixml_node() == constTempl.get_tixml_node() );
+
+    // reading doesn't copy
+    BOOST_CHECK( deep_equal(constCopy, constTempl) );
+    BOOST_CHECK_EQUAL( constCopy.first_child_element()->first_child_element()->get_attribute("x"), std::string("1") );
+    BOOST_CHECK( copy.is_shared() );
+
+    // navigation doesn't copy either, the shared tree can't be modified through the wrappers
+    element_iterator a = copy.first_child_element()->first_child_element();
+    BOOST_CHECK( copy.is_shared() );
+    BOOST_CHECK_THROW( a->set_attribute("x", "2"), dom_error );
+    BOOST_CHECK_THROW( a->first_attribute()->set_value("2"), dom_error );
+    BOOST_CHECK_THROW( a->set_text("changed"), dom_error );
+    BOOST_CHECK_THROW( remove_node(*a), dom_error );
+    BOOST_CHECK( deep_equal(constCopy, constTempl) );
+
+    // detached copy is modified, template is not changed
+    copy.detach();
+    BOOST_CHECK( !copy.is_shared() && !templ.is_shared() );
+    copy.first_child_element()->first_child_element()->set_attribute("x", "2");
+    BOOST_CHECK( constCopy.get_tixml_node() != constTempl.get_tixml_node() );
+    BOOST_CHECK_EQUAL( constTempl.first_child_element()->first_child_element()->get_attribute("x"), std::string("1") );
+    BOOST_CHECK_EQUAL( constCopy.first_child_element()->first_child_element()->get_attribute("x"), std::string("2") );
+
+    // assignment shares the tree, reset of the shared copy keeps the template
+    document other;
+    other.set_max_depth(10);
+    other = templ;
+    BOOST_CHECK( other.is_shared() );
+    other.reset();
+    BOOST_CHECK( !other.is_shared() );
+    BOOST_CHECK( !other.get_tixml_document()->FirstChild() );
+    BOOST_CHECK( deep_equal(templ, document( strlen(source), source )) );
+
+    // parsing into the shared copy keeps the template
+    other = templ;
+    other.set_source( 6, "<new/>" );
+    BOOST_CHECK_EQUAL( constTempl.first_child_element()->get_value(), std::string("cfg") );
+    BOOST_CHECK_EQUAL( other.first_child_element()->get_value(), std::string("new") );
+
+    // settings are copied with the tree
+    document settings;
+    settings.set_whitespace_mode(TIXML_WHITESPACE_KEEP);
+    settings.set_reuse_nodes(true);
+    document settingsCopy(settings);
+    settingsCopy.detach();
+    BOOST_CHECK( !settingsCopy.is_shared() );
+    BOOST_CHECK_EQUAL( settingsCopy.get_tixml_document()->WhiteSpaceMode(), TIXML_WHITESPACE_KEEP );
+    BOOST_CHECK( settingsCopy.get_tixml_document()->ReuseNodes() );
+
+    // copies of the copies, removing the children through the document
+    std::vector<document> copies(3, templ);
+    BOOST_CHECK( templ.is_shared() );
+    copies[1].clear();
+    BOOST_CHECK( !copies[1].get_tixml_document()->FirstChild() );
+    BOOST_CHECK( copies[0].first_child() != copies[0].end_child() );
+    BOOST_CHECK( templ.first_child() != templ.end_child() );
+
+    // queries and free functions modify the detached copy, streams detach it through the node base
+    const document original( strlen(source), source );
+    document byQuery(templ);
+    BOOST_CHECK_THROW( query("cfg/a").begin(byQuery)->set_value("queried"), dom_error );
+    BOOST_CHECK( byQuery.is_shared() );
+    byQuery.detach();
+    for (query_iterator i = query("cfg/a").begin(byQuery); i; ++i) {
+        i->set_value("queried");
+    }
+    BOOST_CHECK_EQUAL( query("//queried").count(byQuery), 1u );
+    BOOST_CHECK( deep_equal(templ, original) );
+
+    document byStream(templ);
+    std::istringstream input("<stream/>");
+    node& streamBase = byStream;
+    input >> streamBase;
+    BOOST_CHECK( !byStream.is_shared() );
+    BOOST_CHECK( !deep_equal(byStream, original) );
+    BOOST_CHECK( deep_equal(templ, original) );
+
+    document byFunction(templ);
+    node& functionBase = byFunction;
+    element added("added");
+    BOOST_CHECK_THROW( add_child(*functionBase.first_child_element(), added), dom_error );
+    BOOST_CHECK( !added.get_parent() );
+    byFunction.detach();
+    add_child(*functionBase.first_child_element(), added);
+    BOOST_CHECK_EQUAL( query("cfg/added").count(byFunction), 1u );
+    BOOST_CHECK( deep_equal(templ, original) );
+    BOOST_CHECK( deep_equal(copies[0], original) );
+
+    // kept printed text of the shared tree is not freed by the copy
+    document printed(templ);
+    printed.set_print_cache(true);
+    std::ostringstream first;
+    printed.print_file(first);
+    document printedCopy(printed);
+    printedCopy.set_print_cache(false);
+    BOOST_CHECK( printedCopy.is_shared() );
+    std::ostringstream second;
+    printed.print_file(second);
+    BOOST_CHECK_EQUAL( first.str(), second.str() );
+}
+
+namespace {
+
+    std::string print_node(const TiXmlNode& node, const char* indent, bool cache)
+    {
+        TiXmlPrinter printer;
+        printer.SetIndent(indent);
+        printer.SetCacheSubtrees(cache);
+        node.Accept(&printer);
+        return printer.Str();
+    }
+
+} // anonymous namespace
+
+// caching printer reprints only the changed subtrees
+BOOST_AUTO_TEST_CASE(dom_test_18)
+{
+    using namespace xmlpp;
+
+    std::ostringstream ss;
+    ss << "<?xml version='1.0'?><!-- c --><records>";
+    for (int i = 0; i < 50; ++i) {
+        ss << "<record id='" << i << "'><name>name " << i << "</name><list><a/><b>x</b>tail</list></record>";
+    }
+    ss << "</records>";
+    std::string source = ss.str();
+
+    document doc( source.size(), source.c_str() );
+    const TiXmlDocument& tixmlDocument = *static_cast<const document&>(doc).get_tixml_document();
+    std::string printed = print_node(tixmlDocument, "\t", false);
+
+    // document printing uses the cache
+    doc.set_print_cache(true);
+    std::ostringstream first;
+    doc.print_file(first);
+    BOOST_CHECK_EQUAL( first.str(), printed );
+
+    // changes of TiXmlAttribute are not tracked, so they show the kept text
+    TiXmlAttribute* id = doc.get_tixml_document()->RootElement()->FirstChildElement()->FirstAttribute();
+    id->SetValue("untracked");
+    std::ostringstream second;
+    doc.print_file(second);
+    BOOST_CHECK_EQUAL( second.str(), printed );
+    id->SetValue("0");
+
+    // changes through the attribute wrappers are printed
+    attribute wrapped = *doc.first_child_element()->first_child_element()->first_attribute("id");
+    wrapped.set_value("wrapped");
+    std::ostringstream third;
+    doc.print_file(third);
+    BOOST_CHECK( third.str().find("id=\"wrapped\"") != std::string::npos );
+    BOOST_CHECK_EQUAL( third.str(), print_node(tixmlDocument, "\t", false) );
+    wrapped.set_value("0");
+
+    // other format and depth don't use the text kept for the document
+    const TiXmlElement* record = tixmlDocument.RootElement()->FirstChildElement();
+    BOOST_CHECK_EQUAL( print_node(tixmlDocument, "  ", true), print_node(tixmlDocument, "  ", false) );
+    BOOST_CHECK_EQUAL( print_node(*record, "  ", true), print_node(*record, "  ", false) );
+    BOOST_CHECK_EQUAL( print_node(tixmlDocument, "  ", true), print_node(tixmlDocument, "  ", false) );
+
+    // random changes at any depth, including the moves of the printed subtrees
+    std::srand(18);
+    TiXmlElement* root = doc.get_tixml_document()->RootElement();
+    for (int k = 0; k < 300; ++k)
+    {
+        std::vector<TiXmlNode*> nodes;
+        for (TiXmlNode* n = root; n; )
+        {
+            nodes.push_back(n);
+            if ( n->FirstChild() ) {
+                n = n->FirstChild();
+                continue;
+            }
+            while ( n != root && !n->NextSibling() ) {
+                n = n->Parent();
+            }
+            n = (n == root) ? 0 : n->NextSibling();
+        }
+
+        TiXmlNode*    n = nodes[ std::rand() % nodes.size() ];
+        TiXmlNode*    t = nodes[ std::rand() % nodes.size() ];
+        TiXmlElement* e = n->ToElement();
+        switch ( std::rand() % 6 )
+        {
+            case 0: if (e) e->SetAttribute("id", k); break;
+            case 1: if ( n->ToText() ) n->SetValue("changed"); break;
+            case 2: if ( n->ToText() ) n->ToText()->SetCDATA( !n->ToText()->CDATA() ); break;
+            case 3: if (e) e->LinkEndChild( new TiXmlElement("c") ); break;
+            case 4: if (n != root) n->Parent()->RemoveChild(n); break;
+            case 5:
+            {
+                bool inside = false;
+                for (TiXmlNode* p = t; p; p = p->Parent()) {
+                    inside = inside || p == n;
+                }
+                if ( n != root && !inside && t->ToElement() ) {
+                    t->LinkEndChild(n);
+                }
+                break;
+            }
+        }
+        if ( k % 3 == 0 && root->FirstChild() ) {
+            BOOST_CHECK_EQUAL( print_node(*root->FirstChild(), "\t", true), print_node(*root->FirstChild(), "\t", false) );
+        }
+        BOOST_CHECK_EQUAL( print_node(tixmlDocument, "\t", true), print_node(tixmlDocument, "\t", false) );
+    }
+
+    // kept text is freed
+    root->SetAttribute("id", "0");
+    print_node(tixmlDocument, "\t", true);
+    id = root->FirstAttribute();
+    id->SetValue("untracked");
+    doc.set_print_cache(false);
+    std::ostringstream uncached;
+    doc.print_file(uncached);
+    BOOST_CHECK( uncached.str().find("untracked") != std::string::npos );
+    BOOST_CHECK_EQUAL( print_node(tixmlDocument, "\t", true), uncached.str() );
+}
+
+// text of the element is updated in place
+BOOST_AUTO_TEST_CASE(dom_test_19)
+{
+    using namespace xmlpp;
+
+    const char* source = "<r><b></b><c><d/></c><e><d/>txt2<f/>txt3</e></r>";
+    document doc( strlen(source), source );
+    element_iterator root = doc.first_child_element();
+
+    element b = *root->first_child_element("b");
+    b.set_text("txt");
+    BOOST_CHECK_EQUAL( b.get_text(), std::string("txt") );
+    BOOST_CHECK_EQUAL( b.child_count(), size_t(1) );
+
+    // repeated updates don't add the nodes
+    const TiXmlNode* text = b.get_tixml_node()->FirstChild();
+    for (int i = 0; i < 10; ++i) {
+        b.set_text( std::string("value") );
+    }
+    BOOST_CHECK_EQUAL( b.child_count(), size_t(1) );
+    BOOST_CHECK( b.get_tixml_node()->FirstChild() == text );
+    BOOST_CHECK_EQUAL( b.get_text(), std::string("value") );
+
+    // text is placed in front of the elements
+    element c = *root->first_child_element("c");
+    c.set_text("txt");
+    BOOST_CHECK_EQUAL( c.child_count(), size_t(2) );
+    BOOST_CHECK_EQUAL( c.get_text(), std::string("txt") );
+
+    element e = *root->first_child_element("e");
+    text = e.get_tixml_node()->FirstChild()->NextSibling();
+    e.set_text("txt");
+    BOOST_CHECK_EQUAL( e.child_count(), size_t(3) );
+    BOOST_CHECK( e.get_tixml_node()->FirstChild() == text );
+    BOOST_CHECK_EQUAL( e.get_text(), std::string("txt") );
+
+    std::ostringstream os;
+    os << *root;
+    BOOST_CHECK( os.str().find("txt3") == std::string::npos );
+
+    // unchanged text keeps the cached hash
+    structural_hash(doc, CACHE_HASH);
+    e.set_text("txt");
+    BOOST_CHECK( doc.get_tixml_document()->SubtreeHash() != 0 );
+    e.set_text("other");
+    BOOST_CHECK( doc.get_tixml_document()->SubtreeHash() == 0 );
+}
+
+// document cache evicts least recently used documents over the budget
+BOOST_AUTO_TEST_CASE(dom_test_20)
+{
+    using namespace xmlpp;
+
+    const std::string a = "<a>text</a>";
+    const std::string b = "<b>text</b>";
+    const std::string c = "<c>text</c>";
+    write_file("dom_test_20_a.xml", a);
+    write_file("dom_test_20_b.xml", b);
+    write_file("dom_test_20_c.xml", c);
+    {
+        document_cache cache(2 * a.size(), false);
+        BOOST_CHECK_THROW( cache.get("dom_test_20_missing.xml"), file_error );
+
+        document_cache::document_ptr pa = cache.get("dom_test_20_a.xml");
+        document_cache::document_ptr pb = cache.get("dom_test_20_b.xml");
+        BOOST_CHECK_EQUAL( cache.size(), 2u );
+        BOOST_CHECK_EQUAL( cache.get_byte_size(), 2 * a.size() );
+        BOOST_CHECK( cache.get("dom_test_20_a.xml") == pa );
+
+        // b is least recently used
+        document_cache::document_ptr pc = cache.get("dom_test_20_c.xml");
+        BOOST_CHECK_EQUAL( cache.size(), 2u );
+        BOOST_CHECK_EQUAL( cache.get_byte_size(), 2 * a.size() );
+        BOOST_CHECK( cache.get("dom_test_20_c.xml") == pc );
+        BOOST_CHECK( cache.get("dom_test_20_a.xml") == pa );
+
+        // evicted snapshot remains valid, the file is loaded again
+        document_cache::document_ptr pb2 = cache.get("dom_test_20_b.xml");
+        BOOST_CHECK( pb2 != pb );
+        BOOST_CHECK_EQUAL( pb->first_child_element()->get_value(), std::string("b") );
+        BOOST_CHECK_EQUAL( cache.size(), 2u );
+        BOOST_CHECK( cache.get("dom_test_20_a.xml") == pa );
+
+        // most recently used document is kept even over the budget
+        cache.set_byte_budget(a.size() - 1);
+        BOOST_CHECK_EQUAL( cache.size(), 1u );
+        BOOST_CHECK_EQUAL( cache.get_byte_size(), a.size() );
+        BOOST_CHECK( cache.get("dom_test_20_a.xml") == pa );
+
+        cache.erase("dom_test_20_a.xml");
+        BOOST_CHECK_EQUAL( cache.size(), 0u );
+        BOOST_CHECK_EQUAL( cache.get_byte_size(), 0u );
+        BOOST_CHECK( cache.get("dom_test_20_a.xml") != pa );
+    }
+    std::remove("dom_test_20_a.xml");
+    std::remove("dom_test_20_b.xml");
+    std::remove("dom_test_20_c.xml");
+}
+
+// document cache reloads changed files
+BOOST_AUTO_TEST_CASE(dom_test_21)
+{
+    using namespace xmlpp;
+
+    const char* fileName = "dom_test_21.xml";
+    write_file(fileName, "<v>1</v>");
+
+    // background reload returns the current snapshot until the new one is parsed
+    {
+        document_cache cache;
+        cache.set_check_interval(0);
+
+        document_cache::document_ptr first = cache.get(fileName);
+        BOOST_CHECK_EQUAL( cached_text(first), "1" );
+        BOOST_CHECK( cache.get(fileName) == first );
+
+        write_file(fileName, "<v>22</v>");
+        BOOST_CHECK( cache.get(fileName) == first );
+        cache.wait();
+
+        document_cache::document_ptr second = cache.get(fileName);
+        BOOST_CHECK_EQUAL( cached_text(second), "22" );
+        BOOST_CHECK_EQUAL( cached_text(first), "1" );
+        BOOST_CHECK_EQUAL( cache.get_byte_size(), std::string("<v>22</v>").size() );
+
+        write_file(fileName, "<v>333</v>");
+        cache.refresh();
+        cache.wait();
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "333" );
+
+        // removed file keeps the snapshot
+        std::remove(fileName);
+        cache.refresh();
+        cache.wait();
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "333" );
+    }
+
+    // without background thread the file is reparsed by the reader
+    write_file(fileName, "<v>1</v>");
+    {
+        document_cache cache(1024, false);
+        cache.set_check_interval(0);
+
+        document_cache::document_ptr first = cache.get(fileName);
+        write_file(fileName, "<v>22</v>");
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "22" );
+
+        write_file(fileName, "<v>333</v>");
+        cache.refresh();
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "333" );
+        BOOST_CHECK_EQUAL( cached_text(first), "1" );
+    }
+
+    // concurrent readers while the file is rewritten
+    write_file(fileName, "<v>1</v>");
+    {
+        document_cache cache;
+        cache.set_check_interval(0);
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "1" );
+
+        // partially written versions are not published, readers keep the previous snapshot
+        boost::mutex     mutex;
+        int              failures = 0;
+        boost::thread_group readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.create_thread( boost::bind(read_cached, boost::ref(cache), fileName, boost::ref(mutex), boost::ref(failures)) );
+        }
+
+        const char* versions[] = { "<v>22</v>", "<v>333</v>", "<v>1</v>" };
+        for (int i = 0; i < 30; ++i) {
+            write_file(fileName, versions[i % 3]);
+        }
+        readers.join_all();
+        cache.refresh();
+        cache.wait();
+
+        BOOST_CHECK_EQUAL( failures, 0 );
+        BOOST_CHECK_EQUAL( cached_text( cache.get(fileName) ), "1" );
+    }
+    std::remove(fileName);
+}
+
+// compact document mirrors the DOM
+BOOST_AUTO_TEST_CASE(dom_test_22)
+{
+    using namespace xmlpp;
+
+    const char* source =
+        "<?xml version='1.0' encoding='UTF-8'?>"
+        "<feed title='a'>"
+        "<!-- comment -->"
+        "<entry id='1' kind='k'>one</entry>"
+        "text"
+        "<entry id='2'><title>two</title><empty/></entry>"
+        "<other/>"
+        "<entry id='3'>three<b/></entry>"
+        "</feed>";
+
+    document         doc( strlen(source), source );
+    compact_document compact(doc);
+    BOOST_CHECK( compact.get_memory_usage() > 0 );
+
+    const_element_iterator  root        = static_cast<const document&>(doc).first_child_element();
+    compact_element_iterator compactRoot = compact.first_child_element();
+    BOOST_REQUIRE( compactRoot != compact.end_child_element() );
+    check_compact(*root, *compactRoot);
+    BOOST_CHECK( ++compactRoot == compact.end_child_element() );
+
+    // reverse iteration from the end
+    compact_element_iterator entries = compact.first_child_element("feed");
+    std::vector<std::string> names;
+    for (compact_element_iterator i = entries->end_child_element(); i != entries->first_child_element(); ) {
+        names.push_back( (--i)->get_value() );
+    }
+    BOOST_REQUIRE_EQUAL( names.size(), 4u );
+    BOOST_CHECK_EQUAL( names[0], "entry" );
+    BOOST_CHECK_EQUAL( names[1], "other" );
+    BOOST_CHECK_EQUAL( names[3], "entry" );
+
+    compact_element_iterator last = entries->end_child_element();
+    --last;
+    int id = 0;
+    BOOST_CHECK_EQUAL( last->get_attribute_value("id", id), 3 );
+    BOOST_CHECK( last->get_parent() == entries );
+    BOOST_CHECK( ++last == entries->end_child_element() );
+    BOOST_CHECK( last == compact_element_iterator() );
+
+    compact_element_iterator empty = entries->first_child_element("entry")->next_sibling_element()->first_child_element("empty");
+    BOOST_REQUIRE( empty );
+    BOOST_CHECK( empty->first_child_element() == empty->end_child_element() );
+
+    // elements of different documents are different
+    compact_document other(doc);
+    BOOST_CHECK( other.first_child_element() != compact.first_child_element() );
+    BOOST_CHECK( other.end_child_element() == compact.end_child_element() );
+}
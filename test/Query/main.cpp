@@ -0,0 +1,221 @@
+#include "query.h"
+#include "document.h"
+#include "stream_matcher.h"
+#include <cstdio>
+#include <boost/foreach.hpp>
+
+#define BOOST_TEST_MODULE QueryTest
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+    const char* store_source = 
+        "<Store name='main'>"
+        "<Car id='1'><Model>Mustang</Model><Part id='a'/><Part id='b'/></Car>"
+        "<!-- sold out -->"
+        "<Car id='2' used='yes'><Model>Camaro</Model><Part id='c'><Part id='d'/></Part></Car>"
+        "<Truck id='3'><Model>F150</Model></Truck>"
+        "<Car id='4'><Model/></Car>"
+        "</Store>";
+
+    std::string ids(const xmlpp::query& q, const xmlpp::node& context)
+    {
+        std::string result;
+        BOOST_FOREACH(const xmlpp::element& e, q.select(context))
+        {
+            if ( !result.empty() ) {
+                result += ",";
+            }
+            result += e.has_attribute("id") ? e.get_attribute("id") : e.get_value();
+        }
+        return result;
+    }
+
+    /// collects ids, texts or names of the streamed elements
+    struct id_collector
+    {
+        std::string* result;
+
+        explicit id_collector(std::string& _result) : result(&_result) {}
+
+        void operator () (xmlpp::element& e) const
+        {
+            if ( !result->empty() ) {
+                *result += ",";
+            }
+            if ( e.has_attribute("id") ) {
+                *result += e.get_attribute("id");
+            }
+            else if ( *e.get_text() ) {
+                *result += e.get_text();
+            }
+            else {
+                *result += e.get_value();
+            }
+        }
+    };
+
+} // anonymous namespace
+
+// child axis, name tests and predicates
+BOOST_AUTO_TEST_CASE(query_test_0)
+{
+    using namespace xmlpp;
+
+    document doc( strlen(store_source), store_source );
+    element store = *doc.first_child_element("Store");
+
+    BOOST_CHECK_EQUAL( ids(query("/Store/Car"), doc), "1,2,4" );
+    BOOST_CHECK_EQUAL( ids(query("Store/Car"), doc), "1,2,4" );
+    BOOST_CHECK_EQUAL( ids(query("Car"), store), "1,2,4" );
+    BOOST_CHECK_EQUAL( ids(query("/Store/Car"), *store.first_child_element()), "1,2,4" );
+    BOOST_CHECK_EQUAL( ids(query("*"), store), "1,2,3,4" );
+    BOOST_CHECK_EQUAL( ids(query("Car[@used]"), store), "2" );
+    BOOST_CHECK_EQUAL( ids(query("Car[@id='4']"), store), "4" );
+    BOOST_CHECK_EQUAL( ids(query("Car[ @id = \"1\" ]/Part"), store), "a,b" );
+    BOOST_CHECK_EQUAL( ids(query("Car[Model='Camaro']"), store), "2" );
+    BOOST_CHECK_EQUAL( ids(query("*/Model[text()='F150']"), store), "Model" );
+}
+
+// positional predicates
+BOOST_AUTO_TEST_CASE(query_test_1)
+{
+    using namespace xmlpp;
+
+    document doc( strlen(store_source), store_source );
+    element store = *doc.first_child_element("Store");
+
+    BOOST_CHECK_EQUAL( ids(query("Car[2]"), store), "2" );
+    BOOST_CHECK_EQUAL( ids(query("Car[last()]"), store), "4" );
+    BOOST_CHECK_EQUAL( ids(query("*[3]"), store), "3" );
+    BOOST_CHECK_EQUAL( ids(query("Car[Model][2]"), store), "2" );
+    BOOST_CHECK_EQUAL( ids(query("Car[5]"), store), "" );
+    BOOST_CHECK_EQUAL( ids(query("Car/Part[1]"), store), "a,c" );
+    BOOST_CHECK_EQUAL( ids(query("Car/Part[last()]"), store), "b,c" );
+    BOOST_CHECK_EQUAL( ids(query("//Part[1]"), store), "a,c,d" );
+}
+
+// descendant axis, text()
+BOOST_AUTO_TEST_CASE(query_test_2)
+{
+    using namespace xmlpp;
+
+    document doc( strlen(store_source), store_source );
+    element store = *doc.first_child_element("Store");
+
+    BOOST_CHECK_EQUAL( ids(query("//Part"), doc), "a,b,c,d" );
+    BOOST_CHECK_EQUAL( ids(query(".//Part"), store), "a,b,c,d" );
+    BOOST_CHECK_EQUAL( ids(query("Car//Part"), store), "a,b,c,d" );
+    BOOST_CHECK_EQUAL( ids(query("//Car[@id='2']//Part"), store), "c,d" );
+    BOOST_CHECK_EQUAL( ids(query("//Part//Part"), store), "d" );
+    BOOST_CHECK_EQUAL( ids(query("//*//Part"), store).size(), 7u ); // unique a,b,c,d in some order
+    BOOST_CHECK_EQUAL( ids(query("/Store//Model/text()"), doc), "Model,Model,Model" );
+
+    query models("//Model");
+    BOOST_CHECK_EQUAL( models.count(doc), 4u );
+    BOOST_CHECK_EQUAL( std::string(models.select_first(doc)->get_text()), "Mustang" );
+    BOOST_CHECK( query("//Boat").select_first(doc) == doc.end_child_element() );
+
+    // mutable iteration
+    element mstore = *doc.first_child_element("Store");
+    for (query_iterator i = query("Car/Model").begin(mstore); i; ++i) {
+        i->set_value("Name");
+    }
+    BOOST_CHECK_EQUAL( query("//Name").count(doc), 3u );
+}
+
+// syntax errors
+BOOST_AUTO_TEST_CASE(query_test_3)
+{
+    using namespace xmlpp;
+
+    BOOST_CHECK_THROW( query(""), dom_error );
+    BOOST_CHECK_THROW( query("/"), dom_error );
+    BOOST_CHECK_THROW( query("Car["), dom_error );
+    BOOST_CHECK_THROW( query("Car[@id='1]"), dom_error );
+    BOOST_CHECK_THROW( query("Car[0]"), dom_error );
+    BOOST_CHECK_THROW( query("text()"), dom_error );
+    BOOST_CHECK_THROW( query("Car/text()/Model"), dom_error );
+    BOOST_CHECK_THROW( query("Car Model"), dom_error );
+    BOOST_CHECK_THROW( query("Car[@id!='1']"), dom_error );
+
+    // empty query matches nothing
+    document doc( strlen(store_source), store_source );
+    BOOST_CHECK_EQUAL( query().count(doc), 0u );
+}
+
+// streaming matcher
+BOOST_AUTO_TEST_CASE(query_test_4)
+{
+    using namespace xmlpp;
+
+    std::string models, parts, cars, used;
+    stream_matcher matcher;
+    matcher.add_path( "/Store/Car/Model", id_collector(models) );
+    matcher.add_path( "//Part", id_collector(parts) );
+    matcher.add_path( "Store/*[@id]", id_collector(cars) );
+    matcher.add_path( "//Car[@used='yes']", id_collector(used) );
+    matcher.parse( strlen(store_source), store_source );
+
+    BOOST_CHECK_EQUAL( models, "Mustang,Camaro,Model" );
+    BOOST_CHECK_EQUAL( parts, "a,b,d,c" ); // nested matches are reported when closed
+    BOOST_CHECK_EQUAL( cars, "1,2,3,4" );
+    BOOST_CHECK_EQUAL( used, "2" );
+
+    // markup inside the matched subtree is kept, outside is skipped
+    std::string source = "<?xml version='1.0'?><!DOCTYPE a [<!ELEMENT a ANY>]>"
+                         "<a><b x='&lt;1&gt;'><c id='c1'/><![CDATA[<b>]]><!-- <b> --></b><b x=\"2\">text</b></a>";
+    std::string escaped, nested, all;
+    matcher.clear();
+    matcher.add_path( "/a/b[@x='<1>']", id_collector(escaped) );
+    matcher.add_path( "/a/b/c", id_collector(nested) );
+    matcher.add_path( "//b", id_collector(all) );
+    matcher.parse( source.size(), source.c_str() );
+    BOOST_CHECK_EQUAL( escaped, "b" );
+    BOOST_CHECK_EQUAL( nested, "c1" );
+    BOOST_CHECK_EQUAL( all, "b,text" );
+
+    // chunked stream gives the same results
+    for (size_t chunkSize = 1; chunkSize < 16; ++chunkSize)
+    {
+        std::string streamed;
+        matcher.clear();
+        matcher.add_path( "//Part", id_collector(streamed) );
+        matcher.set_chunk_size(chunkSize);
+        std::istringstream is(store_source);
+        matcher.parse(is);
+        BOOST_CHECK_EQUAL( streamed, "a,b,d,c" );
+    }
+
+    // compressed file
+    if ( compression_supported(COMPRESSION_GZIP) )
+    {
+        std::string streamed;
+        write_compressed_file( "query_test_4.xml.gz", COMPRESSION_GZIP, strlen(store_source), store_source );
+        matcher.clear();
+        matcher.add_path( "//Part", id_collector(streamed) );
+        matcher.parse_file("query_test_4.xml.gz");
+        BOOST_CHECK_EQUAL( streamed, "a,b,d,c" );
+        std::remove("query_test_4.xml.gz");
+    }
+}
+
+// streaming errors
+BOOST_AUTO_TEST_CASE(query_test_5)
+{
+    using namespace xmlpp;
+
+    std::string result;
+    stream_matcher matcher;
+    BOOST_CHECK_THROW( matcher.add_path( "Car[1]", id_collector(result) ), dom_error );
+    BOOST_CHECK_THROW( matcher.add_path( "Car[Model]", id_collector(result) ), dom_error );
+    BOOST_CHECK_THROW( matcher.add_path( "Car/text()", id_collector(result) ), dom_error );
+    BOOST_CHECK_THROW( matcher.add_path( query(), id_collector(result) ), dom_error );
+
+    matcher.add_path( "//Car", id_collector(result) );
+    const char* truncated = "<Store><Car id='1'>";
+    BOOST_CHECK_THROW( matcher.parse( strlen(truncated), truncated ), dom_error );
+    const char* unbalanced = "<Store></Store></Car>";
+    BOOST_CHECK_THROW( matcher.parse( strlen(unbalanced), unbalanced ), dom_error );
+    BOOST_CHECK_THROW( matcher.parse_file("no_such_file.xml"), file_error );
+}
@@ -16,13 +16,21 @@ private:
 
 private:
     TiXmlAttribute* tixmlAttribute;
+    TiXmlElement*   owner;
 
 public:
     // Construct
     attribute(const attribute& rhs) : 
-        tixmlAttribute(rhs.tixmlAttribute) {}
-    explicit attribute(TiXmlAttribute* _tixmlAttribute) : 
-        tixmlAttribute(_tixmlAttribute) {}
+        tixmlAttribute(rhs.tixmlAttribute),
+        owner(rhs.owner) {}
+
+    /** Wrap the attribute of the element. Changes made through the wrapper reset
+     * the cached hashes and printed text of the element, see TiXmlNode::InvalidateSubtreeCache.
+     * Without the owner they are not tracked.
+     */
+    explicit attribute(TiXmlAttribute* _tixmlAttribute, TiXmlElement* _owner = 0) : 
+        tixmlAttribute(_tixmlAttribute),
+        owner(_owner) {}
 
     /** Get name of the attribute
      * @return attribute name
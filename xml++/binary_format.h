@@ -0,0 +1,47 @@
+#ifndef XMLPP_BINARY_FORMAT_H
+#define XMLPP_BINARY_FORMAT_H
+
+#include "tinyxml.h"
+#include <iosfwd>
+
+namespace xmlpp {
+
+/**
+ * Binary encoding of the DOM. Stores the nodes as they are after parsing, so
+ * reading it doesn't tokenize, decode entities or condense white space, and
+ * printing the read document gives the same xml as printing the source one.
+ * Data is read in place, so it could be mapped from the file.
+ *
+ * Layout, all numbers are unsigned LEB128 varints:
+ * @verbatim
+ *  header      - "XMLPPBIN", format version byte, flags byte (1 - UTF-8 BOM)
+ *  names       - count, then length and bytes of every element and attribute name
+ *  records     - nodes in document order:
+ *      ELEMENT     name index, attribute count, (name index, value)*, children, END
+ *      TEXT, CDATA, COMMENT, UNKNOWN   value
+ *      DECLARATION version, encoding, standalone
+ *      END         closes the element, last one closes the document
+ *  value       - length and bytes
+ * @endverbatim
+ */
+namespace binary_format
+{
+    /// Version of the format written
+    const unsigned char version = 1;
+
+    /** Check whether data starts with the binary format signature */
+    bool is_binary(size_t size, const char* data);
+
+    /** Write document in the binary format */
+    void write(const TiXmlDocument& doc, std::ostream& os);
+
+    /** Read document from the binary format. Previous content of the document is removed.
+     * @throws dom_error if data is corrupt or has unsupported version
+     */
+    void read(size_t size, const char* data, TiXmlDocument& doc);
+
+} // namespace binary_format
+
+} // namespace xmlpp
+
+#endif // XMLPP_BINARY_FORMAT_H
@@ -0,0 +1,295 @@
+#ifndef XMLPP_COMPACT_DOCUMENT_H
+#define XMLPP_COMPACT_DOCUMENT_H
+
+#include "document.h"
+#include <map>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace xmlpp {
+
+class compact_document;
+class compact_element;
+
+/**
+ * Attribute of the compact element. Lightweight handle, valid while document exists.
+ */
+class compact_attribute
+{
+friend class compact_attribute_iterator;
+public:
+    compact_attribute() : doc(0), index(0) {}
+
+    /** Get name of the attribute */
+    const char* get_name() const;
+
+    /** Get value of the attribute */
+    const char* get_value() const;
+
+    /** Compare attributes */
+    bool operator == (const compact_attribute& rhs) const { return doc == rhs.doc && index == rhs.index; }
+
+private:
+    compact_attribute(const compact_document* doc_, boost::uint32_t index_) : doc(doc_), index(index_) {}
+
+private:
+    const compact_document* doc;
+    boost::uint32_t         index;
+};
+
+/**
+ * Iterator throught the attributes of the compact element. Attributes are stored
+ * contiguously, so iterator provides random access.
+ */
+class compact_attribute_iterator :
+    public boost::iterator_facade<
+        compact_attribute_iterator,
+        const compact_attribute,
+        boost::random_access_traversal_tag
+    >
+{
+friend class boost::iterator_core_access;
+friend class compact_element;
+private:
+    void increment()                                                { attr.index++; }
+    void decrement()                                                { attr.index--; }
+    void advance(difference_type n)                                 { attr.index += static_cast<boost::int32_t>(n); }
+    difference_type distance_to(const compact_attribute_iterator& other) const
+    {
+        return static_cast<difference_type>(other.attr.index) - static_cast<difference_type>(attr.index);
+    }
+
+    bool equal(const compact_attribute_iterator& other) const       { return attr == other.attr; }
+    const compact_attribute& dereference() const                    { return attr; }
+
+    compact_attribute_iterator(const compact_document* doc, boost::uint32_t index) : attr(doc, index) {}
+
+public:
+    compact_attribute_iterator() {}
+
+private:
+    compact_attribute attr;
+};
+
+// forward
+class compact_element_iterator;
+
+/**
+ * Read only element of the compact_document. Mirrors read access part of the xmlpp::element.
+ * Lightweight handle (document pointer + index), valid while document exists.
+ */
+class compact_element
+{
+friend class compact_document;
+friend class compact_element_iterator;
+public:
+    typedef compact_attribute_iterator const_attribute_iterator;
+
+public:
+    compact_element() : doc(0), index(npos) {}
+
+    /** Get name of the element */
+    const char* get_value() const;
+
+    /** Text of the element(same as element::get_text())
+     * @return text of the first child if it is text node, empty string otherwise.
+     */
+    const char* get_text() const;
+
+    /** Check if element has attribute with specified name */
+    bool has_attribute(const char* name) const;
+
+    /** Get attribute value by the name.
+     * @throws dom_error if attribute not found.
+     */
+    const char* get_attribute(const char* name) const;
+
+    /** Get attribute value by the name
+     * @param output value
+     * @return attribute value
+     */
+    template<class T>
+    T& get_attribute_value(const char* name, T& value) const
+    {
+        std::istringstream ss( get_attribute(name) );
+        ss >> value;
+
+        if ( ss.fail() ) {
+            throw dom_error("Wrong attribute type");
+        }
+
+        return value;
+    }
+
+    /** Get iterator addressing first attribute */
+    const_attribute_iterator first_attribute() const;
+
+    /** Get iterator addressing attribute after last attribute */
+    const_attribute_iterator end_attribute() const;
+
+    /** One step up the DOM
+     * @return iterator addressing parent element, end iterator if parent is document.
+     */
+    compact_element_iterator get_parent() const;
+
+    /** Get iterator to the first child element */
+    compact_element_iterator first_child_element() const;
+
+    /** Get iterator to the first child element with specified name */
+    compact_element_iterator first_child_element(const char* name) const;
+
+    /** Get iterator to the element after last element */
+    compact_element_iterator end_child_element() const;
+
+    /** Move to next sibling */
+    compact_element_iterator next_sibling_element() const;
+
+    /** Get index of the node in the document storage */
+    boost::uint32_t get_index() const { return index; }
+
+    /** Compare elements */
+    bool operator == (const compact_element& rhs) const { return doc == rhs.doc && index == rhs.index; }
+
+private:
+    static const boost::uint32_t npos = 0xFFFFFFFF;
+
+    compact_element(const compact_document* doc_, boost::uint32_t index_) : doc(doc_), index(index_) {}
+
+    boost::uint32_t find_attribute(const char* name) const;
+
+private:
+    const compact_document* doc;
+    boost::uint32_t         index;
+};
+
+/**
+ * Iterator throught the sibling elements of the compact document
+ */
+class compact_element_iterator :
+    public boost::iterator_facade<
+        compact_element_iterator,
+        const compact_element,
+        boost::bidirectional_traversal_tag
+    >
+{
+friend class boost::iterator_core_access;
+friend class compact_element;
+friend class compact_document;
+private:
+    void increment();
+    void decrement();
+
+    bool equal(const compact_element_iterator& other) const;
+    const compact_element& dereference() const              { return elem; }
+
+    /// construct iterator addressing element among the children of the parent node
+    compact_element_iterator(const compact_document* doc, boost::uint32_t index, boost::uint32_t parent_) :
+        elem(doc, index),
+        parent(parent_)
+    {}
+
+public:
+    /// construct end iterator
+    compact_element_iterator() : parent(compact_element::npos) {}
+
+    /// construct from element
+    explicit compact_element_iterator(const compact_element& elem_);
+
+    operator bool () const { return elem.index != compact_element::npos; }
+
+	bool exist() const { return elem.index != compact_element::npos; }
+
+private:
+    compact_element elem;
+    boost::uint32_t parent;     /// parent node of the siblings, end iterator steps back to its last element
+};
+
+/**
+ * Read only document with flattened struct-of-arrays storage. Nodes are laid out
+ * breadth first, so children of every node occupy contiguous range of the arrays
+ * and sibling iteration walks memory sequentially. Element and attribute names
+ * are interned, strings are packed into the single buffer. Document takes
+ * several times less memory than the TiXml tree it was built from.
+ */
+class compact_document
+{
+friend class compact_attribute;
+friend class compact_element;
+friend class compact_element_iterator;
+public:
+    compact_document();
+
+    /** Flatten the document */
+    explicit compact_document(const document& d);
+
+    /** Flatten the document, previous content is discarded */
+    void assign(const document& d);
+
+    /** Flatten the tinyxml node, previous content is discarded */
+    void assign(const TiXmlNode& root);
+
+    /** Parse document source.
+     * @throws dom_error
+     */
+    void set_source(size_t size, const char* source);
+
+    /** Parse document from the file.
+     * @throws dom_error, file_error
+     */
+    void set_file_source(const std::string& fileName, TiXmlEncoding encoding = TIXML_DEFAULT_ENCODING);
+
+    /** Get iterator to the first child element */
+    compact_element_iterator first_child_element() const;
+
+    /** Get iterator to the first child element with the specified name */
+    compact_element_iterator first_child_element(const char* name) const;
+
+    /** Get iterator to the element after last element */
+    compact_element_iterator end_child_element() const;
+
+    /** Get number of nodes in the document, including document node */
+    size_t node_count() const { return kinds.size(); }
+
+    /** Get approximate number of bytes used by the document storage */
+    size_t get_memory_usage() const;
+
+    /** Remove all nodes */
+    void clear();
+
+private:
+    typedef boost::uint32_t             index_type;
+    typedef std::vector<index_type>     index_vector;
+
+    static const index_type npos = compact_element::npos;
+
+    index_type  intern(const std::string& name);
+    index_type  find_name(const char* name) const;
+    index_type  store_string(const std::string& str);
+    const char* get_string(index_type offset) const { return &strings[offset]; }
+
+    index_type  first_element(index_type first, index_type name, bool anyName) const;
+
+private:
+    // nodes
+    std::vector<unsigned char>  kinds;          /// TiXmlNode::NodeType of the node
+    index_vector                names;          /// name id for elements, npos otherwise
+    index_vector                parents;
+    index_vector                firstChildren;
+    index_vector                nextSiblings;
+    index_vector                textOffsets;    /// value offset in the strings for text, comment and unknown nodes
+    index_vector                firstAttributes;/// first attribute index, attributes of node i are [firstAttributes[i], firstAttributes[i + 1])
+
+    // attributes
+    index_vector                attributeNames;
+    index_vector                attributeValues;
+
+    // strings
+    std::vector<char>                   strings;
+    index_vector                        nameOffsets;
+    std::map<std::string, index_type>   nameIds;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_COMPACT_DOCUMENT_H
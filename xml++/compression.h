@@ -0,0 +1,109 @@
+#ifndef XMLPP_COMPRESSION_H
+#define XMLPP_COMPRESSION_H
+
+#include <cstdio>
+#include <deque>
+#include <streambuf>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace xmlpp {
+
+/** Compression formats of the xml files */
+enum compression_type
+{
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,   /// requires zlib
+    COMPRESSION_ZSTD    /// requires build with XMLPP_WITH_ZSTD
+};
+
+/** Detect compression by the magic bytes at the start of the data */
+compression_type detect_compression(size_t size, const char* data);
+
+/** Detect compression of the file by its magic bytes.
+ * @return COMPRESSION_NONE if file is not compressed or can't be read.
+ */
+compression_type detect_file_compression(const std::string& fileName);
+
+/** Check whether library is built with support of the compression */
+bool compression_supported(compression_type compression);
+
+/** Compress data and write it to the file.
+ * @throws file_error if file can't be written or compression is not supported.
+ */
+void write_compressed_file( const std::string&   fileName,
+                            compression_type     compression,
+                            size_t               size,
+                            const char*          data );
+
+/**
+ * Stream buffer reading the decompressed file. File is read and decompressed
+ * by the worker thread into the bounded queue of blocks, so decompression
+ * runs in parallel with the consumer, e.g. parser reading the stream.
+ * Compression is detected by the magic bytes, uncompressed files are passed as is.
+ *
+ * Example:
+ * @verbatim
+ * decompressing_streambuf buf("store.xml.gz");
+ * std::istream is(&buf);
+ * matcher.parse(is);
+ * @endverbatim
+ */
+class decompressing_streambuf :
+    public std::streambuf
+{
+public:
+    /** Open the file and start decompression.
+     * @param fileName - name of the file.
+     * @param blockSize - size of the decompressed blocks.
+     * @param maxBlocks - maximum number of the blocks decompressed ahead.
+     * @throws file_error if file can't be opened or compression is not supported.
+     */
+    explicit decompressing_streambuf( const std::string&  fileName,
+                                      size_t              blockSize = 64 * 1024,
+                                      size_t              maxBlocks = 16 );
+
+    /** Stops the worker thread */
+    ~decompressing_streambuf();
+
+    /** Get compression of the file */
+    compression_type get_compression() const { return compression; }
+
+protected:
+    /** Get next decompressed block.
+     * @throws file_error if file is corrupted.
+     */
+    int_type underflow();
+
+private:
+    void worker();
+    void decompress_none();
+    void decompress_gzip();
+    void decompress_zstd();
+
+    /// push block to the queue, false if consumer is gone
+    bool push(std::string& block);
+
+private:
+    FILE*                               file;
+    compression_type                    compression;
+    size_t                              blockSize;
+    size_t                              maxBlocks;
+    std::string                         current;
+
+    boost::mutex                        mutex;
+    boost::condition_variable           readyCondition;
+    boost::condition_variable           spaceCondition;
+    std::deque<std::string>             blocks;
+    std::string                         error;
+    bool                                finished;
+    bool                                stopping;
+    boost::scoped_ptr<boost::thread>    workerThread;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_COMPRESSION_H
@@ -0,0 +1,100 @@
+#ifndef XMLPP_DIFF_H
+#define XMLPP_DIFF_H
+
+#include "document.h"
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+namespace xmlpp {
+
+/**
+ * Edit script transforming one document into another, see diff and patch.
+ * Operations are applied in order. Nodes are addressed by the paths of the
+ * child indexes from the document, all the nodes are counted, not only elements.
+ * Paths are valid at the moment the operation is applied.
+ *
+ * Script is saved as the xml document, so it could be written as text or in
+ * the binary format like any other document:
+ * @verbatim
+ * <diff>
+ *     <insert path="0/1"><b z="3"/></insert>
+ *     <delete path="0/3"/>
+ *     <update path="0/0/0" value="new text"/>
+ *     <set-attribute path="0/2" name="x" value="1"/>
+ *     <remove-attribute path="0/2" name="y"/>
+ * </diff>
+ * @endverbatim
+ * Inserted white space only text is lost if the script is parsed with the
+ * default white space mode, see document::set_whitespace_mode.
+ */
+class edit_script
+{
+public:
+    struct operation
+    {
+        enum kind_type
+        {
+            INSERT_NODE,        /// insert node at the last index of the path
+            DELETE_NODE,
+            UPDATE_VALUE,       /// set value of the text, comment or unknown node
+            SET_ATTRIBUTE,
+            REMOVE_ATTRIBUTE
+        };
+
+        kind_type                       kind;
+        std::vector<size_t>             path;
+        std::string                     name;   /// attribute name
+        std::string                     value;  /// new value of the node or attribute
+        boost::shared_ptr<TiXmlNode>    node;   /// inserted subtree, it is copied by patch
+
+        operation() : kind(INSERT_NODE) {}
+    };
+
+    typedef std::vector<operation> operation_list;
+
+public:
+    /** Get operations of the script */
+    const operation_list& get_operations() const { return operations; }
+
+    /** Append operation to the script */
+    void add_operation(const operation& op) { operations.push_back(op); }
+
+    /** Get number of the operations */
+    size_t size() const { return operations.size(); }
+
+    /** Check if documents were equal */
+    bool empty() const { return operations.empty(); }
+
+    /** Write script to the document, previous content of the document is removed */
+    void save(document& doc) const;
+
+    /** Read script from the document.
+     * @throws dom_error if the document is not a script.
+     */
+    void load(const document& doc);
+
+private:
+    operation_list operations;
+};
+
+/** Make edit script transforming document 'from' into document 'to'. Identical
+ * subtrees are found by the structural hashes (see structural_hash), which are
+ * computed once for both documents and kept by the differ, so unchanged regions
+ * are skipped and the time is near linear. Children are matched by their hashes
+ * keeping their order, the rest are paired by the type and name and compared
+ * further, or deleted and inserted. Attributes are compared as sets, the order
+ * of the attributes is not kept by the script.
+ * The documents are not modified, so shared snapshots (see document_cache) could
+ * be compared by several threads at once.
+ */
+edit_script diff(const document& from, const document& to);
+
+/** Apply edit script to the document.
+ * @throws dom_error if the script doesn't fit the document, operations
+ * preceding the failed one remain applied.
+ */
+void patch(document& doc, const edit_script& script);
+
+} // namespace xmlpp
+
+#endif // XMLPP_DIFF_H
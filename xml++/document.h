@@ -1,10 +1,13 @@
 #ifndef XMLPP_DOCUMENT_H
 #define XMLPP_DOCUMENT_H
 
+#include <set>
 #include <string>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include "tinyxml.h"
 #include "element.h"
+#include "compression.h"
 
 namespace xmlpp {
 
@@ -26,16 +29,44 @@ public:
 
 /**
  * Base class for parsing xml documents.
+ *
+ * Copies of the document share the tree for reading, so keeping read only copies
+ * of the large document, e.g. snapshots handed to several readers, costs nothing.
+ * Modified copies are not cheap: tiny xml nodes are linked to their parents and
+ * can't be shared by the trees, so the whole tree is copied by detach. Modifying
+ * methods of the document and the free functions given the document detach the
+ * tree, navigation doesn't. Modifying the shared tree through the node wrappers
+ * and attributes throws dom_error, call detach first and take the wrappers from
+ * the detached document. Changes made through tiny xml nodes are not checked.
  */
 class document :
     public node_impl<TiXmlDocument>
 {
+public:
+    /** Filter deciding whether the child element is parsed. Gets the parent element,
+     * name of the child and length of the name (name is not null terminated).
+     * Returns false to skip the child.
+     */
+    typedef boost::function<bool (const element&, const char*, size_t)> parse_filter;
+
 public:
     document();
     document(const document& rhs);
     document(size_t size, const char* source);
     virtual ~document();
 
+    /** Share the tree of the document, previous tree is released */
+    document& operator = (const document& rhs);
+
+    /** Make own copy of the whole tree if it is shared with other documents. Called by
+     * the modifying methods of the document, call it before modifying the tree otherwise.
+     * Wrappers obtained before keep addressing the tree of the other copies.
+     */
+    void detach();
+
+    /** Check if the tree is shared with other documents */
+    bool is_shared() const { return !tree.unique(); }
+
     /** Set document source.
 	 * @param size - size of the source.
      * @param source - string containing xml file.
@@ -43,25 +74,98 @@ public:
      */
     void set_source(size_t size, const char* source);
 
-    /** Set document source
+    /** Set document source. Compressed files are detected by the magic bytes
+     * and decompressed on the separate thread while the text is gathered.
      * TODO: Split file errors & dom errors
      * @param fileName - name of the xml formatted file
      * @throws dom_error, file_error
      */
     void set_file_source(const std::string& fileName, TiXmlEncoding encoding = TIXML_DEFAULT_ENCODING);
 
+    /** Set filter skipping unwanted elements while parsing. Skipped subtrees are
+     * scanned for balanced tags only, no nodes are created for them.
+     * @param filter - filter to use, empty filter parses all elements.
+     */
+    void set_parse_filter(const parse_filter& filter);
+
+    /** Skip elements with the specified names at any depth while parsing.
+     * Replaces the parse filter.
+     * @param names - names of the elements to skip.
+     */
+    void skip_elements(const std::set<std::string>& names);
+
+    /** Keep the nodes of the removed content and reuse them for the next parse.
+     * Steady state parsing of the similar documents, e.g. messages, then doesn't
+     * allocate memory. Kept nodes are freed when reuse is turned off.
+     */
+    void set_reuse_nodes(bool reuse);
+
+    /** Remove content of the document before parsing the next one. Nodes
+     * are kept in the reuse mode, see set_reuse_nodes.
+     */
+    void reset();
+
+    /** Limit nesting depth of the elements, deeper documents fail to parse with dom_error.
+     * Parsing and other operations are not recursive, the limit only guards against
+     * the hostile input.
+     * @param depth - maximum depth, 0 means no limit which is the default.
+     */
+    void set_max_depth(int depth);
+
+    /** Set how the white space only text between the tags is parsed: dropped
+     * (the default), kept as is or collapsed to the single space.
+     */
+    void set_whitespace_mode(TiXmlWhiteSpaceMode mode);
+
+    /** Keep the printed text of the unchanged subtrees between the print_file calls,
+     * so the periodic saving of the large document after the small changes only
+     * formats the changed elements and copies the rest. Costs memory about the size
+     * of the printed document. Used by print_file to the stream and with the
+     * compression, print_file(fileName) formats the mixed content differently and
+     * doesn't cache, use COMPRESSION_NONE instead. Changes of the attributes made
+     * through TiXmlAttribute directly are not tracked, see TiXmlPrinter::SetCacheSubtrees.
+     * Kept text is freed when caching is turned off.
+     */
+    void set_print_cache(bool cache);
+
     /** Dump document to file. Also you can use operator <<. */
     void print_file(const std::string& fileName) const;
 
 	/** Print readable xml file to the stream. */
 	void print_file(std::ostream& os) const;
 
+    /** Print readable xml file compressed.
+     * @throws file_error if file can't be written or compression is not supported.
+     */
+    void print_file(const std::string& fileName, compression_type compression) const;
+
+    /** Save document in the binary format, see binary_format.h.
+     * Loading it is much faster than parsing the xml.
+     * @throws file_error
+     */
+    void save_binary(const std::string& fileName) const;
+
+    /** Write document in the binary format to the stream. */
+    void save_binary(std::ostream& os) const;
+
+    /** Load document from the binary format in memory, e.g. mapped file.
+     * @param size - size of the data.
+     * @param data - data written by save_binary.
+     * @throws dom_error
+     */
+    void load_binary(size_t size, const char* data);
+
+    /** Load document from the binary file written by save_binary.
+     * @throws dom_error, file_error
+     */
+    void load_binary(const std::string& fileName);
+
     /** Does nothing. Overload this function to implement required
      *  actions after the document has been loaded.
      */
     virtual void on_load() {}
 
-    /** Get tiny xml document. Use with care. */
+    /** Get tiny xml document for the modification, detaches the tree. Use with care. */
     TiXmlDocument* get_tixml_document() { return query_node(); }
 
     /** Get tiny xml document. Use with care. */
@@ -107,8 +211,29 @@ public:
     /** Get document file name if it has been loaded from the file. Otherwise return emptry string */
     const std::string& get_file_name() const { return fileName; }
 
+    // removed content is not copied
+    using node::clear;
+    void clear() { detach_empty(); node::clear(); }
+
+    /** Detach the tree before it is modified through the node, see node::prepare_modification */
+    void prepare_modification() { detach(); }
+
+protected:
+    /** Get tiny xml document for the modification, detaches the tree */
+    TiXmlDocument* query_node();
+
+    /** Get tiny xml document */
+    const TiXmlDocument* query_node() const { return node_impl<TiXmlDocument>::query_node(); }
+
+private:
+    /** Make own empty tree with the settings of the shared one, content is going to be replaced */
+    void detach_empty();
+
 private:
-    std::string fileName;
+    boost::shared_ptr<TiXmlDocument>    tree;
+    std::string                         fileName;
+    boost::shared_ptr<TiXmlParseFilter> parseFilter;
+    bool                                printCache;
 };
 
 } // namespace xmlpp
@@ -0,0 +1,147 @@
+#ifndef XMLPP_DOCUMENT_CACHE_H
+#define XMLPP_DOCUMENT_CACHE_H
+
+#include "document.h"
+#include <ctime>
+#include <deque>
+#include <list>
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace xmlpp {
+
+/**
+ * Cache of parsed read-only documents keyed by file path. Documents are kept
+ * in memory until the byte budget is exceeded, then the least recently used
+ * ones are dropped. Every access revalidates the file (modification time, size
+ * and inode) and changed files are reparsed, in the background by default.
+ * Readers get shared pointers to immutable snapshots, so a reload never
+ * invalidates or blocks a document somebody is still reading.
+ */
+class document_cache
+{
+public:
+    typedef boost::shared_ptr<const document> document_ptr;
+
+public:
+    /** Create cache.
+     * @param byteBudget - max summary size of the cached files, documents are charged by file size.
+     * @param backgroundReload - reparse changed files in the worker thread. Otherwise
+     * changed files are reparsed by the thread requesting them.
+     */
+    explicit document_cache(size_t byteBudget = 64 * 1024 * 1024, bool backgroundReload = true);
+    ~document_cache();
+
+    /** Get document loaded from the file. Document is loaded synchronously if it is
+     * not in the cache. If the file has been changed since it was loaded, background
+     * reload is scheduled and current snapshot is returned.
+     * @param fileName - name of the xml file.
+     * @return snapshot of the document.
+     * @throws dom_error, file_error
+     */
+    document_ptr get(const std::string& fileName);
+
+    /** Revalidate all cached documents and reload changed ones. */
+    void refresh();
+
+    /** Block until all scheduled background reloads are finished. */
+    void wait();
+
+    /** Remove document from the cache. Snapshots handed out remain valid. */
+    void erase(const std::string& fileName);
+
+    /** Remove all documents from the cache. */
+    void clear();
+
+    /** Minimal interval between two revalidations of the same file, in seconds.
+     * 0 means check the file on every access. Default is 1 second.
+     */
+    void set_check_interval(unsigned seconds);
+
+    /** Set max summary size of the cached files. Evicts documents if required. */
+    void set_byte_budget(size_t byteBudget);
+
+    /** Get max summary size of the cached files */
+    size_t get_byte_budget() const;
+
+    /** Get summary size of the cached files */
+    size_t get_byte_size() const;
+
+    /** Get number of the cached documents */
+    size_t size() const;
+
+private:
+    /** Identity of the file version on the disk */
+    struct file_stamp
+    {
+        time_t          mtime;
+        unsigned long   size;
+        unsigned long   inode;
+        unsigned long   device;
+
+        file_stamp() : mtime(0), size(0), inode(0), device(0) {}
+
+        bool operator == (const file_stamp& rhs) const;
+        bool operator != (const file_stamp& rhs) const { return !(*this == rhs); }
+    };
+
+    typedef std::list<std::string> lru_list;
+
+    struct entry
+    {
+        document_ptr        doc;
+        file_stamp          stamp;
+        time_t              lastCheck;
+        bool                reloading;
+        lru_list::iterator  lruPosition;
+    };
+
+    typedef std::map<std::string, entry>    entry_map;
+    typedef entry_map::iterator             entry_iterator;
+
+private:
+    // noncopyable
+    document_cache(const document_cache&);
+    document_cache& operator = (const document_cache&);
+
+    static bool read_stamp(const std::string& fileName, file_stamp& stamp);
+    static document_ptr load(const std::string& fileName);
+
+    /** Check whether the file of the entry should be stat'ed, updates check time. Requires lock. */
+    bool check_due(entry& e, time_t now, bool force);
+
+    /** Schedule reload if the entry still has oldStamp and the file has changed. Requires lock.
+     * @return true if the reload is scheduled.
+     */
+    bool mark_changed(const std::string& fileName, const file_stamp& oldStamp, const file_stamp& stamp);
+
+    void reload(const std::string& fileName);
+    void store(const std::string& fileName, const document_ptr& doc, const file_stamp& stamp, bool insert);
+    void evict();
+    void worker();
+
+private:
+    mutable boost::mutex        mutex;
+    boost::condition_variable   queueCondition;
+    boost::condition_variable   idleCondition;
+
+    entry_map                   entries;
+    lru_list                    lru;
+    std::deque<std::string>     reloadQueue;
+    size_t                      pendingReloads;
+
+    size_t                      byteBudget;
+    size_t                      byteSize;
+    unsigned                    checkInterval;
+    bool                        stopping;
+
+    boost::scoped_ptr<boost::thread>    reloadThread;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_DOCUMENT_CACHE_H
@@ -0,0 +1,88 @@
+#ifndef XMLPP_DOCUMENT_READER_H
+#define XMLPP_DOCUMENT_READER_H
+
+#include "document.h"
+#include <cstdio>
+#include <vector>
+
+namespace xmlpp {
+
+/**
+ * Reads the stream of concatenated documents one document at a time, e.g. the
+ * messages of the message bus. Documents could be separated by white space or
+ * follow each other directly. Source is read by blocks into the single buffer,
+ * the end of every document is found by the scanner and the document is parsed
+ * in place, so the buffer and the document are reused for all the messages.
+ *
+ * Example:
+ * @verbatim
+ * document_reader reader(fd);
+ * document        doc;
+ * while ( reader.next(doc) ) {
+ *     process(doc);
+ * }
+ * @endverbatim
+ */
+class document_reader
+{
+public:
+    /** Read documents from the buffer. Buffer must exist while reader is used */
+    document_reader(size_t size, const char* data);
+
+    /** Read documents from the file.
+     * @throws file_error if file can't be opened.
+     */
+    explicit document_reader(const std::string& fileName);
+
+    /** Read documents from the file descriptor, e.g. the pipe or socket.
+     * Descriptor is not closed by the reader.
+     */
+    explicit document_reader(int fd);
+
+    /** Closes the file opened by the reader */
+    ~document_reader();
+
+    /** Parse next document into doc, previous content of the document is removed.
+     * @return false if there are no more documents.
+     * @throws dom_error if document is malformed, file_error if source can't be read.
+     */
+    bool next(document& doc);
+
+    /** Get number of the documents read */
+    size_t get_count() const { return count; }
+
+private:
+    enum source_type
+    {
+        SOURCE_BUFFER,
+        SOURCE_FILE,
+        SOURCE_DESCRIPTOR
+    };
+
+    // noncopyable
+    document_reader(const document_reader&);
+    document_reader& operator = (const document_reader&);
+
+    void   init();
+
+    /// read next block to the end of the buffer, return number of the bytes read
+    size_t read_block();
+
+private:
+    source_type         source;
+    const char*         data;
+    const char*         dataEnd;
+    FILE*               file;
+    int                 fd;
+
+    std::vector<char>   buffer;
+    size_t              first;      /// start of the next document in the buffer
+    size_t              last;       /// end of the data in the buffer
+    bool                eof;
+    size_t              count;
+    TiXmlStreamScanner  scanner;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_DOCUMENT_READER_H
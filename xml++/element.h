@@ -32,14 +32,16 @@ private:
         {
             node = T( node.tixmlAttribute->Next() != NULL
                       ? node.tixmlAttribute->Next()
-                       : NULL );
+                       : NULL,
+                      node.owner );
         }
 
         void decrement()
         {
             node = T( node.tixmlAttribute->Previous() != NULL
                       ? node.tixmlAttribute->Previous()
-                      : NULL );
+                      : NULL,
+                      node.owner );
         }
 
         bool equal(attribute_iterator_impl const& other) const
@@ -54,7 +56,7 @@ private:
         attribute_iterator_impl() : node(NULL) {}
         attribute_iterator_impl(const attribute_iterator_impl& rhs) : node(rhs.node) {}
         explicit attribute_iterator_impl(const T& attribute) : node(attribute) {}
-        explicit attribute_iterator_impl(TiXmlAttribute* pAttr) : node(pAttr) {}
+        explicit attribute_iterator_impl(TiXmlAttribute* pAttr, TiXmlElement* owner = 0) : node(pAttr, owner) {}
 
         operator bool () const { return node != NULL; }
 
@@ -144,26 +146,35 @@ public:
      * For example: There is <b></b> tag. After SetText("txt") it became <b>txt</b>.
      * Example2: <b><d/></b> -> <b>txt<d/></b>
      * Example3: <b><d/>txt2</b> -> <b>txt<d/></b>
+     * The first text node is moved in front and updated in place reusing its
+     * buffer, unchanged text is not touched.
      * @param text of the element
      */
     void set_text(const char* text);
 
+    /** Set text of the element, see set_text(const char*) */
+    void set_text(const std::string& text);
+
     /**
-     * Add child to the element.
+     * Add child to the element. Node is moved, not copied: the new node is
+     * owned by the element after that, the node of the document is unlinked
+     * from its parent.
      */
     node_iterator add_child(node& n);
 
     /**
-     * Add child to the element after specified child.
+     * Add child to the element after specified child. Node is moved like by add_child.
      * @param where - child afther which to insert node.
      * @param n - node to insert.
+     * @return iterator addressing n or end iterator on error.
      */
     node_iterator insert_after_child(const node_iterator& where, node& n);
 
     /**
-     * Add child to the element after specified child.
-     * @param where - child afther which to insert node.
+     * Add child to the element before specified child. Node is moved like by add_child.
+     * @param where - child before which to insert node.
      * @param n - node to insert.
+     * @return iterator addressing n or end iterator on error.
      */
     node_iterator insert_before_child(const node_iterator& where, node& n);
 
@@ -7,6 +7,44 @@
 
 namespace xmlpp {
 
+/**
+ * Maps TiXml node class to the TiXmlNode::NodeType tag, so that node
+ * can be downcasted by the tag check instead of dynamic_cast.
+ */
+template<class T>
+struct tixml_node_traits;
+
+template<>
+struct tixml_node_traits<TiXmlElement>
+{
+    static const int type = TiXmlNode::TINYXML_ELEMENT;
+};
+
+template<>
+struct tixml_node_traits<TiXmlDocument>
+{
+    static const int type = TiXmlNode::TINYXML_DOCUMENT;
+};
+
+/** Downcast TiXmlNode to the specified TiXml class
+ * @return casted node or NULL if node has different type
+ */
+template<class T>
+inline T* tixml_node_cast(TiXmlNode* node)
+{
+    typedef typename boost::remove_const<T>::type node_type;
+    return ( node && node->Type() == tixml_node_traits<node_type>::type ) ? static_cast<T*>(node) : NULL;
+}
+
+/** Downcast TiXmlNode to the specified TiXml class
+ * @return casted node or NULL if node has different type
+ */
+template<class T>
+inline T const* tixml_node_cast(TiXmlNode const* node)
+{
+    return ( node && node->Type() == tixml_node_traits<T>::type ) ? static_cast<T const*>(node) : NULL;
+}
+
 // forward
 template<typename T>
 class node_iterator_impl;
@@ -63,7 +101,7 @@ public:
     /// construct from xmlpp::node_iterator if can
     template<class P>
     element_iterator_impl(const node_iterator_impl<P>& rhs) : 
-        element( dynamic_cast<TiXmlElement*>(rhs->get_tixml_node()) ) {}
+        element( tixml_node_cast<TiXmlElement>( const_cast<TiXmlNode*>(rhs->get_tixml_node()) ) ) {}
 
     /// construct from xmlpp::element
     element_iterator_impl(T& _element) : 
@@ -78,6 +116,98 @@ public:
 	bool exist() const { return element.get_tixml_element() != NULL; }
 };
 
+/**
+ * Pattern for random access iterators throught the child elements. Stepping by one
+ * follows sibling links, other jumps use TiXmlNode::ChildElementAt, which is constant
+ * time if the parent has child index (see TiXmlNode::SetChildIndexThreshold).
+ */
+template<typename T>
+class indexed_element_iterator_impl :
+    public boost::iterator_facade<
+        indexed_element_iterator_impl<T>,
+        T,
+        boost::random_access_traversal_tag
+    >
+{
+private:
+    typedef typename boost::remove_const<T>::type element_type;
+    typedef boost::iterator_facade<
+        indexed_element_iterator_impl<T>,
+        T,
+        boost::random_access_traversal_tag
+    > base_type;
+    friend class boost::iterator_core_access;
+
+public:
+    typedef typename base_type::difference_type difference_type;
+
+private:
+    TiXmlNode*      parent;
+    int             index;
+    element_type    element;
+
+private:
+    void increment() { advance(1); }
+    void decrement() { advance(-1); }
+
+    void advance(difference_type n)
+    {
+        assert(parent);
+        TiXmlElement* current = element.get_tixml_element();
+        index += static_cast<int>(n);
+        if ( current && n == 1 ) {
+            element = element_type( current->NextSiblingElement() );
+        }
+        else if ( current && n == -1 ) {
+            element = element_type( current->PreviousSiblingElement() );
+        }
+        else {
+            element = element_type( parent->ChildElementAt(index) );
+        }
+    }
+
+    difference_type distance_to(indexed_element_iterator_impl const& other) const
+    {
+        return other.index - index;
+    }
+
+    bool equal(indexed_element_iterator_impl const& other) const
+    {
+        return parent == other.parent && index == other.index;
+    }
+
+    T& dereference() const 
+    { 
+        return const_cast<element_type&>(element); 
+    }
+
+public:
+    indexed_element_iterator_impl() :
+        parent(NULL),
+        index(0) {}
+
+    /// construct from mutable iterator
+    template<class P>
+    indexed_element_iterator_impl(const indexed_element_iterator_impl<P>& rhs) : 
+        parent( rhs.get_parent() ),
+        index( rhs.get_index() ),
+        element( const_cast<TiXmlElement*>(rhs->get_tixml_element()) ) {}
+
+    /// construct iterator addressing child element of the parent with specified index
+    indexed_element_iterator_impl(TiXmlNode* _parent, int _index) :
+        parent(_parent),
+        index(_index),
+        element( _parent->ChildElementAt(_index) ) {}
+
+    /// Get parent of the elements
+    TiXmlNode* get_parent() const { return parent; }
+
+    /// Get index of the addressed element among child elements of the parent
+    int get_index() const { return index; }
+
+	bool exist() const { return element.get_tixml_element() != NULL; }
+};
+
 /**
  * Pattern for node iterators
  */
@@ -32,6 +32,10 @@ typedef node_iterator_impl<node const>          const_node_iterator;
 typedef element_iterator_impl<element>          element_iterator;
 /// Const iterator type for iterating throught xml elements
 typedef element_iterator_impl<element const>    const_element_iterator;
+/// Random access iterator type for iterating throught child elements
+typedef indexed_element_iterator_impl<element>          indexed_element_iterator;
+/// Random access const iterator type for iterating throught child elements
+typedef indexed_element_iterator_impl<element const>    const_indexed_element_iterator;
 
 /**
  * Node implementation class wraps around TiXml classes
@@ -45,8 +49,9 @@ public:
     node();
     node(const node& rhs);
     explicit node(TiXmlNode* _tixmlNode);
+    virtual ~node() {}
 
-    /** Get TiXmlNode
+    /** Get TiXmlNode. Call prepare_modification before modifying it.
      * @return TiXmlNode it wraps
      */
     TiXmlNode* get_tixml_node() { return tixmlNode; }
@@ -131,6 +136,36 @@ public:
      */
     const_element_iterator end_child_element() const;
 
+    /** Get number of the child nodes. Constant time. */
+    size_t child_count() const;
+
+    /** Get number of the child elements. Constant time. */
+    size_t size() const;
+
+    /** Get child element by index, only elements are counted.
+     * Constant time if the node has child index(see TiXmlNode::SetChildIndexThreshold).
+     * @return iterator addressing n-th child element or end iterator if n is out of range.
+     */
+    element_iterator child_element(size_t n);
+
+    /** Get child element by index, only elements are counted.
+     * Constant time if the node has child index(see TiXmlNode::SetChildIndexThreshold).
+     * @return const iterator addressing n-th child element or end iterator if n is out of range.
+     */
+    const_element_iterator child_element(size_t n) const;
+
+    /** Get random access iterator to the first child element */
+    indexed_element_iterator first_indexed_element();
+
+    /** Get random access const iterator to the first child element */
+    const_indexed_element_iterator first_indexed_element() const;
+
+    /** Get random access iterator to the element after last child element */
+    indexed_element_iterator end_indexed_element();
+
+    /** Get random access const iterator to the element after last child element */
+    const_indexed_element_iterator end_indexed_element() const;
+
 	/** Remove all child nodes */
 	void clear();
 
@@ -143,6 +178,12 @@ public:
     /** Read node from istream */
     friend std::istream& operator >> (std::istream& is, node& n);
 
+    /** Called by the modifying methods and functions before the tree is changed.
+     * Document detaches its shared tree here, other nodes throw dom_error if their
+     * tree is shared by the copies of the document, see document::detach.
+     */
+    virtual void prepare_modification();
+
 protected:
     TiXmlNode* tixmlNode;
 };
@@ -165,11 +206,14 @@ protected:
     node_impl(const node_impl& rhs) : 
         node(rhs) {}
 
-    T* query_node() { return dynamic_cast<T*>(tixmlNode); }
-    T const* query_node() const { return dynamic_cast<T const*>(tixmlNode); }
+    T* query_node() { return tixml_node_cast<T>(tixmlNode); }
+    T const* query_node() const { return tixml_node_cast<T>( static_cast<TiXmlNode const*>(tixmlNode) ); }
 };
 
 /** Replace specified node with new node. Could throw dom_error.
+ * The new node is moved in place of the old one without copying, it is unlinked
+ * from its parent if it has one. The old node is deleted, both wrappers address
+ * the new node after that.
  * @param what - node for replacement
  * @param with - new node to replace old node
  */
@@ -177,6 +221,8 @@ void replace_node( node& what,
                    node& with );
 
 /** insert node before specified node. Could throw dom_error.
+ * The node is moved without copying, it is unlinked from its parent if it has one,
+ * the parent could be in another document.
  * @param beforeThis - before this node will be inserted node
  * @param node - node to insert
  */
@@ -184,6 +230,8 @@ void insert_before_node( node& beforeThis,
                          node& insertNode );
 
 /** Insert node after specified node. Could throw dom_error.
+ * The node is moved without copying, it is unlinked from its parent if it has one,
+ * the parent could be in another document.
  * @param afterThis - after this node will be inserted node
  * @param node - node to insert
  */
@@ -191,6 +239,8 @@ void insert_after_node( node& afterThis,
                         node& insertNode );
 
 /** Make node child of another node. Could throw dom_error.
+ * The node is moved without copying, it is unlinked from its parent if it has one,
+ * the parent could be in another document.
  * @param parent - parent node
  * @param child - new child node
  */
@@ -202,6 +252,16 @@ void add_child( node& parent,
  */
 void remove_node( node& what );
 
+/** Unlink specified node from its parent without deleting it. Could throw dom_error.
+ * The node is owned by the caller after that: it could be added to this or another
+ * document by add_child, insert_before_node, insert_after_node or replace_node in
+ * constant time, otherwise it must be deleted with its tiny xml node.
+ * Nodes of the documents could be moved without detaching as well, e.g. the records
+ * of the inbound document are moved to the aggregate one by add_child.
+ * @param what - node to detach
+ */
+void detach_node( node& what );
+
 } // namespace xmlpp
 
 #endif // XMLPP_NODE_H
@@ -0,0 +1,78 @@
+#ifndef XMLPP_NODE_POOL_H
+#define XMLPP_NODE_POOL_H
+
+#include "tinyxml.h"
+
+namespace xmlpp {
+
+/**
+ * Pool of the memory for the nodes and attributes. While the scope of the pool
+ * is open, everything created on the current thread is allocated from the pool:
+ * documents and their nodes, elements for add_child, copies made by replace_node
+ * and the text nodes of element::set_text. Freed nodes are kept by the pool for
+ * the next ones, so the documents modified frequently don't fragment the heap.
+ * Nodes are returned to the pool they were allocated from even after the scope
+ * is closed.
+ *
+ * Example:
+ * @verbatim
+ * node_pool pool;
+ * {
+ *     node_pool::scope scope(pool);
+ *     document doc("messages.xml");
+ *     update(doc);
+ * }
+ * @endverbatim
+ *
+ * Pool must outlive all the nodes allocated from it and must be used by one
+ * thread only.
+ */
+class node_pool
+{
+public:
+    /**
+     * Makes the pool current for the calling thread, previous pool is restored
+     * on destruction.
+     */
+    class scope
+    {
+    public:
+        explicit scope(node_pool& pool);
+        ~scope();
+
+    private:
+        // noncopyable
+        scope(const scope&);
+        scope& operator = (const scope&);
+
+    private:
+        TiXmlAllocator* previous;
+    };
+
+public:
+    /** @param chunkSize - size of the memory blocks requested from the heap */
+    explicit node_pool(size_t chunkSize = 16 * 1024) :
+        allocator(chunkSize)
+    {}
+
+    /** Get number of the nodes and attributes allocated from the pool */
+    size_t get_allocated() const { return allocator.Allocated(); }
+
+    /** Get size of the memory requested from the heap */
+    size_t get_reserved() const { return allocator.Reserved(); }
+
+    /** Get tiny xml allocator */
+    TiXmlAllocator* get_tixml_allocator() { return &allocator; }
+
+private:
+    // noncopyable
+    node_pool(const node_pool&);
+    node_pool& operator = (const node_pool&);
+
+private:
+    TiXmlPoolAllocator allocator;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_NODE_POOL_H
@@ -0,0 +1,95 @@
+#ifndef XMLPP_PUSH_PARSER_H
+#define XMLPP_PUSH_PARSER_H
+
+#include "document.h"
+#include <vector>
+
+namespace xmlpp {
+
+/**
+ * Incremental parser for the xml arriving in chunks, e.g. from the socket.
+ * Chunks could be split at any byte. The parser keeps the tokenizer state
+ * between the chunks, so every byte is scanned once, and only the unfinished
+ * markup or text is kept until the next chunk. The DOM is built while parsing:
+ * complete nodes are linked to the document as soon as they are read.
+ *
+ * Example:
+ * @verbatim
+ * document doc;
+ * push_parser parser(doc);
+ * while ( size_t size = socket.read(buffer, sizeof(buffer)) ) {
+ *     parser.feed(buffer, size);
+ * }
+ * parser.finish();
+ * @endverbatim
+ *
+ * Nodes are parsed by the tiny xml, so the result is the same as of the
+ * document::set_source, except that row and column of the nodes are not tracked
+ * and the parse filter is not used. Markup is split the same way as by the tiny
+ * xml, so DOCTYPE with the internal subset is not supported.
+ */
+class push_parser
+{
+public:
+    /** Start parsing into the document, previous content of the document is removed */
+    explicit push_parser(document& doc);
+
+    /** Parse next chunk of the xml.
+     * @throws dom_error, the parser must be reset after the error.
+     */
+    void feed(const char* data, size_t size);
+
+    /** Check that document is complete and call document::on_load.
+     * @throws dom_error
+     */
+    void finish();
+
+    /** Clear the document and start parsing the new one */
+    void reset();
+
+    /** Get number of the open elements */
+    size_t get_depth() const { return stack.size() - 1; }
+
+private:
+    enum unit_kind
+    {
+        UNIT_TEXT,
+        UNIT_MARKUP,        /// markup, kind is not known yet
+        UNIT_TAG,
+        UNIT_COMMENT,
+        UNIT_CDATA,
+        UNIT_PI,
+        UNIT_DECLARATION
+    };
+
+private:
+    char        unit_char(size_t offset, const char* chunk) const;
+    bool        classify(const char* chunk, size_t available);
+    const char* scan(const char* first, const char* last, size_t offset, const char* chunk);
+    const char* scan_terminator(const char* first, const char* last, size_t offset, const char* chunk);
+
+    void        process_text(const char* text, size_t length);
+    void        process_markup(const char* markup, size_t length);
+    void        start_tag(const char* tag, size_t length);
+    void        end_tag(const char* tag, size_t length);
+    TiXmlNode*  new_node(TiXmlNode::NodeType type);
+    void        add_node(TiXmlNode* node, const char* markup);
+    void        fail(int errorId);
+
+private:
+    document&               doc;
+    TiXmlEncoding           encoding;
+    std::vector<TiXmlNode*> stack;      /// open elements, the document is the bottom
+
+    // tokenizer state
+    unit_kind               kind;
+    std::string             pending;    /// unfinished unit from the previous chunks
+    size_t                  scanned;    /// number of the scanned bytes of the unit
+    char                    quote;      /// open quote in the tag
+
+    std::string             scratch;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_PUSH_PARSER_H
@@ -0,0 +1,263 @@
+#ifndef XMLPP_QUERY_H
+#define XMLPP_QUERY_H
+
+#include "element.h"
+#include <set>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/range/iterator_range.hpp>
+
+namespace xmlpp {
+
+/**
+ * Predicate of the compiled path step
+ */
+struct query_predicate
+{
+    enum kind_type
+    {
+        HAS_ATTRIBUTE,
+        ATTRIBUTE_EQUAL,
+        HAS_CHILD,
+        CHILD_EQUAL,
+        TEXT_EQUAL,
+        POSITION,
+        LAST
+    };
+
+    kind_type   kind;
+    std::string name;
+    std::string value;
+    int         position;
+
+    query_predicate() : kind(HAS_ATTRIBUTE), position(0) {}
+};
+
+/**
+ * Step of the compiled path
+ */
+struct query_step
+{
+    enum axis_type
+    {
+        CHILD,
+        DESCENDANT
+    };
+
+    axis_type                       axis;
+    std::string                     name;       /// empty matches any element
+    std::vector<query_predicate>    predicates;
+    bool                            positional; /// has position or last() predicates
+
+    query_step() : axis(CHILD), positional(false) {}
+};
+
+/**
+ * Compiled path, see query for the syntax
+ */
+struct query_program
+{
+    std::vector<query_step> steps;
+    bool                    absolute;
+    bool                    textOnly;   /// path ends with text()
+    bool                    unique;     /// matches could repeat, filter them
+
+    query_program() : absolute(false), textOnly(false), unique(false) {}
+};
+
+/**
+ * Evaluation state of the query. Keeps cursor for every step of the path,
+ * so matches are produced one by one without building intermediate node sets.
+ */
+class query_state
+{
+public:
+    /// construct finished state
+    query_state();
+
+    /// start evaluation of the program in the context node
+    query_state(const boost::shared_ptr<const query_program>& program, TiXmlNode* context);
+
+    /** Get current match, NULL if evaluation is finished */
+    TiXmlElement* get_match() const { return match; }
+
+    /** Move to the next match */
+    void next();
+
+private:
+    struct frame
+    {
+        TiXmlNode*          context;
+        TiXmlNode*          current;
+        int                 depth;      /// depth of the current relative to the context
+        bool                exhausted;
+        std::vector<int>    counters;   /// counters of the positional predicates for every level
+    };
+
+private:
+    void start_frame(size_t step, TiXmlNode* context);
+    bool advance_frame(size_t step);
+    bool advance_child(size_t step);
+    bool advance_descendant(size_t step);
+
+private:
+    boost::shared_ptr<const query_program>  program;
+    std::vector<frame>                      frames;
+    size_t                                  top;
+    std::set<const TiXmlElement*>           visited;
+    TiXmlElement*                           match;
+};
+
+/**
+ * Forward iterator throught the query matches
+ */
+template<typename T>
+class query_iterator_impl :
+    public boost::iterator_facade<
+        query_iterator_impl<T>,
+        T,
+        boost::forward_traversal_tag
+    >
+{
+private:
+    typedef typename boost::remove_const<T>::type element_type;
+    friend class boost::iterator_core_access;
+
+private:
+    query_state     state;
+    element_type    element;
+
+private:
+    void increment()
+    {
+        state.next();
+        element = element_type( state.get_match() );
+    }
+
+    bool equal(query_iterator_impl const& other) const
+    {
+        return state.get_match() == other.state.get_match();
+    }
+
+    T& dereference() const
+    {
+        return const_cast<element_type&>(element);
+    }
+
+public:
+    /// construct end iterator
+    query_iterator_impl() {}
+
+    /// construct from the evaluation state
+    explicit query_iterator_impl(const query_state& _state) :
+        state(_state),
+        element( _state.get_match() ) {}
+
+    /// construct from mutable iterator
+    template<class P>
+    query_iterator_impl(const query_iterator_impl<P>& rhs) :
+        state( rhs.get_state() ),
+        element( rhs.get_state().get_match() ) {}
+
+    /// Get evaluation state
+    const query_state& get_state() const { return state; }
+
+    operator bool () const { return state.get_match() != NULL; }
+
+	bool exist() const { return state.get_match() != NULL; }
+};
+
+/// Iterator type for iterating throught query matches
+typedef query_iterator_impl<element>          query_iterator;
+/// Const iterator type for iterating throught query matches
+typedef query_iterator_impl<element const>    const_query_iterator;
+
+/**
+ * Compiled path query. Supports subset of the XPath 1.0 location paths:
+ * @verbatim
+ *  /Store/Car          - absolute path, starts from the document
+ *  Car/Model           - relative path, starts from the context node
+ *  //Model, Car//Part  - descendant axis
+ *  Car/ *              - any element
+ *  Car[@id]            - has attribute
+ *  Car[@id='5']        - attribute value equals literal
+ *  Car[Model]          - has child element
+ *  Car[Model='x']      - child element text equals literal
+ *  Car[text()='x']     - text of the element equals literal
+ *  Car[2], Car[last()] - position among siblings, 1 based
+ *  Car/text()          - elements having text, must be the last step
+ * @endverbatim
+ * Query is compiled once and could be evaluated against different nodes
+ * many times, also concurrently. Matches are evaluated lazily while iterating.
+ * Matches are produced in document order, except paths with several
+ * descendant steps, where matches are unique but the order is unspecified.
+ */
+class query
+{
+public:
+    typedef boost::iterator_range<query_iterator>          range;
+    typedef boost::iterator_range<const_query_iterator>    const_range;
+
+public:
+    /** Construct empty query, it matches nothing */
+    query();
+
+    /** Compile the path.
+     * @throws dom_error if path has syntax error or unsupported feature
+     */
+    explicit query(const std::string& path);
+
+    /** Compile the path, previous path is discarded.
+     * @throws dom_error if path has syntax error or unsupported feature
+     */
+    void compile(const std::string& path);
+
+    /** Get source path of the query */
+    const std::string& get_path() const { return path; }
+
+    /** Get compiled path, NULL if query is empty */
+    const query_program* get_program() const { return program.get(); }
+
+    /** Get iterator addressing first match
+     * @param context - node to evaluate relative path against.
+     */
+    query_iterator begin(node& context) const;
+
+    /** Get const iterator addressing first match
+     * @param context - node to evaluate relative path against.
+     */
+    const_query_iterator begin(const node& context) const;
+
+    /** Get iterator addressing match after last match */
+    query_iterator end(node& /*context*/) const { return query_iterator(); }
+
+    /** Get const iterator addressing match after last match */
+    const_query_iterator end(const node& /*context*/) const { return const_query_iterator(); }
+
+    /** Get range of the matches */
+    range select(node& context) const { return range( begin(context), end(context) ); }
+
+    /** Get range of the matches */
+    const_range select(const node& context) const { return const_range( begin(context), end(context) ); }
+
+    /** Get first match
+     * @return iterator addressing first match or end iterator if there are no matches.
+     */
+    element_iterator select_first(node& context) const;
+
+    /** Get first match
+     * @return iterator addressing first match or end iterator if there are no matches.
+     */
+    const_element_iterator select_first(const node& context) const;
+
+    /** Get number of matches */
+    size_t count(const node& context) const;
+
+private:
+    std::string                             path;
+    boost::shared_ptr<const query_program>  program;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_QUERY_H
@@ -242,7 +242,7 @@ public:
         {
             ss << (*iter);
         }
-        e.set_text( ss.str().c_str() );
+        e.set_text( ss.str() );
     }
 
 private:
@@ -0,0 +1,116 @@
+#ifndef XMLPP_STREAM_MATCHER_H
+#define XMLPP_STREAM_MATCHER_H
+
+#include "document.h"
+#include "query.h"
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+
+namespace xmlpp {
+
+/**
+ * Evaluates set of paths while scanning the xml stream, without building the DOM.
+ * Open elements are tracked by the automaton: every open element keeps the set of
+ * path steps which could be matched by its children. Only subtrees of the matched
+ * elements are parsed into the DOM and passed to the callback. Subtrees where no
+ * path could match are skipped by balancing tags only.
+ *
+ * Paths are compiled by xmlpp::query and evaluated against the document, both
+ * absolute and relative paths start at the document. Streaming supports
+ * child and descendant axes, name tests and attribute predicates.
+ *
+ * Example:
+ * @verbatim
+ * stream_matcher matcher;
+ * matcher.add_path("/Store/Car/Model", boost::bind(&print_model, _1));
+ * matcher.parse_file("store.xml");
+ * @endverbatim
+ */
+class stream_matcher
+{
+public:
+    /** Callback receiving matched element. Element belongs to the temporary document
+     * and is valid only during the call, clone it to keep.
+     */
+    typedef boost::function<void (element&)> callback_type;
+
+public:
+    stream_matcher();
+
+    /** Add path to match.
+     * @param path - path to match, see xmlpp::query.
+     * @param callback - function to call with every matched element.
+     * @return index of the path.
+     * @throws dom_error if path has syntax error or unsupported feature.
+     */
+    size_t add_path(const std::string& path, const callback_type& callback);
+
+    /** Add path to match.
+     * @param q - compiled path.
+     * @param callback - function to call with every matched element.
+     * @return index of the path.
+     * @throws dom_error if path has unsupported feature.
+     */
+    size_t add_path(const query& q, const callback_type& callback);
+
+    /** Remove all paths */
+    void clear();
+
+    /** Set size of the blocks read from the stream. Default is 64Kb. */
+    void set_chunk_size(size_t chunkSize);
+
+    /** Scan xml document in memory.
+     * @throws dom_error
+     */
+    void parse(size_t size, const char* source);
+
+    /** Scan xml document from the stream.
+     * @throws dom_error
+     */
+    void parse(std::istream& is);
+
+    /** Scan xml document from the file, compressed files are detected by the magic bytes.
+     * @throws dom_error, file_error
+     */
+    void parse_file(const std::string& fileName);
+
+private:
+    typedef boost::uint64_t mask_type;
+
+    struct path_entry
+    {
+        query           q;
+        callback_type   callback;
+    };
+
+    struct capture
+    {
+        size_t  start;      /// start of the element in the captured text
+        size_t  depth;      /// depth of the element
+        size_t  path;       /// index of the matched path
+    };
+
+private:
+    void        reset();
+    const char* scan(const char* first, const char* last, bool final);
+    void        start_element(const char* tag, const char* tagEnd, bool empty);
+    void        end_element();
+    void        deliver(const capture& c);
+
+private:
+    std::vector<path_entry> paths;
+    size_t                  chunkSize;
+
+    // automaton state
+    std::vector<mask_type>  masks;      /// active steps of every path for every live level
+    size_t                  depth;      /// number of open elements
+    size_t                  liveDepth;  /// number of open elements having active steps
+
+    // matched subtrees
+    std::string             captured;
+    std::vector<capture>    captures;
+};
+
+} // namespace xmlpp
+
+#endif // XMLPP_STREAM_MATCHER_H
@@ -0,0 +1,88 @@
+#ifndef XMLPP_STRUCTURAL_HASH_H
+#define XMLPP_STRUCTURAL_HASH_H
+
+#include "node.h"
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace xmlpp {
+
+/**
+ * Flags of the structural comparison and hashing
+ */
+enum structural_flags
+{
+    /// attributes are compared as the sets, by default their order matters
+    IGNORE_ATTRIBUTE_ORDER  = 1,
+    /// hashes of the subtrees are cached by the nodes, see structural_hash. Not thread safe.
+    CACHE_HASH              = 2
+};
+
+/**
+ * 128 bit structural hash of the subtree. Each half is the good 64 bit hash
+ * on its own. The hash is not cryptographic.
+ */
+struct hash_value
+{
+    boost::uint64_t low;
+    boost::uint64_t high;
+
+    hash_value() : low(0), high(0) {}
+    hash_value(boost::uint64_t low_, boost::uint64_t high_) : low(low_), high(high_) {}
+
+    bool operator == (const hash_value& rhs) const { return low == rhs.low && high == rhs.high; }
+    bool operator != (const hash_value& rhs) const { return !(*this == rhs); }
+    bool operator <  (const hash_value& rhs) const { return low < rhs.low || (low == rhs.low && high < rhs.high); }
+};
+
+/** Get hash of the node and its subtree: types, values, attributes and the order
+ * of the children are hashed, so deep equal subtrees have equal hashes. Name of
+ * the document is not hashed. The tree is walked without recursion.
+ * With CACHE_HASH the hashes of the node and its descendants are kept by the nodes
+ * and reused until the subtree is changed, so rehashing of the document after the
+ * small change only walks the changed paths. Changes made through TiXmlAttribute
+ * directly are not tracked, call TiXmlNode::InvalidateSubtreeCache of the element
+ * after them.
+ * @note The cache is written through the const node. Don't use CACHE_HASH while
+ * the same document is read from several threads, like the snapshots of the
+ * document_cache or the copies of the document sharing the tree, use the table
+ * overload instead.
+ * @param n - root of the subtree
+ * @param flags - combination of structural_flags
+ */
+hash_value structural_hash(const node& n, int flags = 0);
+
+/** Hash of the subtree with the number of its nodes */
+struct subtree_hash
+{
+    hash_value  hash;
+    size_t      size;
+
+    subtree_hash() : size(0) {}
+    subtree_hash(const hash_value& hash_, size_t size_) : hash(hash_), size(size_) {}
+};
+
+typedef std::vector<subtree_hash> hash_table;
+
+/** Get hashes of all the subtrees of the node like structural_hash, but they
+ * are stored to the table instead of the nodes, CACHE_HASH is ignored. Subtrees
+ * are stored in the document order: the node first, then the subtrees of its
+ * children one after another, so the first child of the entry i is at i + 1 and
+ * its next sibling is at i + table[i].size. The nodes are not modified, so several
+ * threads could hash the same document at once, each with its own table.
+ * @return hash of the node
+ */
+hash_value structural_hash(const node& n, int flags, hash_table& table);
+
+/** Compare subtrees: types, values, attributes and children in the same order.
+ * Cached hashes computed with the same flags are used to find the differing
+ * subtrees quickly, equal hashes are verified by comparison.
+ * @note Cached hashes are read, so the trees must not be hashed with CACHE_HASH
+ * by another thread meanwhile.
+ * @param flags - IGNORE_ATTRIBUTE_ORDER or 0
+ */
+bool deep_equal(const node& lhs, const node& rhs, int flags = 0);
+
+} // namespace xmlpp
+
+#endif // XMLPP_STRUCTURAL_HASH_H
@@ -92,11 +92,26 @@ class TiXmlAttribute;
 class TiXmlText;
 class TiXmlDeclaration;
 class TiXmlParsingData;
+class TiXmlNodeRecycler;
+class TiXmlPrinter;
+struct TiXmlNodeIndex;
+struct TiXmlPrintedText;
 
 const int TIXML_MAJOR_VERSION = 2;
 const int TIXML_MINOR_VERSION = 6;
 const int TIXML_PATCH_VERSION = 1;
 
+/** Structural hash of the subtree cached by the node, see TiXmlNode::SubtreeHash
+	and xmlpp::structural_hash.
+*/
+struct TiXmlSubtreeHash
+{
+	unsigned long long	low;
+	unsigned long long	high;
+	int					flags;	// flags the hash was computed with
+	bool				valid;	// reset when the subtree is changed
+};
+
 /*	Internal structure for tracking location of items 
 	in the XML file.
 */
@@ -154,6 +169,108 @@ public:
 	virtual bool Visit( const TiXmlUnknown& /*unknown*/ )			{ return true; }
 };
 
+/**
+	Implement the TiXmlParseFilter interface to skip unwanted elements while
+	parsing. The filter is asked before each child element is parsed. If it
+	returns false, the whole subtree is skipped by balancing the tags only:
+	no nodes, attributes or strings are created for it, and it isn't checked
+	beyond that.
+
+	The filter is not used by operator>>.
+
+	@sa TiXmlDocument::SetParseFilter()
+*/
+class TiXmlParseFilter
+{
+public:
+	virtual ~TiXmlParseFilter() {}
+
+	/** Called before the child element is parsed.
+		@param parent	Element being parsed. Its attributes are complete, children
+						are parsed up to this one.
+		@param name		Name of the child element, not null terminated.
+		@param length	Length of the name.
+		@return false to skip the child element.
+	*/
+	virtual bool AcceptElement( const TiXmlElement& parent, const char* name, size_t length ) = 0;
+};
+
+/**
+	Implement the TiXmlAllocator interface to allocate the nodes and attributes
+	from your own memory instead of the global operator new. The allocator is
+	set per thread with SetCurrent() and is used for all TinyXml objects created
+	with new on that thread, including the nodes created by the parser, Clone()
+	and the Set... methods.
+
+	The allocator of every object is stored with it, so the object is returned
+	to its own allocator even if another one is current when it is deleted. The
+	allocator must outlive the objects allocated from it, and an allocator that
+	is not thread safe must not be used by objects deleted on other threads.
+
+	@sa TiXmlPoolAllocator
+*/
+class TiXmlAllocator
+{
+public:
+	virtual ~TiXmlAllocator() {}
+
+	/// Allocate the memory of the object, aligned for any TinyXml class.
+	virtual void* Allocate( size_t size ) = 0;
+	/// Free the memory of the object, size is the one passed to Allocate().
+	virtual void Deallocate( void* p, size_t size ) = 0;
+
+	/// Return the allocator of the calling thread, null means the global operator new.
+	static TiXmlAllocator* Current();
+	/// Set the allocator of the calling thread, null restores the global operator new. Returns the previous one.
+	static TiXmlAllocator* SetCurrent( TiXmlAllocator* allocator );
+};
+
+/**
+	Free list allocator with the size classes. Blocks of each size class are
+	carved from the chunks and are kept on the free list of their class when
+	deallocated, so mutation heavy code doesn't reach the global heap after the
+	warm-up and nodes of the document stay close to each other. Objects larger
+	than the biggest class are allocated by the global operator new.
+
+	Chunks are released by the destructor only. The pool is not thread safe.
+*/
+class TiXmlPoolAllocator : public TiXmlAllocator
+{
+public:
+	/// Each chunk is chunkSize bytes or one block of its size class if larger.
+	TiXmlPoolAllocator( size_t chunkSize = 16 * 1024 );
+	virtual ~TiXmlPoolAllocator();
+
+	virtual void* Allocate( size_t size );
+	virtual void Deallocate( void* p, size_t size );
+
+	/// Number of the blocks in use.
+	size_t Allocated() const	{ return allocated; }
+	/// Total size of the chunks.
+	size_t Reserved() const		{ return reserved; }
+
+private:
+	TiXmlPoolAllocator( const TiXmlPoolAllocator& );	// not allowed
+	void operator=( const TiXmlPoolAllocator& );		// not allowed
+
+	enum
+	{
+		GRANULARITY = 16,
+		SIZE_CLASSES = 32		// blocks up to 512 bytes
+	};
+
+	struct Block { Block* next; };
+	struct Chunk { Chunk* next; };
+
+	void AddChunk( size_t sizeClass );
+
+	Block* freeBlocks[ SIZE_CLASSES ];
+	Chunk* chunks;
+	size_t chunkSize;
+	size_t allocated;
+	size_t reserved;
+};
+
 // Only used by Attribute::Query functions
 enum 
 { 
@@ -173,6 +290,14 @@ enum TiXmlEncoding
 
 const TiXmlEncoding TIXML_DEFAULT_ENCODING = TIXML_ENCODING_UNKNOWN;
 
+// How the parser treats the white space only text between the tags.
+enum TiXmlWhiteSpaceMode
+{
+	TIXML_WHITESPACE_DROP,		// no text node is created, the default
+	TIXML_WHITESPACE_KEEP,		// text node with the white space as is
+	TIXML_WHITESPACE_COLLAPSE	// text node with the single space
+};
+
 /** TiXmlBase is a base class for every class in TinyXml.
 	It does little except to establish that TinyXml classes
 	can be printed and provide some utility functions.
@@ -200,6 +325,7 @@ class TiXmlBase
 	friend class TiXmlNode;
 	friend class TiXmlElement;
 	friend class TiXmlDocument;
+	friend class TiXmlNodeRecycler;
 
 public:
 	TiXmlBase()	:	userData(0)		{}
@@ -252,6 +378,10 @@ public:
 	void* GetUserData()						{ return userData; }	///< Get a pointer to arbitrary user data.
 	const void* GetUserData() const 		{ return userData; }	///< Get a pointer to arbitrary user data.
 
+	/// TinyXml objects are allocated by the current TiXmlAllocator of the thread.
+	static void* operator new( size_t size );
+	static void operator delete( void* p, size_t size );
+
 	// Table that returs, for a given lead byte, the total number of bytes
 	// in the UTF-8 sequence.
 	static const int utf8ByteTable[256];
@@ -283,6 +413,8 @@ public:
 		TIXML_ERROR_EMBEDDED_NULL,
 		TIXML_ERROR_PARSING_CDATA,
 		TIXML_ERROR_DOCUMENT_TOP_ONLY,
+		TIXML_ERROR_DEPTH_EXCEEDED,
+		TIXML_ERROR_UNEXPECTED_END,
 
 		TIXML_ERROR_STRING_COUNT
 	};
@@ -291,6 +423,12 @@ protected:
 
 	static const char* SkipWhiteSpace( const char*, TiXmlEncoding encoding );
 
+	/*	Skips the element starting at '<' with all its content by balancing
+		the tags only. Returns a pointer past the end tag, or 0 if the
+		element isn't closed.
+	*/
+	static const char* SkipElement( const char* p );
+
 	inline static bool IsWhiteSpace( char c )		
 	{ 
 		return ( isspace( (unsigned char) c ) || c == '\n' || c == '\r' ); 
@@ -428,6 +566,9 @@ class TiXmlNode : public TiXmlBase
 {
 	friend class TiXmlDocument;
 	friend class TiXmlElement;
+	friend class TiXmlNodeRecycler;
+	friend class TiXmlPrinter;
+	friend struct TiXmlNodeIndex;
 
 public:
 	#ifdef TIXML_USE_STL	
@@ -509,11 +650,11 @@ public:
 		Text:		the text string
 		@endverbatim
 	*/
-	void SetValue(const char * _value) { value = _value;}
+	void SetValue(const char * _value) { value = _value; ValueChanged(); }
 
     #ifdef TIXML_USE_STL
 	/// STL std::string form.
-	void SetValue( const std::string& _value )	{ value = _value; }
+	void SetValue( const std::string& _value )	{ value = _value; ValueChanged(); }
 	#endif
 
 	/// Delete all the children of this node. Does not affect 'this'.
@@ -591,6 +732,8 @@ public:
 		henceforth owned (and deleted) by tinyXml. This method is efficient
 		and avoids an extra copy, but should be used with care as it
 		uses a different memory model than the other insert functions.
+		The node which has a parent is moved, see LinkBeforeChild().
+		The node could be moved from another document.
 
 		@sa InsertEndChild
 	*/
@@ -611,9 +754,33 @@ public:
 	*/
 	TiXmlNode* ReplaceChild( TiXmlNode* replaceThis, const TiXmlNode& withThis );
 
+	/** Add a node related to this. Adds a child before the specified child.
+		The node is moved without copying: if it has a parent, it is unlinked
+		from it first, even from another document, otherwise it is henceforth owned (and deleted) by tinyXml
+		like with LinkEndChild. Constant time.
+		Returns addThis or NULL if an error occured, e.g. addThis is this node or
+		its ancestor. The node is left as it was on error.
+	*/
+	TiXmlNode* LinkBeforeChild( TiXmlNode* beforeThis, TiXmlNode* addThis );
+
+	/// Add a node related to this. Adds a child after the specified child, see LinkBeforeChild().
+	TiXmlNode* LinkAfterChild( TiXmlNode* afterThis, TiXmlNode* addThis );
+
+	/** Replace a child of this node with the node moved like by LinkBeforeChild().
+		The replaced child is deleted. Returns withThis or NULL if an error occured.
+	*/
+	TiXmlNode* LinkReplaceChild( TiXmlNode* replaceThis, TiXmlNode* withThis );
+
 	/// Delete a child of this node.
 	bool RemoveChild( TiXmlNode* removeThis );
 
+	/** Unlink a child of this node without deleting it. The child is henceforth
+		owned by the caller: it could be linked to any node of this or another
+		document with the Link... methods in constant time, or deleted.
+		Returns removeThis or NULL if it is not a child of this node.
+	*/
+	TiXmlNode* DetachChild( TiXmlNode* removeThis );
+
 	/// Navigate to a sibling node.
 	const TiXmlNode* PreviousSibling() const			{ return prev; }
 	TiXmlNode* PreviousSibling()						{ return prev; }
@@ -664,6 +831,15 @@ public:
 	TiXmlElement* NextSiblingElement( const std::string& _value)				{	return NextSiblingElement (_value.c_str ());	}	///< STL std::string form.
 	#endif
 
+	/** Convenience function to get through elements backwards.
+		Calls PreviousSibling and ToElement. Will skip all non-Element
+		nodes. Returns 0 if there is not another element.
+	*/
+	const TiXmlElement* PreviousSiblingElement() const;
+	TiXmlElement* PreviousSiblingElement() {
+		return const_cast< TiXmlElement* >( (const_cast< const TiXmlNode* >(this))->PreviousSiblingElement() );
+	}
+
 	/// Convenience function to get through elements.
 	const TiXmlElement* FirstChildElement()	const;
 	TiXmlElement* FirstChildElement() {
@@ -695,9 +871,71 @@ public:
 		return const_cast< TiXmlDocument* >( (const_cast< const TiXmlNode* >(this))->GetDocument() );
 	}
 
+	/** Get the structural hash of the subtree cached by SetSubtreeHash, null if
+		it was not cached or the subtree was changed since. Changes are tracked by
+		the nodes, except the changes made through TiXmlAttribute directly: call
+		InvalidateSubtreeCache on the element after them.
+	*/
+	const TiXmlSubtreeHash* SubtreeHash() const	{ return subtreeHash && subtreeHash->valid ? subtreeHash : 0; }
+
+	/** Cache the structural hash of the subtree. Hashes of all the descendants
+		must be cached before, so the change of the node only resets the hashes
+		of its ancestors up to the first one without the hash.
+	*/
+	void SetSubtreeHash( unsigned long long low, unsigned long long high, int flags ) const;
+
+	/** Reset the cached hashes and the printed text of the node and its ancestors,
+		see SetSubtreeHash and TiXmlPrinter::SetCacheSubtrees.
+	*/
+	void InvalidateSubtreeCache() const;
+
+	/// Free the text of the subtree kept by the caching printer, see TiXmlPrinter::SetCacheSubtrees.
+	void ClearPrintedText() const;
+
 	/// Returns true if this node has no children.
 	bool NoChildren() const						{ return !firstChild; }
 
+	/// Returns the number of children of this node. Constant time.
+	int ChildCount() const						{ return childCount; }
+
+	/// Returns the number of child elements of this node. Constant time.
+	int ChildElementCount() const				{ return childElementCount; }
+
+	/** Return the "index" child. The first child is 0, the second 1, etc.
+		Constant time if the node has a child index (see SetChildIndexThreshold),
+		otherwise walks the list from the closer end. Returns null if the index
+		is out of range.
+	*/
+	const TiXmlNode* ChildAt( int index ) const;
+	TiXmlNode* ChildAt( int index ) {
+		return const_cast< TiXmlNode* >( (const_cast< const TiXmlNode* >(this))->ChildAt( index ) );
+	}
+
+	/** Return the "index" child element. The first child element is 0, the second 1, etc.
+		Note that only TiXmlElements are indexed: other types are not counted.
+		Complexity is the same as of ChildAt.
+	*/
+	const TiXmlElement* ChildElementAt( int index ) const;
+	TiXmlElement* ChildElementAt( int index ) {
+		return const_cast< TiXmlElement* >( (const_cast< const TiXmlNode* >(this))->ChildElementAt( index ) );
+	}
+
+	/** Nodes with at least 'threshold' children build an array of child pointers
+		on the first indexed access, so that following ChildAt and ChildElementAt
+		calls are constant time. The first lookup by name (FirstChildElement( value ),
+		NextSiblingElement( value )) additionally builds a map from the element
+		name to the elements, so the lookups don't scan siblings. The index is
+		dropped whenever a child is added, removed or renamed. 0 disables the
+		index, which is the default.
+
+		@note The index is built lazily by const accessors. Don't enable it while
+		the same document is read from several threads.
+	*/
+	static void SetChildIndexThreshold( int threshold )	{ childIndexThreshold = threshold; }
+
+	/// Return the current child index threshold.
+	static int ChildIndexThreshold()						{ return childIndexThreshold; }
+
 	virtual const TiXmlDocument*    ToDocument()    const { return 0; } ///< Cast to a more defined type. Will return null if not of the requested type.
 	virtual const TiXmlElement*     ToElement()     const { return 0; } ///< Cast to a more defined type. Will return null if not of the requested type.
 	virtual const TiXmlComment*     ToComment()     const { return 0; } ///< Cast to a more defined type. Will return null if not of the requested type.
@@ -754,7 +992,8 @@ protected:
 	#endif
 
 	// Figure out what is at *p, and parse it. Returns null if it is not an xml node.
-	TiXmlNode* Identify( const char* start, TiXmlEncoding encoding );
+	// The document is the one being parsed, the new node could be reused from it.
+	TiXmlNode* Identify( const char* start, TiXmlEncoding encoding, TiXmlDocument* document );
 
 	TiXmlNode*		parent;
 	NodeType		type;
@@ -767,9 +1006,39 @@ protected:
 	TiXmlNode*		prev;
 	TiXmlNode*		next;
 
+	// Keep child counters and the index in sync with the child list. ChildLinked
+	// is called after the node is linked, ChildUnlinked before it is unlinked.
+	void ChildLinked( const TiXmlNode* node );
+	void ChildUnlinked( const TiXmlNode* node );
+	// Check that the node could be linked to this one and unlink it from its parent.
+	bool PrepareLink( TiXmlNode* node );
+	// Unlink the child without deleting it.
+	void UnlinkChild( TiXmlNode* node );
+	// Delete the children without recursion.
+	void DeleteChildren();
+
 private:
 	TiXmlNode( const TiXmlNode& );				// not implemented.
 	void operator=( const TiXmlNode& base );	// not allowed.
+
+	const TiXmlNodeIndex* Index() const;
+	void DropIndex() const;
+	void ValueChanged();
+
+	// Look up the first child element with the specified name following 'after'
+	// (or the first one if 'after' is null) in the index. Sets 'indexed' to false
+	// if the node has no index.
+	const TiXmlElement* FindIndexedElement( const char* _value, const TiXmlNode* after, bool* indexed ) const;
+
+	int						childCount;
+	int						childElementCount;
+	mutable TiXmlNodeIndex*	index;
+	mutable int				indexPosition;	// position among siblings, valid while parent has index
+	mutable TiXmlSubtreeHash*	subtreeHash;
+	mutable TiXmlPrintedText*	printedText;	// text of the subtree kept by the caching printer
+	mutable bool				printed;		// the node or its ancestors could have the printed text
+
+	static int childIndexThreshold;
 };
 
 
@@ -783,6 +1052,7 @@ private:
 class TiXmlAttribute : public TiXmlBase
 {
 	friend class TiXmlAttributeSet;
+	friend class TiXmlNodeRecycler;
 
 public:
 	/// Construct an empty attribute.
@@ -943,6 +1213,8 @@ private:
 */
 class TiXmlElement : public TiXmlNode
 {
+	friend class TiXmlNodeRecycler;
+
 public:
 	/// Construct an element.
 	TiXmlElement (const char * in_value);
@@ -1071,6 +1343,13 @@ public:
 	*/
 	void SetDoubleAttribute( const char * name, double value );
 
+	/** Adds the attribute without looking for the existing one, the names must
+		be unique, e.g. when the element is loaded from the known good source.
+		The attribute is reused from the document if it keeps the removed nodes,
+		the document is passed rather than searched from the element.
+	*/
+	void AppendAttribute( TiXmlDocument* document, const TIXML_STRING& name, const TIXML_STRING& _value );
+
 	/** Deletes an attribute with the given name.
 	*/
 	void RemoveAttribute( const char * name );
@@ -1137,6 +1416,7 @@ public:
 protected:
 
 	void CopyTo( TiXmlElement* target ) const;
+	void CopyAttributesTo( TiXmlElement* target ) const;
 	void ClearThis();	// like clear, but initializes 'this' object as well
 
 	// Used to be public [internal use]
@@ -1145,11 +1425,35 @@ protected:
 	#endif
 	/*	[internal use]
 		Reads the "value" of the element -- another element, or text.
-		This should terminate with the current end tag.
+		This should terminate with the current end tag, which is read too.
+		Descendants are read without recursion, the open elements are
+		found by their parent pointers.
 	*/
 	const char* ReadValue( const char* in, TiXmlParsingData* prevData, TiXmlEncoding encoding );
 
+	/*	[internal use]
+		Reads the name and the attributes of the element. Sets empty if
+		the tag is closed by "/>", the content follows otherwise.
+	*/
+	const char* ReadStartTag( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding, bool* empty );
+
+	/*	[internal use]
+		Reads the end tag of the element.
+	*/
+	const char* ReadEndTag( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding );
+
+	/*	[internal use]
+		Asks the parse filter whether the child element starting at p should be parsed.
+	*/
+	bool AcceptChild( TiXmlParseFilter* filter, const char* p ) const;
+
 private:
+	// Find the attribute or add the new one, reused from the document if it keeps the nodes.
+	TiXmlAttribute* FindOrCreateAttribute( const char* _name );
+	#ifdef TIXML_USE_STL
+	TiXmlAttribute* FindOrCreateAttribute( const std::string& _name );
+	#endif
+
 	TiXmlAttributeSet attributeSet;
 };
 
@@ -1239,7 +1543,7 @@ public:
 	/// Queries whether this represents text using a CDATA section.
 	bool CDATA() const				{ return cdata; }
 	/// Turns on or off a CDATA representation of text.
-	void SetCDATA( bool _cdata )	{ cdata = _cdata; }
+	void SetCDATA( bool _cdata )	{ cdata = _cdata; InvalidateSubtreeCache(); }
 
 	virtual const char* Parse( const char* p, TiXmlParsingData* data, TiXmlEncoding encoding );
 
@@ -1383,6 +1687,39 @@ private:
 };
 
 
+/*	[internal use] Keeps the nodes and attributes of the cleared document for
+	the next parse, so their memory and the capacity of their strings are reused.
+	Free nodes are chained through their 'next' pointers, one list per node type.
+*/
+class TiXmlNodeRecycler
+{
+public:
+	TiXmlNodeRecycler();
+	~TiXmlNodeRecycler();
+
+	bool Enabled() const	{ return enabled; }
+	/// Kept nodes are freed when recycling is disabled.
+	void SetEnabled( bool enable );
+
+	/// Get the node of the document recycler or a new one. Document could be null.
+	static TiXmlNode* NewNode( TiXmlDocument* document, TiXmlNode::NodeType type );
+	/// Get the attribute of the document recycler or a new one. Document could be null.
+	static TiXmlAttribute* NewAttribute( TiXmlDocument* document );
+	/// Keep the unlinked node with its children and attributes, or delete it if recycling is disabled.
+	void Release( TiXmlNode* node );
+
+private:
+	TiXmlNodeRecycler( const TiXmlNodeRecycler& );	// not allowed, copies of the document start empty
+	void operator=( const TiXmlNodeRecycler& );	// not allowed
+
+	void Free();
+
+	bool enabled;
+	TiXmlNode* nodes[ TiXmlNode::TINYXML_TYPECOUNT ];
+	TiXmlAttribute* attributes;
+};
+
+
 /** Always the top level node. A document binds together all the
 	XML pieces. It can be saved, loaded, and printed to the screen.
 	The 'value' of a document node is the xml file name.
@@ -1422,6 +1759,12 @@ public:
 		file location. Streaming may be added in the future.
 	*/
 	bool LoadFile( FILE*, TiXmlEncoding encoding = TIXML_DEFAULT_ENCODING );
+	/** Load the document from the buffer the way LoadFile does: line breaks are
+		normalized in place, then the buffer is parsed. The buffer must have room
+		for length+1 characters, the terminating null is written at buf[length].
+		Returns true if successful.
+	*/
+	bool LoadBuffer( char* buf, size_t length, TiXmlEncoding encoding = TIXML_DEFAULT_ENCODING );
 	/// Save a file using the given FILE*. Returns true if successful.
 	bool SaveFile( FILE* ) const;
 
@@ -1502,6 +1845,58 @@ public:
 
 	int TabSize() const	{ return tabsize; }
 
+	/** Set the filter deciding which elements are parsed, 0 to parse all of them.
+		The filter is not owned by the document and must outlive the parsing.
+	*/
+	void SetParseFilter( TiXmlParseFilter* _parseFilter )	{ parseFilter = _parseFilter; }
+
+	/// Get the parse filter, 0 if all elements are parsed.
+	TiXmlParseFilter* ParseFilter() const	{ return parseFilter; }
+
+	/** Set the maximum nesting depth of the elements, 0 means no limit which is
+		the default. Deeper documents fail to parse with TIXML_ERROR_DEPTH_EXCEEDED.
+		Parsing, printing, copying and deleting are not recursive, so deep documents
+		don't overflow the stack, the limit guards against the hostile input.
+	*/
+	void SetMaxDepth( int _maxDepth )		{ maxDepth = _maxDepth; }
+
+	/// Get the maximum nesting depth of the elements, 0 if there is no limit.
+	int MaxDepth() const					{ return maxDepth; }
+
+	/** Set how the white space only text between the tags is parsed. Runs of
+		the white space are found while scanning, so no text node is allocated
+		for them in the default TIXML_WHITESPACE_DROP mode. Text containing
+		other characters is not affected, see SetCondenseWhiteSpace.
+	*/
+	void SetWhiteSpaceMode( TiXmlWhiteSpaceMode _whiteSpaceMode )	{ whiteSpaceMode = _whiteSpaceMode; }
+
+	/// Get the mode of the white space only text.
+	TiXmlWhiteSpaceMode WhiteSpaceMode() const	{ return whiteSpaceMode; }
+
+	/// True if the UTF-8 byte order mark was read, and will be written by SaveFile.
+	bool MicrosoftBOM() const				{ return useMicrosoftBOM; }
+
+	/// Set whether SaveFile writes the UTF-8 byte order mark.
+	void SetMicrosoftBOM( bool _useMicrosoftBOM )	{ useMicrosoftBOM = _useMicrosoftBOM; }
+
+	/** Keep the nodes when the document is cleared, e.g. by LoadFile, and reuse
+		them with their attributes and strings for the next parse. Parsing of the
+		documents of similar shape then doesn't allocate memory. Kept nodes are
+		freed when reuse is turned off or the document is destroyed.
+	*/
+	void SetReuseNodes( bool reuse )		{ recycler.SetEnabled( reuse ); }
+
+	/// True if the nodes of the cleared document are kept for reuse.
+	bool ReuseNodes() const					{ return recycler.Enabled(); }
+
+	/** True if the document is shared by several owners, e.g. by the copies of
+		xmlpp::document, and must not be modified. Plain document is never shared.
+	*/
+	virtual bool IsShared() const			{ return false; }
+
+	// [internal use]
+	TiXmlNodeRecycler* Recycler()			{ return &recycler; }
+
 	/** If you have handled the error, it can be reset with this call. The error
 		state is automatically cleared if you Parse a new XML block.
 	*/
@@ -1549,6 +1944,10 @@ private:
 	int tabsize;
 	TiXmlCursor errorLocation;
 	bool useMicrosoftBOM;		// the UTF-8 BOM were found when read. Note this, and try to write.
+	TiXmlParseFilter* parseFilter;
+	int maxDepth;
+	TiXmlWhiteSpaceMode whiteSpaceMode;
+	TiXmlNodeRecycler recycler;
 };
 
 
@@ -1735,7 +2134,8 @@ class TiXmlPrinter : public TiXmlVisitor
 {
 public:
 	TiXmlPrinter() : depth( 0 ), simpleTextPrint( false ),
-					 buffer(), indent( "    " ), lineBreak( "\n" ) {}
+					 buffer(), indent( "    " ), lineBreak( "\n" ),
+					 cacheSubtrees( false ), cacheLimit( 0 ), cachedElement( 0 ) {}
 
 	virtual bool VisitEnter( const TiXmlDocument& doc );
 	virtual bool VisitExit( const TiXmlDocument& doc );
@@ -1768,6 +2168,19 @@ public:
 	void SetStreamPrinting()						{ indent = "";
 													  lineBreak = "";
 													}	
+	/** Keep the printed text of the elements with the child elements in the nodes
+		and copy it when the unchanged element is printed again with the same indent
+		and line break at the same depth, so reprinting the large document after
+		the small change only formats the changed paths. Elements printed longer
+		than the limit are not kept, so the memory is bounded by the limit times
+		the document size. Changes are tracked like the subtree hashes, see
+		TiXmlNode::SubtreeHash. The kept text is freed with the nodes or by
+		TiXmlNode::ClearPrintedText.
+	*/
+	void SetCacheSubtrees( bool cache, size_t limit = 64 * 1024 )	{ cacheSubtrees = cache; cacheLimit = limit; }
+	/// Query whether the printed text is kept by the nodes.
+	bool CacheSubtrees() const						{ return cacheSubtrees; }
+
 	/// Return the result.
 	const char* CStr()								{ return buffer.c_str(); }
 	/// Return the length of the result string.
@@ -1780,6 +2193,8 @@ public:
 
 private:
 	void DoIndent()	{
+		if ( indent.empty() )
+			return;
 		for( int i=0; i<depth; ++i )
 			buffer += indent;
 	}
@@ -1787,11 +2202,70 @@ private:
 		buffer += lineBreak;
 	}
 
+	void KeepPrintedText( const TiXmlElement& element );
+
 	int depth;
 	bool simpleTextPrint;
 	TIXML_STRING buffer;
 	TIXML_STRING indent;
 	TIXML_STRING lineBreak;
+	bool cacheSubtrees;
+	size_t cacheLimit;
+	const TiXmlElement* cachedElement;	// copied from the cache, its children are not visited
+};
+
+
+/**	Finds the end of the first element in the xml text without parsing it, e.g.
+	to split the stream of concatenated documents. Declarations, comments and
+	text before the element are skipped. The text could arrive in parts: Scan is
+	called again with the longer text, and scanning resumes where it stopped.
+	@verbatim
+	TiXmlStreamScanner scanner;
+	size_t end;
+	while ( ( end = scanner.Scan( buffer.data(), buffer.size() ) ) == TIXML_STRING::npos )
+		ReadMore( buffer );
+	@endverbatim
+*/
+class TiXmlStreamScanner
+{
+  public:
+	TiXmlStreamScanner() { Reset(); }
+
+	/// Start scanning the new text from the position.
+	void Reset( size_t start = 0 );
+
+	/** Scan the text from the last position. Returns the position after the
+		end of the first element or npos if more text is needed.
+	*/
+	size_t Scan( const char* data, size_t length );
+
+	#ifdef TIXML_USE_STL
+	/**	Read the stream buffer by blocks up to the end of the first element and
+		append the text to the tag. Bytes after the element are put back.
+		Returns false if the stream ended before.
+	*/
+	bool Read( std::istream* in, TIXML_STRING* tag );
+	#endif
+
+  private:
+	enum State
+	{
+		SCAN_TEXT,
+		SCAN_MARKUP,		// '<' is found, kind of the markup is not known yet
+		SCAN_TAG,
+		SCAN_COMMENT,
+		SCAN_CDATA,
+		SCAN_OTHER			// declaration, DOCTYPE, processing instruction
+	};
+
+	// Skips to the '>' preceded by the terminator, e.g. "--" of the comment.
+	bool ScanTo( const char* data, size_t length, const char* terminator, size_t openerLength );
+
+	State	state;
+	int		depth;
+	char	quote;
+	size_t	unitStart;		// position of the '<' of the current markup
+	size_t	pos;			// position of the first not scanned byte
 };
 
 